@@ -2,208 +2,113 @@
 #include <WiFi.h>
 
 #include "touch.h"
-#include "keyboard.h"
 
 #include "desktop.h"
 #include "chat_app.h"
 #include "paint.h"
 #include "ai_client.h"
 #include "wifi_app.h"
+#include "wifi_link.h"
+#include "wifi_mon.h"
+#include "power.h"
 #include "internet_app.h"
 
 #include "welcome.h"
+#include "frame.h"
+#include "app.h"
 
 TFT_eSPI tft;
 
-enum AppState { APP_DESKTOP, APP_CHAT, APP_PAINT, APP_WIFI, APP_INTERNET };
-static AppState app = APP_DESKTOP;
-
-static inline bool inRect(int x,int y,int rx,int ry,int rw,int rh){
-  return x>=rx && x<=rx+rw && y>=ry && y<=ry+rh;
+// The desktop comes first: it is the home screen apps return to.
+static const App* const APPS[] = {
+  &DESKTOP_APP,
+  &CHAT_APP,
+  &PAINT_APP,
+  &WIFI_APP,
+  &INTERNET_APP,
+};
+
+// The splash stays up at least this long so a fast boot doesn't flash it.
+#ifndef BOOT_SPLASH_MIN_MS
+#define BOOT_SPLASH_MIN_MS 600
+#endif
+
+static void bootStage(const char* name) {
+  static uint32_t last = 0;
+  uint32_t now = millis();
+  Serial.printf("boot: %-8s +%4lu ms  at %5lu ms\n", name,
+                (unsigned long)(now - last), (unsigned long)now);
+  last = now;
 }
 
-static void show_welcome(uint32_t ms = 2500) {
-
+static void show_welcome() {
   tft.setSwapBytes(true);
   tft.pushImage(0, 0, WELCOME_WIDTH, WELCOME_HEIGHT, (uint16_t*)welcome_map);
-  delay(ms);
 }
 
+// Splash first; everything else runs while it is on screen and Wi-Fi
+// associates in the background.
 void setup() {
   Serial.begin(115200);
-
-  ai_begin();
-
-  WiFi.mode(WIFI_STA);
-  WiFi.setSleep(false);
-  delay(100);
-
-
-  unsigned long wifiStart = millis();
-  while (millis() - wifiStart < 5000) {
-    if (WiFi.status() == WL_CONNECTED) break;
-    delay(200);
-    Serial.print(".");
-  }
-  Serial.println();
-  Serial.println(WiFi.status() == WL_CONNECTED ? "WiFi connected" : "TEST MODE (no WiFi)");
-
-  pinMode(27, OUTPUT);
-  digitalWrite(27, HIGH);
+  bootStage("serial");
 
   tft.init();
   tft.setRotation(1);
+  show_welcome();
+  power_begin();
+  uint32_t splashAt = millis();
+  bootStage("splash");
+
+  if (!wifi_link_begin()) Serial.println("No saved WiFi, TEST MODE until one is joined");
+  wifi_mon_begin();
+  bootStage("wifi");
 
-  show_welcome(2500);
+  ai_begin();
+  bootStage("ai");
 
   touch_init();
-  keyboard_init(&tft);
+  bootStage("touch");
 
   paint_init(&tft);
   wifi_app_init(&tft);
   internet_app_init(&tft);
-
   desktop_init(&tft);
   chat_init(&tft);
+  bootStage("apps");
 
-  desktop_draw();
+  while (millis() - splashAt < BOOT_SPLASH_MIN_MS) {
+    ai_pollSerial();
+    wifi_link_tick();
+    wifi_app_poll();
+    delay(10);
+  }
+
+  app_begin(APPS, sizeof(APPS) / sizeof(APPS[0]));
+  bootStage("desktop");
+  Serial.printf("boot: free heap %u bytes\n", (unsigned)ESP.getFreeHeap());
 }
 
 void loop() {
   static bool lastPressed = false;
 
-  wifi_app_tick();
-  internet_app_tick();
   ai_pollSerial();
+  wifi_link_tick();
+  wifi_app_poll();
+  chat_tick();   // also in the background, so a cancelled request is collected
+  if (power_awake()) wifi_mon_tick();   // nobody is looking while the screen is off
+  app_tick();
+  frame_tick();
 
   int x = 0, y = 0;
-bool pressed = touch_is_pressed();
-static uint32_t lastLog = 0;
-if (millis() - lastLog > 500) {
-  Serial.printf("pressed=%d\n", (int)pressed);
-  lastLog = millis();
-}
-
-  if (!pressed && lastPressed) {
-    keyboard_release();
-    paint_release();
-
-    if (app == APP_CHAT) {
-      chat_release();
-    }
-  }
-
-  if (pressed) {
-    if (!touch_get(x, y)) {
-      lastPressed = pressed;
-      return;
-    }
-  }
-
-  if (app == APP_WIFI) {
-    bool keepOpen = wifi_app_handleTouch(pressed, lastPressed, x, y);
-
-    if (!keepOpen) {
-      app = APP_DESKTOP;
-      desktop_draw();
-      lastPressed = true;
-      return;
-    }
-
-    lastPressed = pressed;
-    return;
-  }
-
-  if (app == APP_INTERNET) {
-    bool keepOpen = internet_app_handleTouch(pressed, lastPressed, x, y);
-
-    if (!keepOpen) {
-      app = APP_DESKTOP;
-      desktop_draw();
-      lastPressed = true;
-      return;
-    }
+  bool pressed = touch_is_pressed();
 
+  if (power_touch(pressed)) {
     lastPressed = pressed;
-    return;
-  }
-
-  if (app == APP_DESKTOP) {
-    DesktopAction a = desktop_handleTouch(pressed, lastPressed, x, y);
-
-    if (a == DESKTOP_OPEN_CHAT) {
-      app = APP_CHAT;
-      keyboard_clear();
-      chat_draw();
-      lastPressed = true;
-      return;
-    }
-    else if (a == DESKTOP_OPEN_PAINT) {
-      app = APP_PAINT;
-      paint_draw();
-      lastPressed = true;
-      return;
-    }
-    else if (a == DESKTOP_OPEN_WIFI) {
-      app = APP_WIFI;
-      wifi_app_open();
-      lastPressed = true;
-      return;
-    }
-    else if (a == DESKTOP_OPEN_INTERNET) {
-      app = APP_INTERNET;
-      internet_app_open();
-      lastPressed = true;
-      return;
-    }
-    else if (a == DESKTOP_PROPERTIES_CHAT) {
-      Serial.println("Chat Properties (TODO)");
-    }
-    else if (a == DESKTOP_PROPERTIES_PAINT) {
-      Serial.println("Paint Properties (TODO)");
-    }
-
-    lastPressed = pressed;
-    return;
-  }
-
-  if (app == APP_CHAT) {
-    if (pressed && !lastPressed && inRect(x, y, 260, 4, 52, 17)) {
-      app = APP_DESKTOP;
-      desktop_draw();
-      lastPressed = true;
-      return;
-    }
-
-    chat_handleTouch(pressed, lastPressed, x, y);
-
-    lastPressed = pressed;
-    return;
-  }
-
-  if (app == APP_PAINT) {
-    if (pressed && !lastPressed) {
-      if (x >= 320 - 16 - 6 && x < 320 - 6 && y >= 2 && y < 16) {
-        app = APP_DESKTOP;
-        desktop_draw();
-        lastPressed = true;
-        return;
-      }
-    }
-
-    if (pressed) {
-      bool keepOpen = paint_handleTouch(x, y);
-      if (!keepOpen) {
-        app = APP_DESKTOP;
-        desktop_draw();
-        lastPressed = true;
-        return;
-      }
-    }
-
+  } else if (pressed && !touch_get(x, y)) {
     lastPressed = pressed;
-    return;
+  } else {
+    lastPressed = app_touch(pressed, lastPressed, x, y);
   }
 
-  lastPressed = pressed;
+  power_tick();
 }
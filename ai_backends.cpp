@@ -0,0 +1,262 @@
+#include "ai_backends.h"
+#include <Preferences.h>
+
+static const char* DEFAULT_URL   = "https://esp32-llm.marinmandarinegirl.workers.dev/api/generate";
+static const char* DEFAULT_MODEL = "@cf/meta/llama-3.2-1b-instruct";
+
+static const char* NVS_NS = "aibk";
+
+// Persisted part of AiBackend.
+struct BackendCfg {
+  char    url[112];
+  char    model[48];
+  uint8_t proto;
+  uint8_t auth;
+  char    token[AI_TOKEN_MAX];
+};
+
+static AiBackend backends[AI_MAX_BACKENDS];
+static int       backendCount = 0;
+
+static const float    EWMA_ALPHA     = 0.3f;
+static const float    UNKNOWN_MS     = 3000.0f;   // prior for backends we haven't timed yet
+static const uint32_t COOL_BASE_MS   = 5000;
+static const uint32_t COOL_MAX_MS    = 60000;
+
+static const char* protoName(uint8_t p)
+{
+  return p == AI_PROTO_OPENAI ? "openai" : "ollama";
+}
+
+static const char* authName(uint8_t a)
+{
+  return a == AI_AUTH_DEVICE ? "device token" : a == AI_AUTH_OWN ? "own token" : "none";
+}
+
+static void setEntry(AiBackend& b, uint8_t proto, const char* url, const char* model,
+                     uint8_t auth, const char* token)
+{
+  memset(&b, 0, sizeof(b));
+  strncpy(b.url, url, sizeof(b.url) - 1);
+  strncpy(b.model, model, sizeof(b.model) - 1);
+  b.proto = proto;
+  b.auth = auth;
+  if (auth == AI_AUTH_OWN) strncpy(b.token, token, sizeof(b.token) - 1);
+}
+
+// ============================================================
+// NVS
+// ============================================================
+static void nvsSave()
+{
+  Preferences p;
+  p.begin(NVS_NS, false);
+  p.clear();
+  p.putUChar("n", (uint8_t)backendCount);
+  for (int i = 0; i < backendCount; i++) {
+    BackendCfg c;
+    memset(&c, 0, sizeof(c));
+    memcpy(c.url, backends[i].url, sizeof(c.url));
+    memcpy(c.model, backends[i].model, sizeof(c.model));
+    c.proto = backends[i].proto;
+    c.auth = backends[i].auth;
+    memcpy(c.token, backends[i].token, sizeof(c.token));
+
+    char key[4] = { 'b', (char)('0' + i), 0 };
+    p.putBytes(key, &c, sizeof(c));
+  }
+  p.end();
+}
+
+static void loadDefaults()
+{
+  backendCount = 1;
+  setEntry(backends[0], AI_PROTO_OLLAMA, DEFAULT_URL, DEFAULT_MODEL, AI_AUTH_DEVICE, "");
+}
+
+void ai_backends_begin()
+{
+  Preferences p;
+  p.begin(NVS_NS, true);
+  int n = p.getUChar("n", 0);
+  if (n > AI_MAX_BACKENDS) n = AI_MAX_BACKENDS;
+
+  backendCount = 0;
+  for (int i = 0; i < n; i++) {
+    BackendCfg c;
+    memset(&c, 0, sizeof(c));
+    char key[4] = { 'b', (char)('0' + i), 0 };
+    size_t got = p.getBytes(key, &c, sizeof(c));
+    if (got != sizeof(c) && got != offsetof(BackendCfg, auth)) continue;
+    c.url[sizeof(c.url) - 1] = 0;
+    c.model[sizeof(c.model) - 1] = 0;
+    c.token[sizeof(c.token) - 1] = 0;
+    // saved before per-entry auth: only the default endpoint had the token
+    if (got != sizeof(c)) c.auth = strcmp(c.url, DEFAULT_URL) == 0 ? AI_AUTH_DEVICE : AI_AUTH_NONE;
+    setEntry(backends[backendCount++], c.proto, c.url, c.model, c.auth, c.token);
+  }
+  p.end();
+
+  if (backendCount == 0) loadDefaults();
+}
+
+// ============================================================
+// Selection
+// ============================================================
+int ai_backends_count() { return backendCount; }
+
+const AiBackend& ai_backends_get(int i) { return backends[i]; }
+
+static float score(const AiBackend& b)
+{
+  float ms = b.avgMs > 0 ? b.avgMs : UNKNOWN_MS;
+  float s = ms * (1.0f + 4.0f * b.errRate);
+  if ((int32_t)(millis() - b.coolUntil) < 0) s += 1e6f;   // cooling down: last resort
+  return s;
+}
+
+int ai_backends_order(int* order, int max)
+{
+  int n = backendCount < max ? backendCount : max;
+  for (int i = 0; i < n; i++) order[i] = i;
+
+  // insertion sort, stable so registry order breaks ties
+  for (int i = 1; i < n; i++) {
+    int v = order[i];
+    float sv = score(backends[v]);
+    int j = i - 1;
+    while (j >= 0 && score(backends[order[j]]) > sv) {
+      order[j + 1] = order[j];
+      j--;
+    }
+    order[j + 1] = v;
+  }
+  return n;
+}
+
+void ai_backends_report(int i, bool ok, uint32_t ms)
+{
+  if (i < 0 || i >= backendCount) return;
+  AiBackend& b = backends[i];
+  b.calls++;
+
+  b.errRate = b.errRate * (1.0f - EWMA_ALPHA) + (ok ? 0.0f : EWMA_ALPHA);
+
+  if (ok) {
+    b.avgMs = b.avgMs > 0 ? b.avgMs * (1.0f - EWMA_ALPHA) + ms * EWMA_ALPHA : (float)ms;
+    b.failStreak = 0;
+    b.coolUntil = millis();
+    return;
+  }
+
+  if (b.failStreak < 8) b.failStreak++;
+  if (b.failStreak >= 2) {
+    uint32_t cool = COOL_BASE_MS << (b.failStreak - 2);
+    if (cool > COOL_MAX_MS) cool = COOL_MAX_MS;
+    b.coolUntil = millis() + cool;
+  }
+}
+
+// ============================================================
+// Serial
+// ============================================================
+static void printBackends()
+{
+  int order[AI_MAX_BACKENDS];
+  int n = ai_backends_order(order, AI_MAX_BACKENDS);
+  int rank[AI_MAX_BACKENDS];
+  for (int i = 0; i < n; i++) rank[order[i]] = i + 1;
+
+  for (int i = 0; i < backendCount; i++) {
+    const AiBackend& b = backends[i];
+    bool cooling = (int32_t)(millis() - b.coolUntil) < 0;
+    Serial.printf("%d: [%s] %s  model=%s  auth=%s\n", i, protoName(b.proto), b.url, b.model, authName(b.auth));
+    Serial.printf("   rank %d, avg %lu ms, errors %d%%, %lu calls%s\n",
+                  rank[i], (unsigned long)b.avgMs, (int)(b.errRate * 100 + 0.5f),
+                  (unsigned long)b.calls, cooling ? ", cooling down" : "");
+  }
+}
+
+bool ai_backends_handleSerial(const String& line)
+{
+  if (line == "BACKENDS") {
+    printBackends();
+    return true;
+  }
+
+  if (line == "BACKEND_RESET") {
+    loadDefaults();
+    nvsSave();
+    Serial.println("Backends reset to default.");
+    return true;
+  }
+
+  const String delPrefix = "BACKEND_DEL ";
+  if (line.startsWith(delPrefix)) {
+    int i = line.substring(delPrefix.length()).toInt();
+    if (i < 0 || i >= backendCount || backendCount == 1) {
+      Serial.println("BACKEND_DEL needs a valid index (the last backend can't be removed).");
+      return true;
+    }
+    for (int k = i + 1; k < backendCount; k++) backends[k - 1] = backends[k];
+    backendCount--;
+    nvsSave();
+    printBackends();
+    return true;
+  }
+
+  const String addPrefix = "BACKEND_ADD ";
+  if (line.startsWith(addPrefix)) {
+    String rest = line.substring(addPrefix.length());
+    rest.trim();
+    int s1 = rest.indexOf(' ');
+    int s2 = s1 < 0 ? -1 : rest.indexOf(' ', s1 + 1);
+    if (s2 < 0) {
+      Serial.println("Usage: BACKEND_ADD <ollama|openai> <url> <model> [token]");
+      return true;
+    }
+
+    String proto = rest.substring(0, s1);
+    String url   = rest.substring(s1 + 1, s2);
+    String model = rest.substring(s2 + 1);
+    model.trim();
+    String token;
+    int s3 = model.indexOf(' ');
+    if (s3 >= 0) {
+      token = model.substring(s3 + 1);
+      token.trim();
+      model = model.substring(0, s3);
+    }
+
+    uint8_t p;
+    if (proto == "ollama") p = AI_PROTO_OLLAMA;
+    else if (proto == "openai") p = AI_PROTO_OPENAI;
+    else { Serial.println("Protocol must be ollama or openai."); return true; }
+
+    if (!(url.startsWith("http://") || url.startsWith("https://")) ||
+        url.length() >= sizeof(backends[0].url) || model.length() >= sizeof(backends[0].model)) {
+      Serial.println("Bad URL or model name too long.");
+      return true;
+    }
+    if (token.length() >= AI_TOKEN_MAX) {
+      Serial.println("Token too long.");
+      return true;
+    }
+    if (token.length() && !url.startsWith("https://")) {
+      Serial.println("Tokens are only sent over https; drop the token or use an https URL.");
+      return true;
+    }
+    if (backendCount >= AI_MAX_BACKENDS) {
+      Serial.println("Backend list full, BACKEND_DEL one first.");
+      return true;
+    }
+
+    uint8_t auth = token.length() ? AI_AUTH_OWN : AI_AUTH_NONE;
+    setEntry(backends[backendCount++], p, url.c_str(), model.c_str(), auth, token.c_str());
+    nvsSave();
+    printBackends();
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <Arduino.h>
+
+// Registry of AI endpoints kept in NVS. Each entry speaks one protocol;
+// requests go to the healthiest/fastest entry and fail over down the list.
+
+enum AiProto : uint8_t {
+  AI_PROTO_OLLAMA = 0,   // POST /api/generate {"model","prompt"}     -> "response"
+  AI_PROTO_OPENAI = 1    // POST /v1/chat/completions {"messages"}    -> choices[0].message.content
+};
+
+#ifndef AI_MAX_BACKENDS
+#define AI_MAX_BACKENDS 4
+#endif
+
+// Where an entry's credential comes from. Tokens only ever go out over https.
+enum AiAuth : uint8_t {
+  AI_AUTH_NONE   = 0,   // no auth header
+  AI_AUTH_DEVICE = 1,   // the SET_TOKEN token (the default endpoint)
+  AI_AUTH_OWN    = 2    // token given with BACKEND_ADD
+};
+
+#ifndef AI_TOKEN_MAX
+#define AI_TOKEN_MAX 128
+#endif
+
+struct AiBackend {
+  char    url[112];
+  char    model[48];
+  uint8_t proto;
+  uint8_t auth;
+  char    token[AI_TOKEN_MAX];   // AI_AUTH_OWN only
+
+  // runtime only
+  float    avgMs;        // moving average of successful round-trips, 0 = never measured
+  float    errRate;      // moving average of failures, 0..1
+  uint8_t  failStreak;
+  uint32_t coolUntil;    // millis(); skipped (tried last) until then
+  uint32_t calls;
+};
+
+void ai_backends_begin();
+
+int              ai_backends_count();
+const AiBackend& ai_backends_get(int i);
+
+// Fills order[] with backend indices, best first. Returns how many.
+int  ai_backends_order(int* order, int max);
+void ai_backends_report(int i, bool ok, uint32_t ms);
+
+// BACKENDS, BACKEND_ADD <ollama|openai> <url> <model> [token], BACKEND_DEL <n>,
+// BACKEND_RESET. Returns false if the line isn't a backend command.
+bool ai_backends_handleSerial(const String& line);
@@ -0,0 +1,346 @@
+#include "ai_cache.h"
+#include "ai_client.h"
+#include <ctype.h>
+#include <time.h>
+
+#if AI_CACHE_FLASH
+#include <LittleFS.h>
+#endif
+
+struct RamEntry {
+  uint64_t key;
+  uint32_t lastUse;   // 0 = empty
+  char     reply[AI_REPLY_MAX + 4];
+};
+
+static RamEntry ram[AI_CACHE_RAM_ENTRIES];
+static uint32_t useTick = 0;
+
+static uint32_t hitsRam   = 0;
+static uint32_t hitsFlash = 0;
+static uint32_t misses    = 0;
+static uint32_t stores    = 0;
+static uint32_t evictions = 0;
+
+// ============================================================
+// Key
+// ============================================================
+static const uint64_t FNV_OFFSET = 1469598103934665603ULL;
+static const uint64_t FNV_PRIME  = 1099511628211ULL;
+
+static uint64_t fnvByte(uint64_t h, uint8_t b)
+{
+  return (h ^ b) * FNV_PRIME;
+}
+
+static uint64_t fnvStr(uint64_t h, const char* s)
+{
+  while (*s) h = fnvByte(h, (uint8_t)*s++);
+  return fnvByte(h, 0);
+}
+
+// Lowercase, collapse whitespace, drop trailing punctuation: "What is XP ?"
+// and "what is xp" share an entry.
+static uint64_t fnvNormalized(uint64_t h, const char* s)
+{
+  const char* end = s + strlen(s);
+  while (end > s && (isspace((unsigned char)end[-1]) || strchr("?!.", end[-1]))) end--;
+  while (s < end && isspace((unsigned char)*s)) s++;
+
+  bool space = false;
+  for (; s < end; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (isspace(c)) { space = true; continue; }
+    if (space) { h = fnvByte(h, ' '); space = false; }
+    h = fnvByte(h, (uint8_t)tolower(c));
+  }
+  return h;
+}
+
+uint64_t ai_cache_key(const char* model, const char* promptTemplate, const char* userText)
+{
+  uint64_t h = FNV_OFFSET;
+  h = fnvStr(h, model);
+  h = fnvStr(h, promptTemplate);
+  return fnvNormalized(h, userText);
+}
+
+// ============================================================
+// RAM tier
+// ============================================================
+static RamEntry* ramFind(uint64_t key)
+{
+  for (int i = 0; i < AI_CACHE_RAM_ENTRIES; i++) {
+    if (ram[i].lastUse && ram[i].key == key) return &ram[i];
+  }
+  return nullptr;
+}
+
+static void ramPut(uint64_t key, const char* reply)
+{
+  RamEntry* e = ramFind(key);
+  if (!e) {
+    e = &ram[0];
+    for (int i = 1; i < AI_CACHE_RAM_ENTRIES; i++) {
+      if (ram[i].lastUse < e->lastUse) e = &ram[i];
+    }
+    if (e->lastUse) evictions++;
+  }
+
+  e->key = key;
+  e->lastUse = ++useTick;
+  strncpy(e->reply, reply, sizeof(e->reply) - 1);
+  e->reply[sizeof(e->reply) - 1] = 0;
+}
+
+// ============================================================
+// Flash tier
+// ============================================================
+#if AI_CACHE_FLASH
+static const char*    FLASH_DIR   = "/aic";
+static const uint32_t FLASH_MAGIC = 0x31434941;  // "AIC1"
+
+struct FlashHeader {
+  uint32_t magic;
+  uint32_t created;   // unix time
+  uint16_t len;
+};
+
+static bool flashOk = false;
+
+// What the directory holds, kept up to date on every write and remove so a
+// put only walks the directory when it would go over budget.
+static int    flashFiles = 0;
+static size_t flashBytes = 0;
+
+static void flashRemove(const char* path, size_t size)
+{
+  if (!LittleFS.remove(path)) return;
+  if (flashFiles > 0) flashFiles--;
+  flashBytes = flashBytes > size ? flashBytes - size : 0;
+}
+
+// TTL needs wall-clock time, which we only have once SNTP has synced.
+static bool clockValid(uint32_t& now)
+{
+  now = (uint32_t)time(nullptr);
+  return now > 1700000000UL;
+}
+
+static void flashPath(uint64_t key, char* out, size_t cap)
+{
+  snprintf(out, cap, "%s/%08lx%08lx", FLASH_DIR,
+           (unsigned long)(key >> 32), (unsigned long)(key & 0xFFFFFFFFUL));
+}
+
+static bool flashGet(uint64_t key, char* reply, size_t cap)
+{
+  uint32_t now;
+  if (!flashOk || !clockValid(now)) return false;
+
+  char path[32];
+  flashPath(key, path, sizeof(path));
+  if (!LittleFS.exists(path)) return false;
+
+  File f = LittleFS.open(path, "r");
+  if (!f) return false;
+
+  FlashHeader h;
+  size_t sz = f.size();
+  bool ok = f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == FLASH_MAGIC;
+  bool fresh = ok && (now - h.created) < AI_CACHE_TTL_S;
+  if (fresh) {
+    size_t n = h.len < cap - 1 ? h.len : cap - 1;
+    ok = f.read((uint8_t*)reply, n) == n;
+    reply[n] = 0;
+  }
+  f.close();
+
+  if (!ok || !fresh) {
+    flashRemove(path, sz);
+    return false;
+  }
+  return true;
+}
+
+// One pass over the directory: drops unreadable and (with the clock set)
+// expired entries, recounts the totals and names the oldest entry.
+static void flashScan(char* oldest, size_t cap)
+{
+  uint32_t now;
+  bool haveClock = clockValid(now);
+  uint32_t oldestT = 0xFFFFFFFFUL;
+  if (oldest) oldest[0] = 0;
+
+  flashFiles = 0;
+  flashBytes = 0;
+
+  File dir = LittleFS.open(FLASH_DIR);
+  if (!dir) return;
+
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    char path[32];
+    snprintf(path, sizeof(path), "%s/%s", FLASH_DIR, f.name());
+
+    FlashHeader h;
+    bool ok = f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == FLASH_MAGIC;
+    size_t sz = f.size();
+    f.close();
+
+    if (!ok || (haveClock && now - h.created >= AI_CACHE_TTL_S)) {
+      LittleFS.remove(path);
+      continue;
+    }
+
+    flashFiles++;
+    flashBytes += sz;
+    if (oldest && h.created < oldestT) {
+      oldestT = h.created;
+      strlcpy(oldest, path, cap);
+    }
+  }
+  dir.close();
+}
+
+static bool flashOver(size_t incoming)
+{
+  return flashFiles + 1 > AI_CACHE_FLASH_MAX_FILES ||
+         flashBytes + incoming > AI_CACHE_FLASH_MAX_BYTES;
+}
+
+// Drops expired entries, then the oldest ones, until one more fits.
+static void flashTrim(size_t incoming)
+{
+  if (!flashOver(incoming)) return;
+
+  while (true) {
+    char oldest[32];
+    flashScan(oldest, sizeof(oldest));
+    if (!flashOver(incoming) || oldest[0] == 0) return;
+
+    LittleFS.remove(oldest);
+    evictions++;
+  }
+}
+
+static void flashPut(uint64_t key, const char* reply)
+{
+  uint32_t now;
+  if (!flashOk || !clockValid(now)) return;
+
+  FlashHeader h = { FLASH_MAGIC, now, (uint16_t)strlen(reply) };
+
+  // the old copy goes first, so its bytes count as free when trimming
+  char path[32];
+  flashPath(key, path, sizeof(path));
+  if (LittleFS.exists(path)) {
+    File old = LittleFS.open(path, "r");
+    size_t sz = old ? old.size() : 0;
+    if (old) old.close();
+    flashRemove(path, sz);
+  }
+  flashTrim(sizeof(h) + h.len);
+
+  File f = LittleFS.open(path, "w");
+  if (!f) return;
+  size_t n = f.write((const uint8_t*)&h, sizeof(h));
+  n += f.write((const uint8_t*)reply, h.len);
+  f.close();
+  flashFiles++;
+  flashBytes += n;
+}
+
+static void flashClear()
+{
+  if (!flashOk) return;
+  File dir = LittleFS.open(FLASH_DIR);
+  if (!dir) return;
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    char path[32];
+    snprintf(path, sizeof(path), "%s/%s", FLASH_DIR, f.name());
+    f.close();
+    LittleFS.remove(path);
+  }
+  dir.close();
+  flashFiles = 0;
+  flashBytes = 0;
+}
+#endif
+
+// ============================================================
+// Public
+// ============================================================
+void ai_cache_begin()
+{
+#if AI_CACHE_FLASH
+  flashOk = LittleFS.begin(true);
+  if (flashOk && !LittleFS.exists(FLASH_DIR)) LittleFS.mkdir(FLASH_DIR);
+  if (flashOk) flashScan(nullptr, 0);
+  else Serial.println("AI cache: LittleFS unavailable, RAM only");
+
+  // flash entries carry a timestamp; SNTP fills the clock once Wi-Fi is up
+  configTime(0, 0, "pool.ntp.org");
+#endif
+}
+
+bool ai_cache_get(uint64_t key, char* reply, size_t cap)
+{
+  RamEntry* e = ramFind(key);
+  if (e) {
+    e->lastUse = ++useTick;
+    strlcpy(reply, e->reply, cap);
+    hitsRam++;
+    return true;
+  }
+
+#if AI_CACHE_FLASH
+  if (flashGet(key, reply, cap)) {
+    ramPut(key, reply);
+    hitsFlash++;
+    return true;
+  }
+#endif
+
+  misses++;
+  return false;
+}
+
+void ai_cache_put(uint64_t key, const char* reply)
+{
+  if (!reply[0]) return;
+  ramPut(key, reply);
+#if AI_CACHE_FLASH
+  flashPut(key, reply);
+#endif
+  stores++;
+}
+
+void ai_cache_clear()
+{
+  for (int i = 0; i < AI_CACHE_RAM_ENTRIES; i++) ram[i].lastUse = 0;
+#if AI_CACHE_FLASH
+  flashClear();
+#endif
+  hitsRam = hitsFlash = misses = stores = evictions = 0;
+}
+
+void ai_cache_printStats(Print& out)
+{
+  uint32_t lookups = hitsRam + hitsFlash + misses;
+  uint32_t hitPct = lookups ? (100UL * (hitsRam + hitsFlash)) / lookups : 0;
+
+  out.printf("AI cache: %lu hits (%lu ram, %lu flash), %lu misses, %lu%% hit rate\n",
+             (unsigned long)(hitsRam + hitsFlash), (unsigned long)hitsRam,
+             (unsigned long)hitsFlash, (unsigned long)misses, (unsigned long)hitPct);
+  out.printf("          %lu stores, %lu evictions\n",
+             (unsigned long)stores, (unsigned long)evictions);
+
+  int used = 0;
+  for (int i = 0; i < AI_CACHE_RAM_ENTRIES; i++) if (ram[i].lastUse) used++;
+  out.printf("          ram %d/%d entries", used, AI_CACHE_RAM_ENTRIES);
+#if AI_CACHE_FLASH
+  if (flashOk) out.printf(", flash %u/%u bytes used",
+                          (unsigned)LittleFS.usedBytes(), (unsigned)LittleFS.totalBytes());
+#endif
+  out.println();
+}
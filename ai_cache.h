@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+
+// Replies from the model, keyed by (model, prompt template, normalized text).
+// RAM tier is a small LRU; the optional flash tier survives reboots.
+
+#ifndef AI_CACHE_RAM_ENTRIES
+#define AI_CACHE_RAM_ENTRIES 8
+#endif
+
+#ifndef AI_CACHE_FLASH
+#define AI_CACHE_FLASH 1
+#endif
+
+#ifndef AI_CACHE_FLASH_MAX_FILES
+#define AI_CACHE_FLASH_MAX_FILES 48
+#endif
+
+#ifndef AI_CACHE_FLASH_MAX_BYTES
+#define AI_CACHE_FLASH_MAX_BYTES (16 * 1024)
+#endif
+
+#ifndef AI_CACHE_TTL_S
+#define AI_CACHE_TTL_S (7UL * 24 * 3600)
+#endif
+
+void     ai_cache_begin();
+uint64_t ai_cache_key(const char* model, const char* promptTemplate, const char* userText);
+
+bool ai_cache_get(uint64_t key, char* reply, size_t cap);
+void ai_cache_put(uint64_t key, const char* reply);
+
+void ai_cache_clear();
+void ai_cache_printStats(Print& out);
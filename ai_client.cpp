@@ -1,19 +1,73 @@
 #include "ai_client.h"
+#include "ai_http.h"
+#include "ai_inflate.h"
+#include "ai_perf.h"
+#include "frame.h"
+#include "wifi_link.h"
+#include "wifi_app.h"
+#include "wifi_mon.h"
+#include "power.h"
+#include "keyboard.h"
+#include "ai_cache.h"
+#include "ai_offline.h"
+#include "ai_backends.h"
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
-#include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <Preferences.h>
 
-static const char* OLLAMA_URL = "https://esp32-llm.marinmandarinegirl.workers.dev/api/generate";
-
-static const char* MODEL_NAME = "@cf/meta/llama-3.2-1b-instruct";
+static const char* PROMPT_RULES = "Reply in a few short sentences. No lists.\n";
 
 static const char* NVS_NS  = "cfg";
 static const char* NVS_KEY = "auth";
+static const char* NVS_KEY_CTX = "ctx";
+static const char* NVS_KEY_TMO = "tmo";
+static const char* NVS_KEY_COALESCE = "coal";
+
+// Prompt text budget in bytes (~4 bytes per token for English).
+#ifndef AI_CONTEXT_BUDGET
+#define AI_CONTEXT_BUDGET 1200
+#endif
+#define AI_CONTEXT_MAX 4096   // request copies must fit the job arena
+#define AI_SUMMARY_MAX 240
+
+static const int TURN_OVERHEAD    = 20;  // "User: \nAssistant: \n"
+static const int SUMMARY_OVERHEAD = 24;  // "Earlier in this chat: \n"
+
+static char gToken[128];   // fixed buffer: the send path stays off the heap
+static bool gTokenLoaded = false;
+
+static uint16_t gContextBudget = AI_CONTEXT_BUDGET;
 
-static String gToken;
-static bool   gTokenLoaded = false;
+// Notes about turns that no longer fit the budget, oldest first.
+static char     gSummary[AI_SUMMARY_MAX + 1];
+static uint32_t gSummarySeq = 0;
+
+struct AiTimeouts {
+  uint16_t connectMs;   // DNS + TCP + TLS handshake
+  uint16_t ttfbMs;      // request sent -> status line
+  uint16_t totalMs;     // whole request, all retries and backends
+};
+
+static AiTimeouts gTimeouts = { 6000, 20000, 30000 };
+
+#ifndef AI_COALESCE_MS
+#define AI_COALESCE_MS 250
+#endif
+
+static uint16_t gCoalesceMs = AI_COALESCE_MS;
+
+// Connect and first-byte timeouts stretch on a weak link; the total doesn't.
+static uint32_t linkScaled(uint32_t ms)
+{
+  switch (wifi_mon_quality()) {
+    case LINK_Q_FAIR: return ms * 3 / 2;
+    case LINK_Q_POOR: return ms * 2;
+    default:          return ms;
+  }
+}
+
+static String offlineReply(const String& userMessage);
 
 static String nvsLoadToken()
 {
@@ -41,50 +95,62 @@ static void nvsClearToken()
   prefs.end();
 }
 
-static void ensureTokenLoaded()
+static void setToken(const String& tok)
 {
-  if (gTokenLoaded) return;
-  gToken = nvsLoadToken();
+  strlcpy(gToken, tok.c_str(), sizeof(gToken));
   gTokenLoaded = true;
 }
 
-static void provisionTokenFromSerialBlocking()
+static void ensureTokenLoaded()
 {
+  if (gTokenLoaded) return;
+  setToken(nvsLoadToken());
+}
 
-  ensureTokenLoaded();
-  if (gToken.length() > 0) {
-    Serial.println("AI token loaded from NVS.");
-    return;
-  }
+// Boot doesn't wait for the token: the prompt is printed and the next
+// serial line that isn't a command is taken as the token.
+static bool gAwaitToken = false;
 
+static void promptForToken()
+{
   Serial.println("\n=== AI TOKEN SETUP ===");
   Serial.println("No token in NVS.");
   Serial.println("Paste your token, press Enter:");
+  gAwaitToken = true;
+}
 
-  while (!Serial.available()) delay(10);
-
-  String tok = Serial.readStringUntil('\n');
-  tok.trim();
-
-  if (tok.length() == 0) {
-    Serial.println("Empty token. Not saved.");
-    return;
+// Commands are upper case words; tokens aren't.
+static bool looksLikeCommand(const String& line)
+{
+  int end = line.indexOf(' ');
+  if (end < 0) end = line.length();
+  for (int i = 0; i < end; i++) {
+    char c = line[i];
+    if (!(c == '_' || (c >= 'A' && c <= 'Z'))) return false;
   }
-
-  nvsSaveToken(tok);
-  gToken = tok;
-  Serial.println("Saved token to NVS ");
+  return end > 0;
 }
 
 void ai_begin()
 {
+  ai_backends_begin();
+  ai_cache_begin();
 
-  ensureTokenLoaded();
+  {
+    Preferences prefs;
+    prefs.begin(NVS_NS, true);
+    gContextBudget = prefs.getUShort(NVS_KEY_CTX, AI_CONTEXT_BUDGET);
+    if (gContextBudget > AI_CONTEXT_MAX) gContextBudget = AI_CONTEXT_MAX;
+    AiTimeouts t;
+    if (prefs.getBytes(NVS_KEY_TMO, &t, sizeof(t)) == sizeof(t)) gTimeouts = t;
+    gCoalesceMs = prefs.getUShort(NVS_KEY_COALESCE, AI_COALESCE_MS);
+    prefs.end();
+  }
 
-  if (gToken.length() == 0) {
+  ensureTokenLoaded();
 
-    provisionTokenFromSerialBlocking();
-  }
+  if (gToken[0]) Serial.println("AI token loaded from NVS.");
+  else promptForToken();
 }
 
 void ai_pollSerial()
@@ -96,10 +162,17 @@ void ai_pollSerial()
   line.trim();
   if (line.length() == 0) return;
 
+  if (gAwaitToken && !looksLikeCommand(line)) {
+    gAwaitToken = false;
+    nvsSaveToken(line);
+    setToken(line);
+    Serial.println("Saved token to NVS ");
+    return;
+  }
+
   if (line == "CLEAR_TOKEN") {
     nvsClearToken();
-    gToken = "";
-    gTokenLoaded = true;
+    setToken("");
     Serial.println("Token cleared from NVS ✅");
     return;
   }
@@ -112,69 +185,901 @@ void ai_pollSerial()
       Serial.println("SET_TOKEN needs a value.");
       return;
     }
+    gAwaitToken = false;
     nvsSaveToken(tok);
-    gToken = tok;
-    gTokenLoaded = true;
+    setToken(tok);
     Serial.println("Token saved to NVS ✅");
     return;
   }
 
-  Serial.println("Unknown command. Use CLEAR_TOKEN or SET_TOKEN <token>");
+  const String ctxPrefix = "SET_CONTEXT ";
+  if (line.startsWith(ctxPrefix)) {
+    long bytes = line.substring(ctxPrefix.length()).toInt();
+    if (bytes < 256 || bytes > AI_CONTEXT_MAX) {
+      Serial.printf("SET_CONTEXT needs 256..%d bytes.\n", AI_CONTEXT_MAX);
+      return;
+    }
+    gContextBudget = (uint16_t)bytes;
+    Preferences prefs;
+    prefs.begin(NVS_NS, false);
+    prefs.putUShort(NVS_KEY_CTX, gContextBudget);
+    prefs.end();
+    Serial.printf("Context budget: %u bytes (~%u tokens)\n", gContextBudget, gContextBudget / 4);
+    return;
+  }
+
+  const String tmoPrefix = "SET_TIMEOUTS ";
+  if (line.startsWith(tmoPrefix)) {
+    long c = 0, f = 0, t = 0;
+    if (sscanf(line.c_str() + tmoPrefix.length(), "%ld %ld %ld", &c, &f, &t) != 3 ||
+        c < 1000 || f < 1000 || t < c || t < f || t > 60000) {
+      Serial.println("Usage: SET_TIMEOUTS <connect_ms> <first_byte_ms> <total_ms> (total 60000 max)");
+      return;
+    }
+    gTimeouts.connectMs = (uint16_t)c;
+    gTimeouts.ttfbMs    = (uint16_t)f;
+    gTimeouts.totalMs   = (uint16_t)t;
+    Preferences prefs;
+    prefs.begin(NVS_NS, false);
+    prefs.putBytes(NVS_KEY_TMO, &gTimeouts, sizeof(gTimeouts));
+    prefs.end();
+    Serial.printf("Timeouts: connect %u ms, first byte %u ms, total %u ms\n",
+                  gTimeouts.connectMs, gTimeouts.ttfbMs, gTimeouts.totalMs);
+    return;
+  }
+
+  const String coalescePrefix = "SET_COALESCE ";
+  if (line.startsWith(coalescePrefix)) {
+    long ms = line.substring(coalescePrefix.length()).toInt();
+    if (ms < 0 || ms > 5000) {
+      Serial.println("SET_COALESCE needs 0..5000 ms.");
+      return;
+    }
+    gCoalesceMs = (uint16_t)ms;
+    Preferences prefs;
+    prefs.begin(NVS_NS, false);
+    prefs.putUShort(NVS_KEY_COALESCE, gCoalesceMs);
+    prefs.end();
+    Serial.printf("Coalescing window: %u ms\n", gCoalesceMs);
+    return;
+  }
+
+  if (line.startsWith("BACKEND_") && ai_busy()) {
+    Serial.println("AI request in flight, try again in a moment.");
+    return;
+  }
+  if (ai_backends_handleSerial(line)) return;
+
+  if (line == "CACHE") {
+    ai_cache_printStats(Serial);
+    return;
+  }
+
+  if (line == "CACHE_CLEAR") {
+    ai_cache_clear();
+    Serial.println("AI cache cleared.");
+    return;
+  }
+
+  if (line == "OFFLINE") {
+    ai_offline_printStats(Serial);
+    return;
+  }
+
+  const String askPrefix = "ASK_OFFLINE ";
+  if (line.startsWith(askPrefix)) {
+    Serial.println(offlineReply(line.substring(askPrefix.length())));
+    ai_offline_printStats(Serial);
+    return;
+  }
+
+  if (frame_handleSerial(line)) return;
+  if (wifi_link_handleSerial(line)) return;
+  if (wifi_app_handleSerial(line)) return;
+  if (wifi_mon_handleSerial(line)) return;
+  if (power_handleSerial(line)) return;
+
+  if (line == "PERF") {
+    ai_perf_print(Serial);
+    return;
+  }
+
+  if (line == "PERF_CLEAR") {
+    ai_perf_clear();
+    Serial.println("AI perf samples cleared.");
+    return;
+  }
+
+  if (line == "INFLATE_BENCH") {
+    ai_inflate_bench(Serial);
+    return;
+  }
+
+  if (line == "KB_BENCH") {
+    keyboard_bench(Serial);
+    return;
+  }
+
+  if (line == "CLEAR_SUMMARY") {
+    gSummary[0] = 0;
+    Serial.println("Chat summary cleared.");
+    return;
+  }
+
+  Serial.println("Unknown command. Use CLEAR_TOKEN, SET_TOKEN <token>, SET_CONTEXT <bytes>, SET_TIMEOUTS <c> <f> <t>, SET_COALESCE <ms>, CLEAR_SUMMARY, CACHE, CACHE_CLEAR, OFFLINE, ASK_OFFLINE <text>, PERF, FRAME, WIFI, WIFI_PRIO, WIFI_FORGET, WIFI_SCAN, LINK, LINK_PROBE, POWER, POWER_IDLE, INFLATE_BENCH, KB_BENCH or BACKENDS");
 }
 
-String ai_sendMessage(const String& userMessage)
+// ============================================================
+// Context window
+// ============================================================
+static void appendSummaryNote(const char* user, const char* ai)
 {
-  if (WiFi.status() != WL_CONNECTED) return "WiFi not connected";
+  char note[72];
+  snprintf(note, sizeof(note), "%.40s -> %.22s; ", user, ai);
+  size_t n = strlen(note);
+  size_t have = strlen(gSummary);
 
-  ensureTokenLoaded();
-  if (gToken.length() == 0) {
-    return "No token. Open Serial and run ai_begin() once.";
+  // drop the oldest notes until the new one fits
+  while (have + n > AI_SUMMARY_MAX) {
+    char* cut = strstr(gSummary, "; ");
+    if (!cut) { have = 0; break; }
+    cut += 2;
+    memmove(gSummary, cut, strlen(cut) + 1);
+    have = strlen(gSummary);
   }
+  memcpy(gSummary + have, note, n + 1);
+}
 
-  WiFiClientSecure client;
+static void foldTurn(const AiTurn& t)
+{
+  if (t.seq <= gSummarySeq) return;
+  gSummarySeq = t.seq;
+  appendSummaryNote(t.user, t.ai);
+}
 
-  client.setInsecure();
+void ai_forgetTurn(const AiTurn& turn)
+{
+  foldTurn(turn);
+}
+
+static int turnCost(const AiTurn& t)
+{
+  return (int)(strlen(t.user) + strlen(t.ai)) + TURN_OVERHEAD;
+}
+
+struct PromptPlan {
+  const char*   user;
+  const AiTurn* turns;     // oldest first, all of them go into the prompt
+  int           count;
+  const char*   summary;   // nullptr if none
+};
+
+// ============================================================
+// Request job
+// ============================================================
+#ifndef AI_ARENA_BYTES
+#define AI_ARENA_BYTES 4608
+#endif
+#define AI_MAX_TURNS 16
+
+enum JobResult : uint8_t { JOB_OK, JOB_ERROR, JOB_UNREACHABLE, JOB_CANCELLED };
+
+// One request in flight. The main loop fills it, the worker task runs it and
+// the main loop collects it in ai_poll(). Everything the worker reads is
+// copied in here first, so the chat can keep changing its history meanwhile.
+struct Job {
+  volatile AiState state;
+  volatile bool    cancel;
+
+  JobResult  result;
+  bool       fromCache;
+  bool       warm;          // went out on the pre-warmed connection
+  uint32_t   firstByteMs;   // SEND -> first response byte, 0 = never got one
+  uint32_t   phase[AI_PH_COUNT];
+  uint64_t   cacheKey;
+  bool       cacheable;   // no earlier turns or summary went with the prompt
+  uint32_t   startMs;
+
+  int        order[AI_MAX_BACKENDS];
+  int        orderCount;
+  int        backend;
+
+  char       token[128];
+  PromptPlan plan;
+  AiTurn     turns[AI_MAX_TURNS];
+  char       arena[AI_ARENA_BYTES];
+  char       reply[AI_REPLY_MAX + 8];
+  char       configError[64];   // a backend's 4xx/local error, shown if no other answers
+
+  InflateStream inflate;
+};
+
+static Job          gJob;
+static TaskHandle_t gWorker = nullptr;
+
+// ============================================================
+// Connection
+// ============================================================
+#ifndef AI_WARM_IDLE_MS
+#define AI_WARM_IDLE_MS 20000
+#endif
+
+// One connection at a time, owned by the worker task. After a warm-up it is
+// parked until the next request takes it or it sits idle too long.
+static WiFiClientSecure connTls;
+static WiFiClient       connPlain;
+static volatile bool    warmWanted = false;
+
+static bool     parked = false;
+static HttpUrl  parkedUrl;
+static uint32_t parkedAt = 0;
+
+static WiFiClient& connFor(const HttpUrl& url)
+{
+  if (url.tls) return connTls;
+  return connPlain;
+}
+
+static void closeParked()
+{
+  if (!parked) return;
+  connFor(parkedUrl).stop();
+  parked = false;
+}
 
-  HTTPClient http;
-  if (!http.begin(client, OLLAMA_URL)) {
-    return "HTTP begin failed";
+static bool parkedExpired()
+{
+  return parked && millis() - parkedAt >= AI_WARM_IDLE_MS;
+}
+
+// Hands out the parked connection if it goes where url goes and is still up.
+static bool takeParked(const HttpUrl& url)
+{
+  if (!parked) return false;
+  bool same = url.tls == parkedUrl.tls && url.port == parkedUrl.port &&
+              strcmp(url.host, parkedUrl.host) == 0;
+  bool ok = same && !parkedExpired() && connFor(url).connected();
+  if (!ok) closeParked();
+  parked = false;
+  return ok;
+}
+
+static bool connectTo(const HttpUrl& url, uint32_t timeoutMs)
+{
+  connTls.setInsecure();
+  connTls.setHandshakeTimeout((timeoutMs + 999) / 1000);
+  return connFor(url).connect(url.host, url.port, (int32_t)timeoutMs);
+}
+
+// DNS + TCP + TLS for the backend the next request will most likely use.
+static void warmUp()
+{
+  int order[AI_MAX_BACKENDS];
+  if (ai_backends_order(order, AI_MAX_BACKENDS) == 0) return;
+
+  HttpUrl url;
+  if (!http_parseUrl(ai_backends_get(order[0]).url, url)) return;
+  if (takeParked(url)) {
+    parked = true;     // still good, keep it parked
+    return;
+  }
+
+  uint32_t t0 = millis();
+  if (!connectTo(url, linkScaled(gTimeouts.connectMs))) {
+    Serial.printf("AI warm-up to %s failed\n", url.host);
+    return;
+  }
+  parkedUrl = url;
+  parkedAt  = millis();
+  parked    = true;
+  Serial.printf("AI connection to %s warmed up in %lu ms\n", url.host, (unsigned long)(parkedAt - t0));
+}
+
+static const int      MAX_RETRIES   = 2;     // per backend, for transient failures only
+static const uint32_t BACKOFF_MS    = 300;
+static const uint32_t BACKOFF_MAX   = 2000;
+
+static char* arenaCopy(char*& at, const char* end, const char* s)
+{
+  size_t n = strlen(s) + 1;
+  if (at + n > end) return nullptr;
+  char* out = at;
+  memcpy(out, s, n);
+  at += n;
+  return out;
+}
+
+// Keeps the newest turns that fit the budget and copies them into the job.
+// Everything older is folded into the running summary, which then stands in
+// for it. False if the message itself doesn't fit the arena.
+static bool planPrompt(Job& job, const char* user, const AiTurn* history, int n)
+{
+  int base = (int)gContextBudget - (int)strlen(PROMPT_RULES) - (int)strlen(user) - TURN_OVERHEAD;
+  int first = n;
+
+  for (int pass = 0; pass < 2; pass++) {
+    bool withSummary = (pass == 1) || gSummary[0];
+    int budget = base - (withSummary ? AI_SUMMARY_MAX + SUMMARY_OVERHEAD : 0);
+
+    first = n;
+    while (first > 0 && n - first < AI_MAX_TURNS) {
+      int cost = turnCost(history[first - 1]);
+      if (cost > budget) break;
+      budget -= cost;
+      first--;
+    }
+    if (first == 0 || withSummary) break;
   }
 
-  http.addHeader("Content-Type", "application/json");
-  http.addHeader("X-Auth", gToken);
+  for (int i = 0; i < first; i++) foldTurn(history[i]);
 
-  String prompt =
-    "Reply in 1 short sentence. No lists.\n"
-    "User: " + userMessage + "\nAssistant:";
+  char* at = job.arena;
+  const char* end = job.arena + sizeof(job.arena);
 
-  StaticJsonDocument<1024> req;
-  req["model"] = MODEL_NAME;
-  req["prompt"] = prompt;
-  req["stream"] = false;
+  job.plan.user    = arenaCopy(at, end, user);
+  if (!job.plan.user) return false;
+  job.plan.summary = gSummary[0] ? arenaCopy(at, end, gSummary) : nullptr;
+  job.plan.turns   = job.turns;
+  job.plan.count   = 0;
 
-  String payload;
-  serializeJson(req, payload);
+  for (int i = first; i < n; i++) {
+    AiTurn& t = job.turns[job.plan.count];
+    t.user = arenaCopy(at, end, history[i].user);
+    t.ai   = arenaCopy(at, end, history[i].ai);
+    t.seq  = history[i].seq;
+    if (!t.user || !t.ai) break;
+    job.plan.count++;
+  }
+  return true;
+}
+
+// ============================================================
+// Protocol adapters
+// ============================================================
+static void writeOllamaBody(Print& out, const PromptPlan& p, const char* model)
+{
+  JsonWriter j(out);
+  j.beginObject();
+  j.string("model", model);
+
+  j.beginString("prompt");
+  j.text(PROMPT_RULES);
+  if (p.summary) {
+    j.text("Earlier in this chat: ");
+    j.text(p.summary);
+    j.text("\n");
+  }
+  for (int i = 0; i < p.count; i++) {
+    j.text("User: ");
+    j.text(p.turns[i].user);
+    j.text("\n");
+    if (!p.turns[i].ai[0]) continue;   // answered together with the next turn
+    j.text("Assistant: ");
+    j.text(p.turns[i].ai);
+    j.text("\n");
+  }
+  j.text("User: ");
+  j.text(p.user);
+  j.text("\nAssistant:");
+  j.endString();
+
+  j.boolean("stream", false);
+  j.endObject();
+}
+
+static void writeMessage(JsonWriter& j, const char* role, const char* prefix, const char* content)
+{
+  j.beginObject();
+  j.string("role", role);
+  j.beginString("content");
+  if (prefix) j.text(prefix);
+  j.text(content);
+  j.endString();
+  j.endObject();
+}
+
+static void writeOpenAiBody(Print& out, const PromptPlan& p, const char* model)
+{
+  JsonWriter j(out);
+  j.beginObject();
+  j.string("model", model);
+  j.boolean("stream", false);
+
+  j.beginArray("messages");
+  writeMessage(j, "system", nullptr, PROMPT_RULES);
+  if (p.summary) writeMessage(j, "system", "Earlier in this chat: ", p.summary);
+  for (int i = 0; i < p.count; i++) {
+    writeMessage(j, "user", nullptr, p.turns[i].user);
+    if (p.turns[i].ai[0]) writeMessage(j, "assistant", nullptr, p.turns[i].ai);
+  }
+  writeMessage(j, "user", nullptr, p.user);
+  j.endArray();
+
+  j.endObject();
+}
+
+static void ollamaFilter(JsonDocument& f)          { f["response"] = true; }
+static const char* ollamaReply(JsonDocument& d)    { return d["response"] | ""; }
+
+static void openAiFilter(JsonDocument& f)          { f["choices"][0]["message"]["content"] = true; }
+static const char* openAiReply(JsonDocument& d)    { return d["choices"][0]["message"]["content"] | ""; }
+
+struct ProtoAdapter {
+  const char* authHeader;
+  void        (*writeBody)(Print& out, const PromptPlan& p, const char* model);
+  void        (*filter)(JsonDocument& f);
+  const char* (*reply)(JsonDocument& d);
+};
+
+// indexed by AiProto
+static const ProtoAdapter ADAPTERS[] = {
+  { "X-Auth: ",              writeOllamaBody, ollamaFilter, ollamaReply },
+  { "Authorization: Bearer ", writeOpenAiBody, openAiFilter, openAiReply },
+};
+
+static void clipReply(const char* text, char* out, size_t cap)
+{
+  while (*text == ' ' || *text == '\n' || *text == '\r' || *text == '\t') text++;
+  size_t n = strlen(text);
+  while (n > 0 && (text[n - 1] == ' ' || text[n - 1] == '\n' || text[n - 1] == '\r')) n--;
+
+  if (n <= AI_REPLY_MAX && n < cap) {
+    memcpy(out, text, n);
+    out[n] = 0;
+    return;
+  }
+
+  size_t cut = AI_REPLY_MAX < cap - 4 ? AI_REPLY_MAX : cap - 4;
+  size_t sp = cut;
+  while (sp > cut / 2 && text[sp] != ' ') sp--;
+  if (sp > cut / 2) cut = sp;
+
+  memcpy(out, text, cut);
+  strcpy(out + cut, "...");
+}
+
+// ============================================================
+// Request
+// ============================================================
+// Returns the HTTP status (200 = reply holds the answer), a negative value
+// when the endpoint couldn't be reached, or 0 for local/parse errors.
+// On failure reply holds an error text. uint32_t deadline bounds everything.
+static const int POST_CONNECT_FAILED = -1;
+static const int POST_SEND_FAILED    = -2;
+static const int POST_NO_RESPONSE    = -3;
+static const int POST_CANCELLED      = -4;
+
+// Each entry gets only its own credential, and none over plain http.
+static const char* backendToken(const Job& job, const AiBackend& be, const HttpUrl& url)
+{
+  if (!url.tls) return "";
+  if (be.auth == AI_AUTH_OWN) return be.token;
+  if (be.auth == AI_AUTH_DEVICE) return job.token;
+  return "";
+}
+
+static int postPrompt(Job& job, const AiBackend& be, uint32_t deadline)
+{
+  char*  reply = job.reply;
+  size_t cap   = sizeof(job.reply);
+
+  HttpUrl url;
+  if (!http_parseUrl(be.url, url)) { strlcpy(reply, "Bad AI URL", cap); return 0; }
+
+  const ProtoAdapter& ad = ADAPTERS[be.proto == AI_PROTO_OPENAI ? 1 : 0];
+
+  // First pass only counts, so the body never exists as a whole in RAM.
+  HttpOut counter(nullptr);
+  ad.writeBody(counter, job.plan, be.model);
+
+  int32_t left = (int32_t)(deadline - millis());
+  if (left <= 0) { strlcpy(reply, "Timed out", cap); return POST_NO_RESPONSE; }
+
+  for (int p = AI_PH_DNS; p <= AI_PH_RECV; p++) job.phase[p] = 0;
+
+  // plain http is for stand-in servers on the LAN
+  WiFiClient& client = connFor(url);
+
+  job.warm = takeParked(url);
+  if (!job.warm) {
+    // resolve on our own to time it; connect() then hits lwIP's DNS cache
+    uint32_t t0 = millis();
+    IPAddress ip;
+    if (!WiFi.hostByName(url.host, ip)) {
+      strlcpy(reply, "DNS failed", cap);
+      return POST_CONNECT_FAILED;
+    }
+    uint32_t t1 = millis();
+    job.phase[AI_PH_DNS] = t1 - t0;
+
+    uint32_t connectMs = linkScaled(gTimeouts.connectMs);
+    if (connectMs > (uint32_t)left) connectMs = (uint32_t)left;
+    if (!connectTo(url, connectMs)) {
+      strlcpy(reply, "Connect failed", cap);
+      return POST_CONNECT_FAILED;
+    }
+    job.phase[AI_PH_CONNECT] = millis() - t1;
+  }
+  if (job.cancel) { client.stop(); return POST_CANCELLED; }
+
+  uint32_t sendAt = millis();
+  HttpOut out(&client);
+  out.print("POST ");
+  out.print(url.path);
+  out.print(" HTTP/1.1\r\nHost: ");
+  out.print(url.host);
+  out.print("\r\nContent-Type: application/json\r\n");
+  const char* token = backendToken(job, be, url);
+  if (token[0]) {
+    out.print(ad.authHeader);
+    out.print(token);
+    out.print("\r\n");
+  }
+  out.print("Content-Length: ");
+  out.print((unsigned long)counter.count());
+  out.print("\r\nAccept-Encoding: gzip, deflate\r\nConnection: close\r\n\r\n");
+  ad.writeBody(out, job.plan, be.model);
+  out.flush();
+
+  if (out.failed()) {
+    client.stop();
+    strlcpy(reply, "Send failed", cap);
+    return POST_SEND_FAILED;
+  }
+
+  uint32_t sentAt = millis();
+  job.phase[AI_PH_SEND] = sentAt - sendAt;
+
+  left = (int32_t)(deadline - millis());
+  uint32_t ttfb = linkScaled(gTimeouts.ttfbMs);
+  if (left < (int32_t)ttfb) ttfb = left > 0 ? (uint32_t)left : 0;
+
+  HttpBody body;
+  body.setTimeout(5000);
+  body.setAbort(&job.cancel, deadline);
+
+  uint32_t firstAt = 0;
+  int code = http_readHead(client, body, ttfb, &job.cancel, &firstAt);
+  if (code >= 0) {
+    job.firstByteMs = firstAt - job.startMs;
+    job.phase[AI_PH_WAIT] = firstAt - sentAt;
+  }
+  if (code < 0) {
+    client.stop();
+    if (job.cancel) return POST_CANCELLED;
+    strlcpy(reply, "No response", cap);
+    return POST_NO_RESPONSE;
+  }
+
+  // compressed bodies are inflated on the fly as the parser pulls bytes
+  Stream* in = &body;
+  if (body.encoding() != HTTP_ENC_IDENTITY) {
+    job.inflate.begin(&body, body.encoding() == HTTP_ENC_GZIP ? InflateStream::GZIP : InflateStream::ZLIB);
+    in = &job.inflate;
+  }
 
-  int code = http.POST(payload);
   if (code != 200) {
-    String err = "HTTP " + String(code);
-    String body = http.getString();
-    http.end();
+    int n = snprintf(reply, cap, "HTTP %d ", code);
+    while (n < (int)cap - 1) {
+      int c = in->read();
+      if (c < 0) break;
+      reply[n++] = (char)c;
+    }
+    reply[n] = 0;
+    client.stop();
 
-    if (code == 401) return "401 Unauthorized (token?)";
-    if (body.length() > 0) return err + " " + body;
-    return err;
+    if (code == 401) strlcpy(reply, "401 Unauthorized (token?)", cap);
+    return code;
   }
 
-  String body = http.getString();
-  http.end();
+  StaticJsonDocument<96> filter;
+  ad.filter(filter);
 
-  StaticJsonDocument<4096> resp;
-  if (deserializeJson(resp, body)) return "JSON error";
+  StaticJsonDocument<2048> resp;
+  DeserializationError e = deserializeJson(resp, *in, DeserializationOption::Filter(filter));
+  job.phase[AI_PH_RECV] = millis() - firstAt;
+  wifi_mon_noteTransfer(body.received(), job.phase[AI_PH_RECV]);
+  client.stop();
+  if (job.cancel) return POST_CANCELLED;
 
-  String out = resp["response"].as<String>();
-  out.trim();
+  if (in == &job.inflate) {
+    Serial.printf("AI body: %u bytes compressed -> %u bytes%s\n", (unsigned)job.inflate.consumed(),
+                  (unsigned)job.inflate.produced(), job.inflate.failed() ? " (inflate error)" : "");
+  }
+  if (e) { strlcpy(reply, "JSON error", cap); return 0; }
 
-  if (out.length() > 120) out = out.substring(0, 120) + "...";
-  return out;
+  clipReply(ad.reply(resp), reply, cap);
+  return 200;
+}
+
+// Worth retrying on the same backend: nothing reached the model, or the
+// endpoint said so explicitly. Read timeouts go straight to the next backend.
+static bool isTransient(int code)
+{
+  return code == POST_CONNECT_FAILED || code == POST_SEND_FAILED ||
+         code == 429 || code == 502 || code == 503 || code == 504;
+}
+
+// Sleeps in small slices so a cancel or the deadline cuts the wait short.
+static bool backoff(Job& job, int attempt, uint32_t deadline)
+{
+  uint32_t ms = BACKOFF_MS << attempt;
+  if (ms > BACKOFF_MAX) ms = BACKOFF_MAX;
+  ms += random(ms / 4 + 1);
+
+  uint32_t until = millis() + ms;
+  while ((int32_t)(millis() - until) < 0) {
+    if (job.cancel || (int32_t)(millis() - deadline) >= 0) return false;
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  return true;
+}
+
+// Nobody answered. A backend that rejected the request says more than the
+// offline responder would.
+static void failJob(Job& job)
+{
+  job.result = JOB_UNREACHABLE;
+  if (!job.configError[0]) return;
+  strlcpy(job.reply, job.configError, sizeof(job.reply));
+  job.result = JOB_ERROR;
+}
+
+static void runJob(Job& job)
+{
+  uint32_t deadline = job.startMs + gTimeouts.totalMs;
+  job.result = JOB_UNREACHABLE;
+  job.configError[0] = 0;
+  job.phase[AI_PH_QUEUE] = millis() - job.startMs;
+
+  for (int k = 0; k < job.orderCount; k++) {
+    const AiBackend& be = ai_backends_get(job.order[k]);
+
+    for (int attempt = 0; attempt <= MAX_RETRIES; attempt++) {
+      uint32_t t1 = millis();
+      int code = postPrompt(job, be, deadline);
+      uint32_t ms = millis() - t1;
+
+      if (code == POST_CANCELLED || job.cancel) {
+        job.result = JOB_CANCELLED;
+        return;
+      }
+
+      if (code == 200) {
+        job.phase[AI_PH_TOTAL] = millis() - job.startMs;
+        ai_backends_report(job.order[k], true, ms);
+        job.backend = job.order[k];
+        // stored under the model that answered, which failover may have changed
+        job.cacheKey = ai_cache_key(be.model, PROMPT_RULES, job.plan.user);
+        job.result = JOB_OK;
+        return;
+      }
+
+      // Too big for any backend; the others would say the same.
+      if (code == 413) {
+        job.result = JOB_ERROR;
+        return;
+      }
+
+      ai_backends_report(job.order[k], false, ms);
+      Serial.printf("AI backend #%d attempt %d failed (%s)\n", job.order[k], attempt + 1, job.reply);
+
+      // Other client errors (400, 401, 404, bad URL, bad JSON) are this
+      // backend's config: it cools down and the next one gets a go.
+      if (code >= 0 && code < 500 && code != 429) {
+        if (!job.configError[0]) strlcpy(job.configError, job.reply, sizeof(job.configError));
+        break;
+      }
+
+      if (!isTransient(code) || attempt == MAX_RETRIES) break;
+      if (!backoff(job, attempt, deadline)) break;
+    }
+
+    if (job.cancel) { job.result = JOB_CANCELLED; return; }
+    if ((int32_t)(millis() - deadline) >= 0) break;
+  }
+  failJob(job);
+}
+
+static void workerTask(void*)
+{
+  for (;;) {
+    TickType_t wait = portMAX_DELAY;
+    if (parked) {
+      uint32_t idle = millis() - parkedAt;
+      wait = pdMS_TO_TICKS(idle < AI_WARM_IDLE_MS ? AI_WARM_IDLE_MS - idle : 0);
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
+
+    if (parkedExpired()) {
+      closeParked();
+      Serial.println("AI warm connection idle, closed");
+    }
+
+    if (warmWanted) {
+      warmWanted = false;
+      if (gJob.state != AI_BUSY) warmUp();
+    }
+
+    if (gJob.state != AI_BUSY) continue;
+    runJob(gJob);
+    gJob.state = AI_DONE;
+  }
+}
+
+static void ensureWorker()
+{
+  if (gWorker) return;
+  xTaskCreatePinnedToCore(workerTask, "ai", 12 * 1024, nullptr, 1, &gWorker, 0);
+}
+
+// Without a SET_TOKEN token only entries with their own (or no) auth can answer.
+static bool anyWithoutDeviceToken(const Job& job)
+{
+  for (int k = 0; k < job.orderCount; k++)
+    if (ai_backends_get(job.order[k]).auth != AI_AUTH_DEVICE) return true;
+  return false;
+}
+
+static String offlineReply(const String& userMessage)
+{
+  String reply;
+  ai_offline_reply(userMessage.c_str(), reply);
+  return "[offline] " + reply;
+}
+
+// ============================================================
+// Public
+// ============================================================
+bool ai_busy()
+{
+  return gJob.state != AI_IDLE;
+}
+
+bool ai_start(const char* userMessage, const AiTurn* history, int historyCount)
+{
+  if (gJob.state != AI_IDLE) return false;
+
+  Job& job = gJob;
+  job.cancel    = false;
+  job.fromCache = false;
+  job.warm      = false;
+  job.firstByteMs = 0;
+  job.backend   = -1;
+  job.startMs   = millis();
+  job.reply[0]  = 0;
+
+  job.orderCount = ai_backends_order(job.order, AI_MAX_BACKENDS);
+  job.cacheKey = ai_cache_key(ai_backends_get(job.order[0]).model, PROMPT_RULES, userMessage);
+  // The key only covers the message; a reply given in a conversation
+  // neither comes from nor goes into the cache.
+  job.cacheable = historyCount == 0 && !gSummary[0];
+
+  char* at = job.arena;
+  job.plan.user = arenaCopy(at, job.arena + sizeof(job.arena), userMessage);
+  if (!job.plan.user) {
+    strlcpy(job.reply, "Message too long.", sizeof(job.reply));
+    job.result = JOB_ERROR;
+    job.state = AI_DONE;
+    return true;
+  }
+
+  if (job.cacheable && ai_cache_get(job.cacheKey, job.reply, sizeof(job.reply))) {
+    job.fromCache = true;
+    job.result = JOB_OK;
+    job.state = AI_DONE;
+    return true;
+  }
+
+  if (WiFi.status() != WL_CONNECTED) {
+    job.result = JOB_UNREACHABLE;
+    job.state = AI_DONE;
+    return true;
+  }
+
+  ensureTokenLoaded();
+  if (!gToken[0] && !anyWithoutDeviceToken(job)) {
+    strlcpy(job.reply, "No token. Open Serial and run SET_TOKEN <token>.", sizeof(job.reply));
+    job.result = JOB_ERROR;
+    job.state = AI_DONE;
+    return true;
+  }
+  strlcpy(job.token, gToken, sizeof(job.token));
+
+  planPrompt(job, userMessage, history, historyCount);   // user already known to fit
+
+  ensureWorker();
+  job.state = AI_BUSY;
+  xTaskNotifyGive(gWorker);
+  return true;
+}
+
+// SEND -> first byte, split by whether the request found a warm connection.
+static void logFirstByte(const Job& job)
+{
+  static uint32_t sum[2] = { 0, 0 };
+  static uint32_t n[2]   = { 0, 0 };
+
+  int w = job.warm ? 1 : 0;
+  sum[w] += job.firstByteMs;
+  n[w]++;
+
+  Serial.printf("AI first byte %lu ms (%s); avg warm %lu ms x%lu, cold %lu ms x%lu\n",
+                (unsigned long)job.firstByteMs, job.warm ? "warm" : "cold",
+                (unsigned long)(n[1] ? sum[1] / n[1] : 0), (unsigned long)n[1],
+                (unsigned long)(n[0] ? sum[0] / n[0] : 0), (unsigned long)n[0]);
+}
+
+static void logPhases(const Job& job)
+{
+  ai_perf_record(job.phase);
+
+  Serial.print("AI phases:");
+  for (int p = 0; p < AI_PH_COUNT; p++) {
+    Serial.printf(" %s %lu", ai_perf_phaseName(p), (unsigned long)job.phase[p]);
+  }
+  Serial.println(" ms");
+}
+
+uint16_t ai_coalesceMs()
+{
+  return gCoalesceMs;
+}
+
+void ai_prewarm()
+{
+  if (gJob.state != AI_IDLE || WiFi.status() != WL_CONNECTED) return;
+  ensureWorker();
+  warmWanted = true;
+  xTaskNotifyGive(gWorker);
+}
+
+AiState ai_poll(String& reply, bool* fromModel)
+{
+  if (gJob.state != AI_DONE) return gJob.state;
+
+  Job& job = gJob;
+  uint32_t ms = millis() - job.startMs;
+  if (fromModel) *fromModel = job.result == JOB_OK;
+
+  switch (job.result) {
+    case JOB_OK:
+      reply = job.reply;
+      if (job.fromCache) {
+        Serial.printf("AI cache hit (%lu ms)\n", (unsigned long)ms);
+      } else {
+        if (job.cacheable) ai_cache_put(job.cacheKey, job.reply);
+        Serial.printf("AI reply from #%d (%lu ms)\n", job.backend, (unsigned long)ms);
+        logFirstByte(job);
+        logPhases(job);
+      }
+      break;
+    case JOB_ERROR:
+      reply = job.reply;
+      break;
+    case JOB_CANCELLED:
+      reply = "(cancelled)";
+      Serial.printf("AI request cancelled after %lu ms\n", (unsigned long)ms);
+      break;
+    case JOB_UNREACHABLE:
+      if (WiFi.status() == WL_CONNECTED) Serial.println("All AI backends failed, using offline responder");
+      reply = offlineReply(job.plan.user ? job.plan.user : "");
+      break;
+  }
+
+  job.state = AI_IDLE;
+  return AI_DONE;
+}
+
+void ai_cancel()
+{
+  if (gJob.state == AI_BUSY) gJob.cancel = true;
+}
+
+String ai_sendMessage(const String& userMessage, const AiTurn* history, int historyCount)
+{
+  String reply;
+  if (!ai_start(userMessage.c_str(), history, historyCount)) return "AI busy";
+  while (ai_poll(reply) != AI_DONE) delay(10);
+  return reply;
 }
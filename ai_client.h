@@ -1,6 +1,51 @@
 #pragma once
 #include <Arduino.h>
 
+// Longest reply kept from the model (chars, without the trailing "...").
+#ifndef AI_REPLY_MAX
+#define AI_REPLY_MAX 300
+#endif
+
+// One earlier exchange from the chat. ai is empty for a message that was
+// answered together with the next one. seq grows by one per turn and lets the
+// client know which turns it has already folded into its summary.
+struct AiTurn {
+  const char* user;
+  const char* ai;
+  uint32_t    seq;
+};
+
 void ai_begin();
 void ai_pollSerial();
-String ai_sendMessage(const String& userMessage);
+
+enum AiState : uint8_t {
+  AI_IDLE,
+  AI_BUSY,    // request running on the worker task
+  AI_DONE     // reply ready, collect it with ai_poll()
+};
+
+// Starts a request in the background and returns right away; false if one is
+// already running. history is oldest-first, may be empty, and is copied, so
+// the caller may change it while the request runs.
+bool    ai_start(const char* userMessage, const AiTurn* history = nullptr, int historyCount = 0);
+// Returns AI_DONE once, with reply filled in; the client is idle again after.
+// fromModel says whether reply is the model's answer (live or cached) rather
+// than an error, "(cancelled)" or the offline responder.
+AiState ai_poll(String& reply, bool* fromModel = nullptr);
+// Aborts the running request. ai_poll() still reports it, as "(cancelled)".
+void    ai_cancel();
+bool    ai_busy();
+
+// Opens the connection to the preferred backend in the background so the next
+// ai_start() skips DNS/TCP/TLS. It is closed again after a short idle time.
+void    ai_prewarm();
+
+// How long the chat holds a new message so quick follow-ups can share one
+// request (SET_COALESCE, stored in NVS).
+uint16_t ai_coalesceMs();
+
+// Blocking wrapper around ai_start()/ai_poll().
+String ai_sendMessage(const String& userMessage, const AiTurn* history = nullptr, int historyCount = 0);
+
+// Called by the chat when a turn falls out of its history buffer.
+void ai_forgetTurn(const AiTurn& turn);
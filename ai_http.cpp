@@ -0,0 +1,294 @@
+#include "ai_http.h"
+#include <strings.h>
+
+bool http_parseUrl(const char* url, HttpUrl& out)
+{
+  const char* p = url;
+  if (strncmp(p, "https://", 8) == 0) { out.tls = true;  out.port = 443; p += 8; }
+  else if (strncmp(p, "http://", 7) == 0) { out.tls = false; out.port = 80; p += 7; }
+  else return false;
+
+  size_t h = 0;
+  while (*p && *p != '/' && *p != ':') {
+    if (h + 1 >= sizeof(out.host)) return false;
+    out.host[h++] = *p++;
+  }
+  out.host[h] = 0;
+  if (h == 0) return false;
+
+  if (*p == ':') {
+    p++;
+    out.port = (uint16_t)atoi(p);
+    while (*p && *p != '/') p++;
+  }
+
+  if (*p == 0) p = "/";
+  if (strlen(p) + 1 > sizeof(out.path)) return false;
+  strcpy(out.path, p);
+  return true;
+}
+
+// ============================================================
+// HttpOut
+// ============================================================
+size_t HttpOut::write(uint8_t b)
+{
+  return write(&b, 1);
+}
+
+size_t HttpOut::write(const uint8_t* b, size_t n)
+{
+  total += n;
+  if (!client) return n;
+
+  size_t left = n;
+  while (left > 0) {
+    size_t room = sizeof(buf) - used;
+    size_t take = left < room ? left : room;
+    memcpy(buf + used, b, take);
+    used += take;
+    b    += take;
+    left -= take;
+    if (used == sizeof(buf)) flush();
+  }
+  return n;
+}
+
+void HttpOut::flush()
+{
+  if (!client || used == 0) return;
+  if (client->write(buf, used) != used) err = true;
+  used = 0;
+}
+
+void json_writeEscaped(Print& out, const char* s)
+{
+  const char* run = s;
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    const char* esc = nullptr;
+    if (c == '"')       esc = "\\\"";
+    else if (c == '\\') esc = "\\\\";
+    else if (c == '\n') esc = "\\n";
+    else if (c == '\r') esc = "\\r";
+    else if (c == '\t') esc = "\\t";
+    else if (c >= 0x20) continue;
+
+    if (s > run) out.write((const uint8_t*)run, s - run);
+    if (esc) {
+      out.print(esc);
+    } else {
+      static const char hex[] = "0123456789abcdef";
+      char u[7] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF], 0 };
+      out.print(u);
+    }
+    run = s + 1;
+  }
+  if (s > run) out.write((const uint8_t*)run, s - run);
+}
+
+// ============================================================
+// JsonWriter
+// ============================================================
+void JsonWriter::member(const char* key)
+{
+  uint16_t bit = 1u << depth;
+  if (depth > 0) {
+    if (used & bit) out.write(',');
+    used |= bit;
+  }
+  if (key && !(array & bit)) {
+    out.write('"');
+    json_writeEscaped(out, key);
+    out.print("\":");
+  }
+}
+
+void JsonWriter::open(const char* key, char c)
+{
+  member(key);
+  out.write(c);
+  if (depth < 15) depth++;
+  uint16_t bit = 1u << depth;
+  used &= ~bit;
+  if (c == '[') array |= bit;
+  else array &= ~bit;
+}
+
+void JsonWriter::close(char c)
+{
+  if (depth > 0) depth--;
+  out.write(c);
+}
+
+void JsonWriter::string(const char* key, const char* value)
+{
+  beginString(key);
+  text(value);
+  endString();
+}
+
+void JsonWriter::boolean(const char* key, bool value)
+{
+  member(key);
+  out.print(value ? "true" : "false");
+}
+
+void JsonWriter::beginString(const char* key)
+{
+  member(key);
+  out.write('"');
+}
+
+// ============================================================
+// Response head
+// ============================================================
+static int readLine(Client& c, char* buf, size_t cap, uint32_t deadline, volatile bool* abort)
+{
+  size_t n = 0;
+  while ((int32_t)(millis() - deadline) < 0) {
+    if (abort && *abort) return -1;
+    int ch = c.read();
+    if (ch < 0) {
+      if (!c.connected()) return -1;
+      delay(1);
+      continue;
+    }
+    if (ch == '\n') {
+      buf[n] = 0;
+      return (int)n;
+    }
+    if (ch != '\r' && n + 1 < cap) buf[n++] = (char)ch;
+  }
+  return -1;
+}
+
+int http_readHead(Client& c, HttpBody& body, uint32_t timeoutMs, volatile bool* abort,
+                  uint32_t* firstByteAt)
+{
+  char line[128];
+  uint32_t deadline = millis() + timeoutMs;
+
+  if (firstByteAt) {
+    while (!c.available() && c.connected() && (int32_t)(millis() - deadline) < 0) {
+      if (abort && *abort) return -1;
+      delay(1);
+    }
+    *firstByteAt = millis();
+  }
+
+  if (readLine(c, line, sizeof(line), deadline, abort) < 0) return -1;
+  const char* sp = strchr(line, ' ');
+  if (strncmp(line, "HTTP/", 5) != 0 || !sp) return -2;
+  int code = atoi(sp + 1);
+
+  long contentLength = -1;
+  bool chunked = false;
+  HttpEncoding enc = HTTP_ENC_IDENTITY;
+
+  while (true) {
+    int n = readLine(c, line, sizeof(line), deadline, abort);
+    if (n < 0) return -1;
+    if (n == 0) break;
+
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      contentLength = atol(line + 15);
+    } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+      chunked = strstr(line + 18, "chunked") != nullptr;
+    } else if (strncasecmp(line, "Content-Encoding:", 17) == 0) {
+      if (strstr(line + 17, "gzip")) enc = HTTP_ENC_GZIP;
+      else if (strstr(line + 17, "deflate")) enc = HTTP_ENC_DEFLATE;
+    }
+  }
+
+  body.begin(&c, chunked ? 0 : contentLength, chunked, enc);
+  return code;
+}
+
+// ============================================================
+// HttpBody
+// ============================================================
+void HttpBody::begin(Client* c, long contentLength, bool isChunked, HttpEncoding encoding)
+{
+  client    = c;
+  remaining = contentLength;
+  chunked   = isChunked;
+  finished  = (!chunked && contentLength == 0);
+  peeked    = -1;
+  got       = 0;
+  enc       = encoding;
+}
+
+void HttpBody::setAbort(volatile bool* flag, uint32_t deadlineMs)
+{
+  abortFlag = flag;
+  deadline  = deadlineMs;
+  bounded   = true;
+}
+
+// Ends the body early on cancel or when the deadline passes. Dropping
+// _timeout makes Stream::timedRead() give up right away too.
+bool HttpBody::aborted()
+{
+  if ((abortFlag && *abortFlag) || (bounded && (int32_t)(millis() - deadline) >= 0)) {
+    finished = true;
+    _timeout = 0;
+    return true;
+  }
+  return false;
+}
+
+bool HttpBody::nextChunk()
+{
+  char line[24];
+  uint32_t until = millis() + _timeout;
+  if (bounded && (int32_t)(until - deadline) > 0) until = deadline;
+
+  // size line, skipping the CRLF that ends the previous chunk
+  int n;
+  do {
+    n = readLine(*client, line, sizeof(line), until, abortFlag);
+    if (n < 0) { finished = true; return false; }
+  } while (n == 0);
+
+  remaining = strtol(line, nullptr, 16);
+  if (remaining <= 0) {
+    finished = true;
+    return false;
+  }
+  return true;
+}
+
+int HttpBody::available()
+{
+  if (peeked >= 0) return 1;
+  if (finished || !client) return 0;
+  return client->available() > 0 ? 1 : 0;
+}
+
+int HttpBody::read()
+{
+  if (peeked >= 0) {
+    int c = peeked;
+    peeked = -1;
+    return c;
+  }
+  if (finished || !client || aborted()) return -1;
+  if (chunked && remaining == 0 && !nextChunk()) return -1;
+
+  int c = client->read();
+  if (c < 0) {
+    if (remaining < 0 && !client->connected()) finished = true;
+    return -1;
+  }
+
+  got++;
+  if (remaining > 0 && --remaining == 0 && !chunked) finished = true;
+  return c;
+}
+
+int HttpBody::peek()
+{
+  if (peeked < 0) peeked = read();
+  return peeked;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+struct HttpUrl {
+  char     host[64];
+  char     path[96];
+  uint16_t port;
+  bool     tls;
+};
+
+bool http_parseUrl(const char* url, HttpUrl& out);
+
+// Small write buffer in front of the socket so escaped JSON written byte by
+// byte doesn't turn into one TLS record per byte. With client == nullptr it
+// only counts, which gives us Content-Length without building the body.
+class HttpOut : public Print {
+public:
+  explicit HttpOut(Client* c) : client(c) {}
+
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* b, size_t n) override;
+  void   flush() override;
+
+  size_t count() const { return total; }
+  bool   failed() const { return err; }
+
+private:
+  Client* client;
+  uint8_t buf[256];
+  size_t  used  = 0;
+  size_t  total = 0;
+  bool    err   = false;
+};
+
+// Writes s as the inside of a JSON string literal (no surrounding quotes).
+void json_writeEscaped(Print& out, const char* s);
+
+// Streams JSON with escaping and comma bookkeeping, so request bodies go
+// straight to the socket with no document or String in between.
+// Keys are ignored inside arrays; nesting is limited to 15 levels.
+class JsonWriter {
+public:
+  explicit JsonWriter(Print& o) : out(o) {}
+
+  void beginObject(const char* key = nullptr) { open(key, '{'); }
+  void endObject()                            { close('}'); }
+  void beginArray(const char* key = nullptr)  { open(key, '['); }
+  void endArray()                             { close(']'); }
+
+  void string(const char* key, const char* value);
+  void boolean(const char* key, bool value);
+
+  // String value written in pieces: beginString(key), text()..., endString().
+  void beginString(const char* key = nullptr);
+  void text(const char* s) { json_writeEscaped(out, s); }
+  void endString()         { out.write('"'); }
+
+private:
+  void member(const char* key);
+  void open(const char* key, char c);
+  void close(char c);
+
+  Print&   out;
+  uint16_t used  = 0;    // bit per level: level already has an element
+  uint16_t array = 0;    // bit per level: level is an array
+  uint8_t  depth = 0;
+};
+
+enum HttpEncoding : uint8_t { HTTP_ENC_IDENTITY, HTTP_ENC_GZIP, HTTP_ENC_DEFLATE };
+
+// Response body as a Stream: hides Content-Length / chunked / read-until-close
+// so ArduinoJson can parse straight off the socket.
+class HttpBody : public Stream {
+public:
+  void begin(Client* c, long contentLength, bool chunked, HttpEncoding enc = HTTP_ENC_IDENTITY);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t) override { return 0; }
+
+  bool         done() const     { return finished; }
+  HttpEncoding encoding() const { return enc; }
+  size_t       received() const { return got; }   // body bytes off the wire
+
+  // Stop early once *flag turns true or millis() passes deadlineMs.
+  void setAbort(volatile bool* flag, uint32_t deadlineMs);
+
+private:
+  bool nextChunk();
+  bool aborted();
+
+  Client* client = nullptr;
+  long    remaining = -1;   // bytes left in body / current chunk, -1 = until close
+  bool    chunked   = false;
+  bool    finished  = false;
+  int     peeked    = -1;
+  size_t  got       = 0;
+  HttpEncoding enc  = HTTP_ENC_IDENTITY;
+
+  volatile bool* abortFlag = nullptr;
+  uint32_t       deadline  = 0;
+  bool           bounded   = false;
+};
+
+// Reads the status line and headers. Returns the HTTP status code, or a
+// negative value on timeout / malformed response / *abort turning true.
+// firstByteAt, if given, gets the millis() the response started arriving.
+int http_readHead(Client& c, HttpBody& body, uint32_t timeoutMs, volatile bool* abort = nullptr,
+                  uint32_t* firstByteAt = nullptr);
@@ -0,0 +1,415 @@
+#include "ai_inflate.h"
+
+// Canonical-Huffman decoder after zlib's contrib/puff: small tables, one bit
+// at a time. Plenty for a couple of KB of JSON.
+
+static const uint16_t LEN_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LEN_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DIST_BASE[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DIST_EXTRA[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t CODE_ORDER[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+void InflateStream::begin(Stream* s, Format f)
+{
+  src        = s;
+  format     = f;
+  state      = S_HEADER;
+  lastBlock  = false;
+  err        = false;
+  bitBuf     = 0;
+  bitCnt     = 0;
+  storedLeft = 0;
+  copyLeft   = 0;
+  peeked     = -1;
+  in         = 0;
+  pos        = 0;
+
+  // read() blocks on src itself, so Stream::timedRead() needn't wait on us
+  setTimeout(0);
+}
+
+// ============================================================
+// Input
+// ============================================================
+int InflateStream::inByte()
+{
+  uint8_t c;
+  if (src->readBytes(&c, 1) != 1) {
+    err = true;
+    return -1;
+  }
+  in++;
+  return c;
+}
+
+int InflateStream::bits(int n)
+{
+  while (bitCnt < n) {
+    int c = inByte();
+    if (c < 0) return 0;
+    bitBuf |= (uint32_t)c << bitCnt;
+    bitCnt += 8;
+  }
+  int v = (int)(bitBuf & ((1UL << n) - 1));
+  bitBuf >>= n;
+  bitCnt -= n;
+  return v;
+}
+
+int InflateStream::fail()
+{
+  state = S_ERROR;
+  copyLeft = 0;
+  return -1;
+}
+
+// ============================================================
+// Huffman
+// ============================================================
+// Returns 0 for a complete code, > 0 for an incomplete one, < 0 if the
+// lengths are over-subscribed.
+int InflateStream::build(Huffman& h, const uint8_t* lengths, int n)
+{
+  memset(h.count, 0, sizeof(h.count));
+  for (int i = 0; i < n; i++) h.count[lengths[i]]++;
+  if (h.count[0] == n) return 0;
+
+  int left = 1;
+  for (int len = 1; len < 16; len++) {
+    left <<= 1;
+    left -= h.count[len];
+    if (left < 0) return left;
+  }
+
+  uint16_t offs[16];
+  offs[1] = 0;
+  for (int len = 1; len < 15; len++) offs[len + 1] = offs[len] + h.count[len];
+  for (int i = 0; i < n; i++) {
+    if (lengths[i]) h.symbol[offs[lengths[i]]++] = i;
+  }
+  return left;
+}
+
+int InflateStream::decode(const Huffman& h)
+{
+  int code = 0, first = 0, index = 0;
+  for (int len = 1; len < 16; len++) {
+    code |= bits(1);
+    if (err) return -1;
+    int count = h.count[len];
+    if (code - count < first) return h.symbol[index + (code - first)];
+    index += count;
+    first += count;
+    first <<= 1;
+    code  <<= 1;
+  }
+  return -1;
+}
+
+void InflateStream::useFixed()
+{
+  uint8_t lengths[288];
+  int i = 0;
+  for (; i < 144; i++) lengths[i] = 8;
+  for (; i < 256; i++) lengths[i] = 9;
+  for (; i < 280; i++) lengths[i] = 7;
+  for (; i < 288; i++) lengths[i] = 8;
+  build(lencode, lengths, 288);
+
+  for (i = 0; i < 30; i++) lengths[i] = 5;
+  build(distcode, lengths, 30);
+}
+
+bool InflateStream::readDynamic()
+{
+  uint8_t lengths[288 + 32];
+
+  int nlen  = bits(5) + 257;
+  int ndist = bits(5) + 1;
+  int ncode = bits(4) + 4;
+  if (err || nlen > 286 || ndist > 30) return false;
+
+  int i = 0;
+  for (; i < ncode; i++) lengths[CODE_ORDER[i]] = bits(3);
+  for (; i < 19; i++) lengths[CODE_ORDER[i]] = 0;
+  if (err || build(lencode, lengths, 19) != 0) return false;
+
+  i = 0;
+  while (i < nlen + ndist) {
+    int sym = decode(lencode);
+    if (sym < 0) return false;
+
+    if (sym < 16) {
+      lengths[i++] = sym;
+      continue;
+    }
+
+    int len = 0, rep;
+    if (sym == 16) {
+      if (i == 0) return false;
+      len = lengths[i - 1];
+      rep = 3 + bits(2);
+    } else if (sym == 17) {
+      rep = 3 + bits(3);
+    } else {
+      rep = 11 + bits(7);
+    }
+    if (err || i + rep > nlen + ndist) return false;
+    while (rep--) lengths[i++] = len;
+  }
+
+  if (lengths[256] == 0) return false;   // no end-of-block code
+
+  // incomplete codes are legal (a lone distance code, say); decode() fails
+  // on the unused bit patterns
+  if (build(lencode, lengths, nlen) < 0) return false;
+  if (build(distcode, lengths + nlen, ndist) < 0) return false;
+  return true;
+}
+
+// ============================================================
+// Framing
+// ============================================================
+bool InflateStream::readHeader()
+{
+  if (format == ZLIB) {
+    int cmf = inByte();
+    int flg = inByte();
+    if (err || (cmf & 0x0F) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20)) return false;
+    return true;
+  }
+
+  uint8_t h[10];
+  for (int i = 0; i < 10; i++) h[i] = inByte();
+  if (err || h[0] != 0x1F || h[1] != 0x8B || h[2] != 8) return false;
+
+  uint8_t flags = h[3];
+  if (flags & 0x04) {                     // FEXTRA
+    int n = inByte();
+    n |= inByte() << 8;
+    while (n-- > 0 && !err) inByte();
+  }
+  if (flags & 0x08) while (inByte() > 0) {}   // FNAME
+  if (flags & 0x10) while (inByte() > 0) {}   // FCOMMENT
+  if (flags & 0x02) { inByte(); inByte(); }  // FHCRC
+  return !err;
+}
+
+bool InflateStream::readStored()
+{
+  bitBuf = 0;     // stored blocks start on a byte boundary
+  bitCnt = 0;
+
+  int len  = inByte();
+  len     |= inByte() << 8;
+  int nlen = inByte();
+  nlen    |= inByte() << 8;
+  if (err || len != (~nlen & 0xFFFF)) return false;
+
+  storedLeft = len;
+  return true;
+}
+
+// The trailer (CRC + size) is never read: the JSON parser stops at the
+// closing brace, and TLS already guards the bytes.
+
+// ============================================================
+// Stream
+// ============================================================
+int InflateStream::available()
+{
+  if (peeked >= 0 || copyLeft) return 1;
+  return (state == S_DONE || state == S_ERROR) ? 0 : 1;
+}
+
+int InflateStream::peek()
+{
+  if (peeked < 0) peeked = read();
+  return peeked;
+}
+
+int InflateStream::read()
+{
+  if (peeked >= 0) {
+    int c = peeked;
+    peeked = -1;
+    return c;
+  }
+
+  for (;;) {
+    if (copyLeft) {
+      uint8_t b = window[(pos - copyDist) & (AI_INFLATE_WINDOW - 1)];
+      put(b);
+      copyLeft--;
+      return b;
+    }
+
+    switch (state) {
+      case S_HEADER:
+        if (!readHeader()) return fail();
+        state = S_BLOCK;
+        break;
+
+      case S_BLOCK: {
+        if (lastBlock) {
+          state = S_DONE;
+          break;
+        }
+        lastBlock = bits(1);
+        int type = bits(2);
+        if (err) return fail();
+
+        if (type == 0) {
+          if (!readStored()) return fail();
+          state = S_STORED;
+        } else if (type == 1) {
+          useFixed();
+          state = S_CODES;
+        } else if (type == 2) {
+          if (!readDynamic()) return fail();
+          state = S_CODES;
+        } else {
+          return fail();
+        }
+        break;
+      }
+
+      case S_STORED: {
+        if (storedLeft == 0) {
+          state = S_BLOCK;
+          break;
+        }
+        int c = inByte();
+        if (c < 0) return fail();
+        storedLeft--;
+        put((uint8_t)c);
+        return c;
+      }
+
+      case S_CODES: {
+        int sym = decode(lencode);
+        if (sym < 0) return fail();
+        if (sym < 256) {
+          put((uint8_t)sym);
+          return sym;
+        }
+        if (sym == 256) {
+          state = S_BLOCK;
+          break;
+        }
+
+        sym -= 257;
+        if (sym >= 29) return fail();
+        int len = LEN_BASE[sym] + bits(LEN_EXTRA[sym]);
+
+        int ds = decode(distcode);
+        if (ds < 0 || ds >= 30) return fail();
+        uint32_t dist = DIST_BASE[ds] + bits(DIST_EXTRA[ds]);
+        if (err || dist > pos || dist > AI_INFLATE_WINDOW) return fail();
+
+        copyLeft = len;
+        copyDist = dist;
+        break;
+      }
+
+      default:
+        return -1;
+    }
+  }
+}
+
+// ============================================================
+// Bench
+// ============================================================
+// 1244-byte /api/generate reply (with its "context" array), gzip -9.
+static const uint8_t FIXTURE[] = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xed, 0x93, 0xcf, 0x6e, 0xc3, 0x20,
+  0x0c, 0xc6, 0x5f, 0x05, 0x71, 0x26, 0x2d, 0x90, 0x36, 0x4d, 0x7b, 0xda, 0x75, 0xb7, 0x1d, 0x7a,
+  0xda, 0x34, 0x55, 0x34, 0xb8, 0x4d, 0x24, 0x82, 0x23, 0x70, 0xfa, 0x47, 0xd3, 0xde, 0x7d, 0x6e,
+  0xba, 0x49, 0xdb, 0x33, 0xac, 0x08, 0x04, 0xe6, 0xfb, 0xfc, 0x93, 0x8d, 0xc4, 0x87, 0x4c, 0x90,
+  0x07, 0x8c, 0x19, 0xe4, 0x46, 0xbe, 0xb4, 0x48, 0x98, 0xaf, 0x91, 0x5a, 0xc8, 0x5d, 0x16, 0x3c,
+  0x5b, 0x3c, 0x8b, 0x21, 0xb8, 0x48, 0x59, 0xd0, 0x98, 0xa2, 0x08, 0xdd, 0xb1, 0x25, 0x25, 0xce,
+  0x8e, 0x20, 0x09, 0x17, 0xbd, 0x68, 0x5c, 0xda, 0x63, 0x14, 0xbe, 0xc3, 0x4b, 0xe7, 0x41, 0x74,
+  0x91, 0x50, 0xe4, 0xf1, 0xe8, 0xee, 0x2a, 0x5e, 0xae, 0x47, 0x88, 0x33, 0xf1, 0x4c, 0xa2, 0x75,
+  0xc3, 0x00, 0x91, 0xa1, 0x51, 0x30, 0x5e, 0x34, 0x6d, 0xc0, 0x84, 0x8c, 0xce, 0x94, 0x95, 0xe8,
+  0x31, 0x53, 0xb8, 0xfe, 0x68, 0x01, 0xdc, 0x09, 0xf2, 0x4c, 0x6c, 0xf9, 0x7c, 0x67, 0x1d, 0x00,
+  0x7c, 0x9e, 0xb4, 0xa9, 0x98, 0x89, 0x7d, 0x8b, 0xee, 0xfc, 0x5b, 0xa1, 0x09, 0x38, 0x2b, 0x83,
+  0xbf, 0x57, 0x70, 0xd3, 0x5c, 0x97, 0x66, 0x52, 0xc9, 0x1e, 0x3d, 0x04, 0xee, 0xed, 0xa9, 0x39,
+  0xcc, 0x7b, 0x20, 0x37, 0x0f, 0xc1, 0xf5, 0xae, 0x28, 0x67, 0xb6, 0x30, 0xfb, 0xa2, 0x8b, 0x99,
+  0xd2, 0xd8, 0x10, 0x1b, 0x9b, 0x04, 0xdc, 0x95, 0xdf, 0x39, 0x62, 0xb7, 0xd5, 0x76, 0x51, 0xe8,
+  0x65, 0xa1, 0xcd, 0xd6, 0xd8, 0x8d, 0xd6, 0x3c, 0x5f, 0xd9, 0xe3, 0x31, 0xf2, 0x3b, 0x71, 0x06,
+  0xb0, 0x1f, 0x23, 0xc1, 0x85, 0xcd, 0x6f, 0xc6, 0xd6, 0x5a, 0x57, 0x6a, 0x6d, 0xec, 0x52, 0x4d,
+  0xe7, 0x95, 0xb2, 0x2b, 0xa3, 0xca, 0x7a, 0x55, 0x55, 0xca, 0x94, 0xba, 0x54, 0x65, 0xa9, 0x59,
+  0xb3, 0xd5, 0xba, 0x52, 0xbc, 0x57, 0xab, 0xb5, 0x56, 0xd6, 0xf2, 0x2a, 0x6f, 0x86, 0x5a, 0x99,
+  0x75, 0xad, 0x1e, 0x90, 0x07, 0xe4, 0xff, 0x41, 0xde, 0x95, 0x24, 0x24, 0x17, 0x76, 0x7e, 0x4c,
+  0x8e, 0x3a, 0x8c, 0x72, 0x63, 0xea, 0x45, 0xa9, 0xa7, 0xa1, 0x64, 0x40, 0xe7, 0x7f, 0x4b, 0xf6,
+  0xfb, 0x7e, 0x48, 0xd8, 0x0f, 0xb4, 0x83, 0x13, 0x67, 0x36, 0x38, 0x46, 0xfe, 0x85, 0x0b, 0xab,
+  0xe4, 0x9f, 0xb8, 0xfe, 0xfc, 0x02, 0x0e, 0x23, 0x52, 0xe2, 0xdc, 0x04, 0x00, 0x00,};
+
+class FixtureStream : public Stream {
+public:
+  FixtureStream(const uint8_t* d, size_t n) : data(d), len(n) {}
+  int available() override { return (int)(len - at); }
+  int read() override      { return at < len ? data[at++] : -1; }
+  int peek() override      { return at < len ? data[at] : -1; }
+  size_t write(uint8_t) override { return 0; }
+
+private:
+  const uint8_t* data;
+  size_t len;
+  size_t at = 0;
+};
+
+static uint32_t crc32Update(uint32_t crc, uint8_t b)
+{
+  crc ^= b;
+  for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+  return crc;
+}
+
+void ai_inflate_bench(Print& out)
+{
+  static InflateStream inf;   // ~10 KB, keep it off the stack
+  const int RUNS = 20;
+
+  // gzip trailer: CRC32 and length of the original, little-endian
+  const uint8_t* t = FIXTURE + sizeof(FIXTURE) - 8;
+  uint32_t wantCrc = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+  uint32_t wantLen = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+
+  uint32_t crc = 0;
+  size_t   n = 0;
+  uint32_t t0 = micros();
+  for (int r = 0; r < RUNS; r++) {
+    FixtureStream fx(FIXTURE, sizeof(FIXTURE));
+    inf.begin(&fx, InflateStream::GZIP);
+    crc = 0xFFFFFFFFUL;
+    n = 0;
+    for (int c = inf.read(); c >= 0; c = inf.read()) {
+      crc = crc32Update(crc, (uint8_t)c);
+      n++;
+    }
+  }
+  uint32_t us = (micros() - t0) / RUNS;
+  crc ^= 0xFFFFFFFFUL;
+
+  bool ok = !inf.failed() && crc == wantCrc && n == wantLen;
+  out.printf("gzip: %u -> %u bytes (%u%% on the wire), %lu us per decode incl. CRC, %s\n",
+             (unsigned)sizeof(FIXTURE), (unsigned)n,
+             n ? (unsigned)(100 * sizeof(FIXTURE) / n) : 0,
+             (unsigned long)us, ok ? "CRC ok" : "MISMATCH");
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <Arduino.h>
+
+// Back-reference window. zlib may reach back 32 KB, but our responses are a
+// few KB, so this covers them; a stream that reaches further ends in an error.
+#ifndef AI_INFLATE_WINDOW
+#define AI_INFLATE_WINDOW 8192   // power of two
+#endif
+
+// gzip / zlib decoder as a Stream. Compressed bytes are pulled from src only
+// as the reader asks for output, so neither the compressed nor the whole
+// decompressed body is held in RAM.
+class InflateStream : public Stream {
+public:
+  enum Format : uint8_t { GZIP, ZLIB };
+
+  void begin(Stream* src, Format f);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t) override { return 0; }
+
+  bool   failed() const   { return state == S_ERROR; }
+  size_t consumed() const { return in; }
+  size_t produced() const { return pos; }
+
+private:
+  struct Huffman {
+    uint16_t count[16];
+    uint16_t symbol[288];
+  };
+
+  enum State : uint8_t { S_HEADER, S_BLOCK, S_STORED, S_CODES, S_DONE, S_ERROR };
+
+  int  inByte();
+  int  bits(int n);
+  int  decode(const Huffman& h);
+  int  fail();
+  void put(uint8_t b) { window[pos++ & (AI_INFLATE_WINDOW - 1)] = b; }
+
+  bool readHeader();
+  bool readStored();
+  bool readDynamic();
+  void useFixed();
+
+  static int build(Huffman& h, const uint8_t* lengths, int n);
+
+  Stream*  src = nullptr;
+  Format   format = GZIP;
+  State    state = S_DONE;
+  bool     lastBlock = false;
+  bool     err = false;
+
+  uint32_t bitBuf = 0;
+  int      bitCnt = 0;
+
+  uint16_t storedLeft = 0;
+  uint16_t copyLeft = 0;
+  uint16_t copyDist = 0;
+  int      peeked = -1;
+
+  size_t   in = 0;
+  size_t   pos = 0;
+
+  Huffman  lencode;
+  Huffman  distcode;
+  uint8_t  window[AI_INFLATE_WINDOW];
+};
+
+// Decodes a gzip'd sample response and prints sizes and decode time.
+void ai_inflate_bench(Print& out);
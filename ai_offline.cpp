@@ -0,0 +1,219 @@
+#include "ai_offline.h"
+#include <WiFi.h>
+#include <ctype.h>
+
+enum Intent : uint8_t {
+  INT_GREET, INT_THANKS, INT_BYE, INT_WHO, INT_HOW, INT_HELP, INT_JOKE,
+  INT_WEATHER, INT_TIME, INT_WIFI, INT_DEVICE, INT_XP, INT_PAINT,
+  INT_COUNT
+};
+
+struct Keyword {
+  const char* word;
+  uint8_t     intent;
+  uint8_t     weight;
+};
+
+// Must stay sorted by word (strcmp order): lookups are a binary search.
+// Const tables live in flash and are read through the cache mapping, so
+// none of this is copied into RAM.
+static const Keyword KEYWORDS[] PROGMEM = {
+  { "art",         INT_PAINT,   3 },
+  { "assistant",   INT_WHO,     3 },
+  { "battery",     INT_DEVICE,  3 },
+  { "bot",         INT_WHO,     3 },
+  { "bye",         INT_BYE,     3 },
+  { "can",         INT_HELP,    1 },
+  { "cheers",      INT_THANKS,  3 },
+  { "chip",        INT_DEVICE,  3 },
+  { "clock",       INT_TIME,    3 },
+  { "cloud",       INT_WIFI,    3 },
+  { "cold",        INT_WEATHER, 1 },
+  { "color",       INT_PAINT,   1 },
+  { "commands",    INT_HELP,    3 },
+  { "connect",     INT_WIFI,    1 },
+  { "connected",   INT_WIFI,    3 },
+  { "cya",         INT_BYE,     3 },
+  { "desktop",     INT_XP,      3 },
+  { "device",      INT_DEVICE,  3 },
+  { "display",     INT_DEVICE,  3 },
+  { "do",          INT_HELP,    1 },
+  { "doing",       INT_HOW,     3 },
+  { "draw",        INT_PAINT,   3 },
+  { "drawing",     INT_PAINT,   3 },
+  { "esp32",       INT_DEVICE,  3 },
+  { "evening",     INT_GREET,   3 },
+  { "features",    INT_HELP,    3 },
+  { "feeling",     INT_HOW,     3 },
+  { "fine",        INT_HOW,     1 },
+  { "forecast",    INT_WEATHER, 3 },
+  { "funny",       INT_JOKE,    3 },
+  { "goodbye",     INT_BYE,     3 },
+  { "greetings",   INT_GREET,   3 },
+  { "hallo",       INT_GREET,   3 },
+  { "hardware",    INT_DEVICE,  3 },
+  { "hello",       INT_GREET,   3 },
+  { "help",        INT_HELP,    3 },
+  { "hey",         INT_GREET,   3 },
+  { "hi",          INT_GREET,   3 },
+  { "hot",         INT_WEATHER, 1 },
+  { "how",         INT_HOW,     1 },
+  { "humor",       INT_JOKE,    3 },
+  { "internet",    INT_WIFI,    3 },
+  { "joke",        INT_JOKE,    3 },
+  { "later",       INT_BYE,     1 },
+  { "laugh",       INT_JOKE,    3 },
+  { "long",        INT_TIME,    1 },
+  { "microsoft",   INT_XP,      3 },
+  { "morning",     INT_GREET,   3 },
+  { "name",        INT_WHO,     2 },
+  { "network",     INT_WIFI,    3 },
+  { "night",       INT_BYE,     1 },
+  { "offline",     INT_WIFI,    3 },
+  { "ok",          INT_HOW,     1 },
+  { "online",      INT_WIFI,    3 },
+  { "paint",       INT_PAINT,   3 },
+  { "rain",        INT_WEATHER, 3 },
+  { "retro",       INT_XP,      3 },
+  { "running",     INT_TIME,    3 },
+  { "screen",      INT_DEVICE,  3 },
+  { "sunny",       INT_WEATHER, 3 },
+  { "temperature", INT_WEATHER, 3 },
+  { "thank",       INT_THANKS,  3 },
+  { "thanks",      INT_THANKS,  3 },
+  { "thx",         INT_THANKS,  3 },
+  { "time",        INT_TIME,    3 },
+  { "uptime",      INT_TIME,    3 },
+  { "weather",     INT_WEATHER, 3 },
+  { "what",        INT_HELP,    1 },
+  { "who",         INT_WHO,     3 },
+  { "wifi",        INT_WIFI,    3 },
+  { "windows",     INT_XP,      3 },
+  { "xp",          INT_XP,      3 },
+  { "yo",          INT_GREET,   3 },
+  { "yourself",    INT_WHO,     3 },
+};
+static const int KEYWORD_N = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+
+static const char* const REPLIES[INT_COUNT] PROGMEM = {
+  "Hi! I'm running on local answers until the cloud is back.",
+  "You're welcome!",
+  "Bye! Tap BACK to return to the desktop.",
+  "I'm the desk bot on this ESP32. Offline I only know a few canned answers.",
+  "All good here, just waiting for the network.",
+  "Offline I can tell you about Wi-Fi, uptime, this device and its apps. Ask again once Wi-Fi is back for anything else.",
+  "Why did the ESP32 cross the road? Its Wi-Fi was better on the other side.",
+  "I can't check the weather without a connection. Try again once Wi-Fi is back.",
+  nullptr,   // INT_TIME: filled in with the uptime
+  nullptr,   // INT_WIFI: filled in with the link state
+  "I'm an ESP32 with a 320x240 touch screen, chatting through a cloud model when online.",
+  "This desktop is styled after Windows XP, released October 25, 2001.",
+  "Close the chat and open Paint on the desktop to draw.",
+};
+
+static const char* FALLBACK = "The AI service is unreachable right now. Please try again in a moment.";
+
+static const uint8_t MIN_SCORE = 2;
+
+static uint32_t lookups  = 0;
+static uint32_t matched  = 0;
+static uint32_t totalUs  = 0;
+static uint32_t worstUs  = 0;
+
+static int findKeyword(const char* w)
+{
+  int lo = 0, hi = KEYWORD_N - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    int c = strcmp(w, KEYWORDS[mid].word);
+    if (c == 0) return mid;
+    if (c < 0) hi = mid - 1;
+    else lo = mid + 1;
+  }
+  return -1;
+}
+
+static void scoreWord(char* w, int n, uint8_t* scores)
+{
+  w[n] = 0;
+  int k = findKeyword(w);
+  if (k < 0 && n > 3 && w[n - 1] == 's') {   // "networks" -> "network"
+    w[n - 1] = 0;
+    k = findKeyword(w);
+  }
+  if (k >= 0) scores[KEYWORDS[k].intent] += KEYWORDS[k].weight;
+}
+
+static int matchIntent(const char* text)
+{
+  uint8_t scores[INT_COUNT] = {0};
+  char word[16];
+  int n = 0;
+
+  for (const char* p = text; ; p++) {
+    unsigned char c = (unsigned char)*p;
+    if (isalnum(c)) {
+      if (n < (int)sizeof(word) - 1) word[n++] = (char)tolower(c);
+      continue;
+    }
+    if (c == '-' || c == '\'') continue;   // "wi-fi", "what's"
+    if (n > 0) scoreWord(word, n, scores);
+    n = 0;
+    if (c == 0) break;
+  }
+
+  int best = -1;
+  for (int i = 0; i < INT_COUNT; i++) {
+    if (scores[i] >= MIN_SCORE && (best < 0 || scores[i] > scores[best])) best = i;
+  }
+  return best;
+}
+
+void ai_offline_reply(const char* userText, String& reply)
+{
+  uint32_t t0 = micros();
+  int intent = matchIntent(userText);
+  uint32_t us = micros() - t0;
+
+  lookups++;
+  totalUs += us;
+  if (us > worstUs) worstUs = us;
+
+  if (intent < 0) {
+    reply = FALLBACK;
+    return;
+  }
+  matched++;
+
+  char buf[96];
+  if (intent == INT_TIME) {
+    uint32_t s = millis() / 1000;
+    snprintf(buf, sizeof(buf), "I've been up for %luh %02lum. There's no clock sync while offline.",
+             (unsigned long)(s / 3600), (unsigned long)(s / 60 % 60));
+    reply = buf;
+  } else if (intent == INT_WIFI) {
+    if (WiFi.status() == WL_CONNECTED) {
+      snprintf(buf, sizeof(buf), "Wi-Fi is up (%d dBm) but the AI service isn't answering.", (int)WiFi.RSSI());
+      reply = buf;
+    } else {
+      reply = "Wi-Fi is not connected. Open the WiFi app on the desktop to join a network.";
+    }
+  } else {
+    reply = REPLIES[intent];
+  }
+}
+
+void ai_offline_printStats(Print& out)
+{
+  size_t strBytes = 0;
+  for (int i = 0; i < KEYWORD_N; i++) strBytes += strlen(KEYWORDS[i].word) + 1;
+  for (int i = 0; i < INT_COUNT; i++) if (REPLIES[i]) strBytes += strlen(REPLIES[i]) + 1;
+  strBytes += strlen(FALLBACK) + 1;
+
+  out.printf("Offline responder: %d keywords, %d intents, %u bytes flash\n",
+             KEYWORD_N, (int)INT_COUNT,
+             (unsigned)(sizeof(KEYWORDS) + sizeof(REPLIES) + strBytes));
+  out.printf("  %lu lookups, %lu matched, avg %lu us, worst %lu us\n",
+             (unsigned long)lookups, (unsigned long)matched,
+             (unsigned long)(lookups ? totalUs / lookups : 0), (unsigned long)worstUs);
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <Arduino.h>
+
+// Keyword/intent matcher that answers from a const table in flash when the
+// cloud can't be reached. Always produces a reply (falls back to a generic one).
+void ai_offline_reply(const char* userText, String& reply);
+
+void ai_offline_printStats(Print& out);
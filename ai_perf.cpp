@@ -0,0 +1,79 @@
+#include "ai_perf.h"
+
+static const char* PHASE_NAMES[AI_PH_COUNT] = {
+  "queue", "dns", "connect", "send", "wait", "recv", "total"
+};
+
+// Total is bounded by the request timeout (60 s max), so 16 bits are enough.
+static uint16_t samples[AI_PH_COUNT][AI_PERF_SAMPLES];
+static uint8_t  head  = 0;
+static uint8_t  count = 0;
+
+const char* ai_perf_phaseName(int phase)
+{
+  return (phase >= 0 && phase < AI_PH_COUNT) ? PHASE_NAMES[phase] : "?";
+}
+
+void ai_perf_record(const uint32_t* ms)
+{
+  for (int p = 0; p < AI_PH_COUNT; p++) {
+    samples[p][head] = ms[p] > 0xFFFF ? 0xFFFF : (uint16_t)ms[p];
+  }
+  head = (head + 1) % AI_PERF_SAMPLES;
+  if (count < AI_PERF_SAMPLES) count++;
+}
+
+// nearest-rank on a sorted copy
+static uint32_t rank(const uint16_t* sorted, int n, int pct)
+{
+  int i = (pct * n + 99) / 100 - 1;
+  if (i < 0) i = 0;
+  return sorted[i];
+}
+
+int ai_perf_percentiles(int phase, uint32_t& p50, uint32_t& p95, uint32_t& p99)
+{
+  if (phase < 0 || phase >= AI_PH_COUNT || count == 0) return 0;
+
+  uint16_t s[AI_PERF_SAMPLES];
+  int n = count;
+  memcpy(s, samples[phase], n * sizeof(s[0]));   // ring is full or starts at 0
+
+  for (int i = 1; i < n; i++) {
+    uint16_t v = s[i];
+    int j = i - 1;
+    while (j >= 0 && s[j] > v) {
+      s[j + 1] = s[j];
+      j--;
+    }
+    s[j + 1] = v;
+  }
+
+  p50 = rank(s, n, 50);
+  p95 = rank(s, n, 95);
+  p99 = rank(s, n, 99);
+  return n;
+}
+
+void ai_perf_print(Print& out)
+{
+  if (count == 0) {
+    out.println("AI perf: no completed requests yet");
+    return;
+  }
+
+  out.printf("AI perf, last %d requests (ms):\n", count);
+  out.println("  phase       p50     p95     p99");
+  for (int p = 0; p < AI_PH_COUNT; p++) {
+    uint32_t p50, p95, p99;
+    ai_perf_percentiles(p, p50, p95, p99);
+    out.printf("  %-8s %6lu  %6lu  %6lu\n", PHASE_NAMES[p],
+               (unsigned long)p50, (unsigned long)p95, (unsigned long)p99);
+  }
+}
+
+void ai_perf_clear()
+{
+  head = 0;
+  count = 0;
+}
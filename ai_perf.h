@@ -0,0 +1,31 @@
+#pragma once
+#include <Arduino.h>
+
+// Where the time of an AI request goes. Each phase keeps a ring of recent
+// samples for percentiles.
+
+enum AiPhase : uint8_t {
+  AI_PH_QUEUE,     // ai_start() -> worker picks the job up
+  AI_PH_DNS,
+  AI_PH_CONNECT,   // TCP + TLS handshake (WiFiClientSecure does both in connect())
+  AI_PH_SEND,      // request head + body written
+  AI_PH_WAIT,      // request sent -> first response byte (queueing + inference)
+  AI_PH_RECV,      // first byte -> last byte; JSON is parsed while it streams in
+  AI_PH_TOTAL,     // ai_start() -> reply ready
+  AI_PH_COUNT
+};
+
+#ifndef AI_PERF_SAMPLES
+#define AI_PERF_SAMPLES 32
+#endif
+
+const char* ai_perf_phaseName(int phase);
+
+// ms[] has AI_PH_COUNT entries, one request's phase durations.
+void ai_perf_record(const uint32_t* ms);
+
+// Returns how many samples the phase has (0 = nothing to report).
+int  ai_perf_percentiles(int phase, uint32_t& p50, uint32_t& p95, uint32_t& p99);
+
+void ai_perf_print(Print& out);
+void ai_perf_clear();
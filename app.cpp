@@ -0,0 +1,106 @@
+#include "app.h"
+
+static const App* const* apps = nullptr;
+static int appCount = 0;
+
+static const App* current   = nullptr;
+static bool       switched  = false;
+static bool       suspended = false;
+
+static const uint32_t HEAP_CHECK_MS = 1000;
+static uint32_t lastHeapCheck = 0;
+
+const App* app_find(const char* name)
+{
+  if (!name) return nullptr;
+  for (int i = 0; i < appCount; i++) {
+    if (strcmp(apps[i]->name, name) == 0) return apps[i];
+  }
+  return nullptr;
+}
+
+const App* app_current() { return current; }
+
+static void switchTo(const App* next)
+{
+  uint32_t t0 = micros();
+  const char* from = current ? current->name : "-";
+
+  if (current && current->onClose) current->onClose();
+  current = next;
+  suspended = false;
+  switched = true;
+  if (current->onOpen) current->onOpen();
+
+  Serial.printf("app: %s -> %s in %lu ms\n", from, current->name,
+                (unsigned long)((micros() - t0) / 1000));
+}
+
+void app_begin(const App* const* table, int count)
+{
+  apps = table;
+  appCount = count;
+  current = nullptr;
+  if (appCount > 0) switchTo(apps[0]);
+}
+
+bool app_open(const char* name)
+{
+  const App* a = app_find(name);
+  if (!a) return false;
+  if (a != current) switchTo(a);
+  return true;
+}
+
+bool app_properties(const char* name)
+{
+  const App* a = app_find(name);
+  if (!a || !a->onProperties) return false;
+  a->onProperties();
+  return true;
+}
+
+// Background apps give back their buffers while the heap is tight.
+static void checkHeap()
+{
+  if (millis() - lastHeapCheck < HEAP_CHECK_MS) return;
+  lastHeapCheck = millis();
+  if (ESP.getFreeHeap() >= APP_LOW_HEAP_BYTES) return;
+
+  for (int i = 0; i < appCount; i++) {
+    if (apps[i] != current && apps[i]->onMemoryPressure) apps[i]->onMemoryPressure();
+  }
+}
+
+void app_tick()
+{
+  checkHeap();
+  if (!current || suspended) return;
+  if (current->onTick) current->onTick();
+}
+
+bool app_touch(bool pressed, bool lastPressed, int x, int y)
+{
+  if (!current || suspended) return pressed;
+
+  switched = false;
+  bool keepOpen = current->onTouch ? current->onTouch(pressed, lastPressed, x, y) : true;
+  if (!keepOpen && current != apps[0]) switchTo(apps[0]);
+
+  return switched ? true : pressed;
+}
+
+void app_suspend()
+{
+  if (!current || suspended) return;
+  suspended = true;
+  if (current->onSuspend) current->onSuspend();
+}
+
+void app_resume()
+{
+  if (!current || !suspended) return;
+  suspended = false;
+  if (current->onResume) current->onResume();
+  else if (current->onOpen) current->onOpen();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+
+// Full-screen apps and the registry that switches between them. One app is
+// in the foreground at a time; only it ticks and sees touches. Hooks left
+// null are skipped.
+
+// Free heap below which background apps are asked to drop their buffers.
+#ifndef APP_LOW_HEAP_BYTES
+#define APP_LOW_HEAP_BYTES 24576
+#endif
+
+struct App {
+  const char* name;
+
+  void (*onOpen)();             // became the foreground app: draw the whole screen
+  void (*onClose)();            // left for another app: cancel work, free what can go
+  // Every loop while in the foreground; false goes back to the home app.
+  bool (*onTouch)(bool pressed, bool lastPressed, int x, int y);
+  void (*onTick)();             // every loop while in the foreground
+  void (*onSuspend)();          // screen taken away without closing
+  void (*onMemoryPressure)();   // in the background and heap is low
+  void (*onProperties)();       // desktop "Properties": draw a dialog over the desktop
+  // Screen given back after onSuspend: redraw, keep state. Null uses onOpen.
+  void (*onResume)();
+};
+
+// apps[0] is the home app and is opened right away. The table must outlive
+// the registry.
+void app_begin(const App* const* apps, int count);
+
+const App* app_find(const char* name);
+const App* app_current();
+
+// Closes the foreground app and opens name. False if no such app.
+bool app_open(const char* name);
+// Draws name's properties dialog. False if it has none.
+bool app_properties(const char* name);
+
+// Call every loop().
+void app_tick();
+// Routes one touch sample to the foreground app and returns the lastPressed
+// to use next time: a tap that switched apps is swallowed.
+bool app_touch(bool pressed, bool lastPressed, int x, int y);
+
+// Screen off / overlays: the foreground app stops ticking until app_resume().
+void app_suspend();
+void app_resume();
@@ -1,6 +1,8 @@
 #include "chat_app.h"
 #include "keyboard.h"
 #include "ai_client.h"
+#include "ai_perf.h"
+#include "frame.h"
 #include <Arduino.h>
 
 static TFT_eSPI* tft = nullptr;
@@ -9,12 +11,32 @@ static TFT_eSPI* tft = nullptr;
 #define SCREEN_H 240
 
 #define MAX_MSG 12
-#define MAX_LEN 160
+#define MAX_LEN (AI_REPLY_MAX + 8)
 
 static char chatUser[MAX_MSG][MAX_LEN];
 static char chatAI[MAX_MSG][MAX_LEN];
+static uint32_t chatSeq[MAX_MSG];
+// The row was answered by the model. Only these go out as history; "...",
+// "(cancelled)", errors and offline replies stay on screen only.
+static bool chatAnswered[MAX_MSG];
+static uint32_t nextSeq = 1;
 static int chatCount = 0;
 
+// Send queue, by row seq. Rows sent while a request is in flight, or within
+// the coalescing window, wait in queued[] and then go out together as one
+// prompt. The answer lands on the last of them; the others keep an empty AI
+// line. Waiting rows show "...".
+#define CHAT_QUEUE_MAX 4
+
+static uint32_t queued[CHAT_QUEUE_MAX];
+static int      queuedCount = 0;
+static uint32_t queuedSince = 0;
+static uint32_t inFlight[CHAT_QUEUE_MAX];
+static int      inFlightCount = 0;
+static uint32_t callsSaved = 0;
+
+static bool     chatOpen   = false;
+
 static const int RIGHT_PANEL_X = 250;
 
 static int CHAT_TOP = 32;
@@ -24,6 +46,10 @@ static const int INPUT_H = 28;
 
 static int chatCursorY = 40;
 static bool kbVisible = true;
+static Keyboard kb;
+static char      inputStore[KB_TEXT_MAX];
+static TextEdit  input;
+static TextField inputField;
 static const int UI_GAP = 6;
 
 static int scrollLine = 0;
@@ -48,9 +74,16 @@ static bool inChatArea(int x, int y) {
 
 static void pushMessage(const char* user, const char* ai) {
   if (chatCount >= MAX_MSG) {
+    if (chatAnswered[0]) {
+      AiTurn oldest = { chatUser[0], chatAI[0], chatSeq[0] };
+      ai_forgetTurn(oldest);
+    }
+
     for (int i = 1; i < MAX_MSG; i++) {
       strncpy(chatUser[i-1], chatUser[i], MAX_LEN);
       strncpy(chatAI[i-1],   chatAI[i],   MAX_LEN);
+      chatSeq[i-1] = chatSeq[i];
+      chatAnswered[i-1] = chatAnswered[i];
     }
     chatCount = MAX_MSG - 1;
   }
@@ -61,6 +94,8 @@ static void pushMessage(const char* user, const char* ai) {
   strncpy(chatAI[chatCount], ai, MAX_LEN - 1);
   chatAI[chatCount][MAX_LEN - 1] = 0;
 
+  chatSeq[chatCount] = nextSeq++;
+  chatAnswered[chatCount] = false;
   chatCount++;
 }
 
@@ -72,6 +107,7 @@ static void applyLayout() {
     INPUT_Y = SCREEN_H - INPUT_H - UI_GAP;
     CHAT_BOTTOM = INPUT_Y - UI_GAP;
   }
+  inputField.place(20, INPUT_Y + 2, 210, INPUT_H - 4);
 }
 
 static void drawBackButton(bool pressed) {
@@ -96,25 +132,35 @@ static void clearChatArea() {
   chatCursorY = CHAT_TOP + 8;
 }
 
+// WAIT while the send queue is full: a tap then has nowhere to go.
+static void drawSendButton() {
+  bool full = queuedCount >= CHAT_QUEUE_MAX;
+  uint16_t bg = full ? TFT_ORANGE : TFT_GREEN;
+  tft->fillRoundRect(250, INPUT_Y, 66, INPUT_H, 6, bg);
+  tft->setTextColor(TFT_WHITE, bg);
+  tft->drawCentreString(full ? "WAIT" : "SEND", 283, INPUT_Y + 6, 2);
+}
+
 static void drawInputBar() {
   tft->drawRect(4, INPUT_Y, 240, INPUT_H, TFT_BLACK);
 
   tft->setTextColor(TFT_BLACK, TFT_WHITE);
   tft->drawString(">", 8, INPUT_Y + 6, 2);
 
-  tft->fillRoundRect(250, INPUT_Y, 66, INPUT_H, 6, TFT_GREEN);
-  tft->setTextColor(TFT_WHITE, TFT_GREEN);
-  tft->drawCentreString("SEND", 283, INPUT_Y + 6, 2);
+  drawSendButton();
 
   tft->fillRoundRect(250, INPUT_Y - 24, 66, 20, 6, TFT_LIGHTGREY);
   tft->setTextColor(TFT_BLACK, TFT_LIGHTGREY);
   tft->drawCentreString(kbVisible ? "HIDE" : "SHOW", 283, INPUT_Y - 20, 2);
 }
 
+// After a key: only the characters that moved and the cursor.
 static void updateInputText() {
-  tft->fillRect(20, INPUT_Y + 2, 210, INPUT_H - 4, TFT_WHITE);
-  tft->setTextColor(TFT_BLACK, TFT_WHITE);
-  tft->drawString(keyboard_get_text(), 22, INPUT_Y + 6, 2);
+  inputField.update();
+}
+
+static void drawInputText() {
+  inputField.draw();
 }
 
 static int wrapAndCountLines(const String& s, int maxW) {
@@ -200,8 +246,9 @@ static void drawChatHistory() {
   totalLines = 0;
   for (int i = 0; i < chatCount; i++) {
     String u = String("You: ") + chatUser[i];
-    String a = String("AI:  ") + chatAI[i];
     totalLines += wrapAndCountLines(u, maxW);
+    if (!chatAI[i][0]) continue;   // answered together with the next row
+    String a = String("AI:  ") + chatAI[i];
     totalLines += wrapAndCountLines(a, maxW);
   }
 
@@ -218,10 +265,12 @@ static void drawChatHistory() {
 
   for (int i = 0; i < chatCount; i++) {
     String u = String("You: ") + chatUser[i];
-    String a = String("AI:  ") + chatAI[i];
-
     drawWrappedLineWindow(u, maxW, first, last, currentLine, y);
-    drawWrappedLineWindow(a, maxW, first, last, currentLine, y);
+
+    if (chatAI[i][0]) {
+      String a = String("AI:  ") + chatAI[i];
+      drawWrappedLineWindow(a, maxW, first, last, currentLine, y);
+    }
 
     if (currentLine >= last) break;
   }
@@ -231,23 +280,173 @@ void chat_init(TFT_eSPI* display) {
   tft = display;
 
   kbVisible = true;
+  input.begin(inputStore, sizeof(inputStore));
+  inputField.begin(display, &input, TFT_BLACK, TFT_WHITE, 2);
+  kb.begin(display, keyboard_defaultCfg(), &input);
 }
 
 void chat_draw() {
+  chatOpen = true;
+  frame_clear();
   applyLayout();
 
   tft->fillScreen(TFT_WHITE);
   drawHeader();
   drawChatHistory();
   drawInputBar();
-  updateInputText();
+  drawInputText();
+
+  kb.setVisible(kbVisible);
+  if (kbVisible) kb.draw();
+}
 
-  keyboard_set_visible(kbVisible);
-  if (kbVisible) keyboard_draw();
+// History, then the input bar over any text that ran past CHAT_BOTTOM.
+static void invalidateChat() {
+  frame_request(drawChatHistory);
+  frame_request(drawInputBar);
+  frame_request(drawInputText);
+}
+
+static void redrawAfterMessage() {
+  scrollLine = 999999;
+  invalidateChat();
+}
+
+static int rowBySeq(uint32_t seq) {
+  for (int i = 0; i < chatCount; i++) {
+    if (chatSeq[i] == seq) return i;
+  }
+  return -1;
+}
+
+static void setAI(int row, const char* text) {
+  strncpy(chatAI[row], text, MAX_LEN - 1);
+  chatAI[row][MAX_LEN - 1] = 0;
+}
+
+// Everything queued goes out as one multi-line prompt; the answered rows
+// before the first queued one form the history.
+static void startQueued() {
+  int first = rowBySeq(queued[0]);
+  if (first < 0) {
+    queuedCount = 0;
+    return;
+  }
+
+  char merged[CHAT_QUEUE_MAX * (KB_TEXT_MAX + 1)];
+  merged[0] = 0;
+  for (int k = 0; k < queuedCount; k++) {
+    int row = rowBySeq(queued[k]);
+    if (row < 0) continue;
+    if (merged[0]) strlcat(merged, "\n", sizeof(merged));
+    strlcat(merged, chatUser[row], sizeof(merged));
+  }
+
+  AiTurn history[MAX_MSG];
+  int turns = 0;
+  for (int i = 0; i < first; i++) {
+    if (chatAnswered[i]) history[turns++] = { chatUser[i], chatAI[i], chatSeq[i] };
+  }
+
+  if (!ai_start(merged, history, turns)) return;
+
+  memcpy(inFlight, queued, queuedCount * sizeof(queued[0]));
+  inFlightCount = queuedCount;
+  if (queuedCount >= CHAT_QUEUE_MAX && chatOpen) frame_request(drawSendButton);
+  queuedCount = 0;
+
+  if (inFlightCount > 1) {
+    callsSaved += inFlightCount - 1;
+    Serial.printf("Chat: %d messages in one request, %lu calls saved so far\n",
+                  inFlightCount, (unsigned long)callsSaved);
+  }
+}
+
+void chat_tick() {
+  if (inFlightCount) {
+    String aiText;
+    bool fromModel = false;
+    if (ai_poll(aiText, &fromModel) != AI_DONE) return;
+
+    for (int k = 0; k < inFlightCount; k++) {
+      int row = rowBySeq(inFlight[k]);
+      if (row < 0) continue;
+      setAI(row, k == inFlightCount - 1 ? aiText.c_str() : "");
+      chatAnswered[row] = fromModel;
+    }
+    inFlightCount = 0;
+
+    if (chatOpen) {
+      redrawAfterMessage();
+      if (!queuedCount) ai_prewarm();   // the next question is probably coming
+    }
+  }
+
+  if (queuedCount && millis() - queuedSince >= ai_coalesceMs()) startQueued();
+}
+
+void chat_close() {
+  chatOpen = false;
+  ai_cancel();
+  kb.setVisible(false);
+
+  for (int k = 0; k < queuedCount; k++) {
+    int row = rowBySeq(queued[k]);
+    if (row >= 0) setAI(row, "(cancelled)");
+  }
+  queuedCount = 0;
+}
+
+void chat_drawProperties() {
+  const int x = 30, y = 24, w = 260, h = 192;
+  uint16_t bg       = 0xEF7D;
+  uint16_t borderDk = 0x7BEF;
+  uint16_t innerDk  = 0xC618;
+  uint16_t title    = 0x1C9F;
+
+  tft->fillRect(x, y, w, h, bg);
+  tft->drawFastHLine(x, y, w, TFT_WHITE);
+  tft->drawFastVLine(x, y, h, TFT_WHITE);
+  tft->drawFastHLine(x, y + h - 1, w, borderDk);
+  tft->drawFastVLine(x + w - 1, y, h, borderDk);
+  tft->drawRect(x + 1, y + 1, w - 2, h - 2, innerDk);
+
+  tft->fillRect(x + 3, y + 3, w - 6, 18, title);
+  tft->setTextColor(TFT_WHITE, title);
+  tft->drawString("AI Chat Properties", x + 8, y + 5, 2);
+
+  tft->setTextColor(TFT_BLACK, bg);
+  char line[48];
+  uint32_t p50, p95, p99;
+  int n = ai_perf_percentiles(AI_PH_TOTAL, p50, p95, p99);
+  snprintf(line, sizeof(line), "Latency, last %d replies (ms)", n);
+  tft->drawString(line, x + 8, y + 26, 2);
+
+  tft->drawString("phase", x + 8, y + 44, 2);
+  tft->drawRightString("p50", x + 140, y + 44, 2);
+  tft->drawRightString("p95", x + 192, y + 44, 2);
+  tft->drawRightString("p99", x + 244, y + 44, 2);
+  tft->drawFastHLine(x + 8, y + 60, w - 16, innerDk);
+
+  for (int p = 0; p < AI_PH_COUNT; p++) {
+    int ry = y + 64 + p * 16;
+    tft->drawString(ai_perf_phaseName(p), x + 8, ry, 2);
+    if (!n) continue;
+    ai_perf_percentiles(p, p50, p95, p99);
+    snprintf(line, sizeof(line), "%lu", (unsigned long)p50);
+    tft->drawRightString(line, x + 140, ry, 2);
+    snprintf(line, sizeof(line), "%lu", (unsigned long)p95);
+    tft->drawRightString(line, x + 192, ry, 2);
+    snprintf(line, sizeof(line), "%lu", (unsigned long)p99);
+    tft->drawRightString(line, x + 244, ry, 2);
+  }
+
+  tft->setTextColor(borderDk, bg);
+  tft->drawCentreString("Tap to close", x + w / 2, y + h - 18, 1);
 }
 
 void chat_release() {
-  keyboard_release();
+  kb.release();
   draggingChat = false;
   dragAccum = 0;
 }
@@ -256,15 +455,17 @@ void chat_handleTouch(bool pressed, bool lastPressed, int x, int y) {
   if (!tft) return;
 
   if (pressed && kbVisible) {
-    KB_Action tickA = keyboard_tick(true, x, y);
-    if (tickA == KB_CHANGED) {
-      updateInputText();
+    KB_Action a = kb.update(true, x, y);
+    if (a == KB_CHANGED) {
+      frame_request(updateInputText);
       return;
     }
+    if (a == KB_REDRAW) return;
   }
 
-  if (pressed && !lastPressed && inRect(x, y, 260, 4, 52, 17)) {
-
+  if (pressed && !lastPressed && kbVisible && inputField.hit(x, y)) {
+    inputField.tap(x);
+    frame_request(updateInputText);
     return;
   }
 
@@ -299,41 +500,61 @@ void chat_handleTouch(bool pressed, bool lastPressed, int x, int y) {
       int maxScroll = max(0, totalLines - visibleLines);
       scrollLine = constrain(scrollLine - steps, 0, maxScroll);
 
-      drawChatHistory();
-      drawInputBar();
-      updateInputText();
+      invalidateChat();
     }
     return;
   }
 
   if (pressed && !lastPressed && inRect(x, y, 250, INPUT_Y, 66, INPUT_H)) {
-    String userText = keyboard_get_text();
-    userText.trim();
-
-    if (userText.length() > 0) {
-      String aiText = ai_sendMessage(userText);
-      pushMessage(userText.c_str(), aiText.c_str());
-      keyboard_clear();
-
-      scrollLine = 999999;
-      drawChatHistory();
-      drawInputBar();
-      updateInputText();
+    char buf[KB_TEXT_MAX + 1];
+    input.copy(buf, sizeof(buf));
+    char* userText = buf;
+    while (*userText == ' ') userText++;
+    size_t n = strlen(userText);
+    while (n > 0 && userText[n - 1] == ' ') userText[--n] = 0;
+
+    if (n > 0 && queuedCount >= CHAT_QUEUE_MAX) {
+      Serial.println("Chat: send queue full, message kept in the input");
+      return;
     }
-    return;
-  }
-
-  if (kbVisible && pressed && !lastPressed) {
-    KB_Action a = keyboard_touch(x, y);
+    if (n > 0) {
+      pushMessage(userText, "...");
+      if (!queuedCount) queuedSince = millis();
+      queued[queuedCount++] = chatSeq[chatCount - 1];
+      input.clear();
 
-    if (a == KB_CHANGED) {
-      updateInputText();
-    } else if (a == KB_REDRAW) {
-      keyboard_draw();
-    } else if (a == KB_HIDE) {
-      kbVisible = false;
-      chat_draw();
+      redrawAfterMessage();   // the bar too: SEND turns to WAIT once the queue is full
     }
     return;
   }
 }
+
+// ============================================================
+// App hooks
+// ============================================================
+static void openChat() {
+  ai_prewarm();
+  input.clear();
+  chat_draw();
+}
+
+static bool chatTouch(bool pressed, bool lastPressed, int x, int y) {
+  if (!pressed && lastPressed) chat_release();
+
+  if (pressed && !lastPressed && inRect(x, y, 260, 4, 52, 17)) return false;
+
+  chat_handleTouch(pressed, lastPressed, x, y);
+  return true;
+}
+
+const App CHAT_APP = {
+  "chat",
+  openChat,
+  chat_close,
+  chatTouch,
+  nullptr,   // chat_tick runs from loop(): replies must land with the chat closed
+  nullptr,
+  nullptr,
+  chat_drawProperties,
+  chat_draw   // resume: the draft and the keyboard stay as they were
+};
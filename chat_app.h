@@ -1,5 +1,6 @@
 #pragma once
 #include <TFT_eSPI.h>
+#include "app.h"
 
 void chat_init(TFT_eSPI* tft);
 void chat_draw();
@@ -7,3 +8,13 @@ void chat_draw();
 void chat_handleTouch(bool pressed, bool lastPressed, int x, int y);
 
 void chat_release();
+
+// Collects the AI reply for the last SEND; call every loop.
+void chat_tick();
+// Leaving the chat: cancels a request still in flight.
+void chat_close();
+
+// Latency percentiles dialog, drawn over the desktop.
+void chat_drawProperties();
+
+extern const App CHAT_APP;
@@ -7,6 +7,8 @@
 #include "notes_icon.h"
 #include "wifi_icon.h"
 
+#include "frame.h"
+#include "app.h"
 #include <Arduino.h>
 
 static TFT_eSPI* tft = nullptr;
@@ -14,25 +16,36 @@ static TFT_eSPI* tft = nullptr;
 static const int SCREEN_W = 320;
 static const int SCREEN_H = 240;
 
-static int aiX      = 24, aiY      = 40;
-static int paintX   = 24, paintY   = 100;
-static int trashX   = 24, trashY   = 160;
-static int netX     = 90, netY     = 40;
-static int notesX   = 90, notesY   = 100;
-
-static const int aiW = 40, aiH = 40;
+// One row per desktop icon. Adding an app to the desktop is one line here
+// plus its entry in the app registry.
+struct Icon {
+  const char*     label;
+  const char*     app;     // registry name; nullptr = nothing to open yet
+  const uint16_t* image;   // nullptr = drawn "AI" tile
+  int             w, h;
+  int             x, y;
+};
+
+static Icon icons[] = {
+  { "Chat",     "chat",     nullptr,           40,                  40,                   24, 40  },
+  { "Paint",    "paint",    paint_icon_map,    PAINT_ICON_WIDTH,    PAINT_ICON_HEIGHT,    24, 100 },
+  { "Trash",    nullptr,    trash_icon_map,    TRASH_ICON_WIDTH,    TRASH_ICON_HEIGHT,    24, 160 },
+  { "Internet", "internet", internet_icon_map, INTERNET_ICON_WIDTH, INTERNET_ICON_HEIGHT, 90, 40  },
+  { "Notes",    nullptr,    notes_icon_map,    NOTES_ICON_WIDTH,    NOTES_ICON_HEIGHT,    90, 100 },
+  { "WiFi",     "wifi",     wifi_icon_map,     WIFI_ICON_WIDTH,     WIFI_ICON_HEIGHT,     90, 160 },
+};
+static const int ICON_COUNT = (int)(sizeof(icons) / sizeof(icons[0]));
+static const int NO_ICON = -1;
 
 static const int LABEL_FONT  = 2;
 static const int LABEL_W     = 96;
 static const int LABEL_H     = 22;
 static const int LABEL_Y_GAP = 4;
 static const int LABEL_PAD   = 2;
-static int wifiX    = 90, wifiY    = 160;
 
-enum DragTarget { DRAG_NONE, DRAG_AI, DRAG_PAINT, DRAG_TRASH, DRAG_NET, DRAG_NOTES, DRAG_WIFI };
 static void drawLabelXP(const char* label, int cx, int topY, bool selected);
 
-static DragTarget dragTarget = DRAG_NONE;
+static int dragTarget = NO_ICON;
 
 static int dragOffX = 0, dragOffY = 0;
 static int downX = 0, downY = 0;
@@ -43,20 +56,18 @@ static const int DRAG_THRESHOLD = 10;
 static const uint32_t HOLD_TO_DRAG_MS = 380;
 static uint32_t pressStartMs = 0;
 
-static DragTarget selectedTarget = DRAG_NONE;
+static int selectedTarget = NO_ICON;
 
-static DragTarget lastTapTarget = DRAG_NONE;
+static int lastTapTarget = NO_ICON;
 static uint32_t lastTapMs = 0;
 static const uint32_t DBL_TAP_MS = 450;
 
 static inline void clearDoubleTap() {
-  lastTapTarget = DRAG_NONE;
+  lastTapTarget = NO_ICON;
   lastTapMs = 0;
 }
 
-enum MenuFor { MENU_NONE, MENU_AI, MENU_PAINT, MENU_TRASH, MENU_NET, MENU_NOTES, MENU_WIFI };
-
-static MenuFor menuFor = MENU_NONE;
+static int menuFor = NO_ICON;
 
 static bool menuVisible = false;
 static int menuX = 0, menuY = 0;
@@ -68,7 +79,9 @@ static const int MENU_ITEMS = 4;
 static bool menuFingerDown = false;
 static int menuActiveItem = -1;
 
-static DragTarget forceDragTarget = DRAG_NONE;
+static int forceDragTarget = NO_ICON;
+
+static bool propsOpen = false;   // an app's properties dialog is over the desktop
 
 static inline bool inRect(int x,int y,int rx,int ry,int rw,int rh){
   return (x>=rx && x<rx+rw && y>=ry && y<ry+rh);
@@ -98,25 +111,13 @@ static Rect iconWithLabelRect(int ix,int iy,int iw,int ih) {
   return { x0, y0, x1 - x0, y1 - y0 };
 }
 
-static Rect aiRect()    { return iconWithLabelRect(aiX, aiY, aiW, aiH); }
-static Rect paintRect() { return iconWithLabelRect(paintX, paintY, PAINT_ICON_WIDTH, PAINT_ICON_HEIGHT); }
-static Rect trashRect() { return iconWithLabelRect(trashX, trashY, TRASH_ICON_WIDTH, TRASH_ICON_HEIGHT); }
-static Rect netRect()   { return iconWithLabelRect(netX, netY, INTERNET_ICON_WIDTH, INTERNET_ICON_HEIGHT); }
-static Rect notesRect() { return iconWithLabelRect(notesX, notesY, NOTES_ICON_WIDTH, NOTES_ICON_HEIGHT); }
-static Rect wifiRect()  { return iconWithLabelRect(wifiX, wifiY, WIFI_ICON_WIDTH, WIFI_ICON_HEIGHT); }
-
-static Rect rectForTarget(DragTarget t) {
-  if (t == DRAG_AI)    return aiRect();
-  if (t == DRAG_PAINT) return paintRect();
-  if (t == DRAG_TRASH) return trashRect();
-  if (t == DRAG_NET)   return netRect();
-  if (t == DRAG_NOTES) return notesRect();
-  if (t == DRAG_WIFI) return wifiRect();
-
-  return {0,0,0,0};
+static Rect rectForTarget(int t) {
+  if (t == NO_ICON) return {0,0,0,0};
+  const Icon& ic = icons[t];
+  return iconWithLabelRect(ic.x, ic.y, ic.w, ic.h);
 }
 
-static void setSelected(DragTarget t);
+static void setSelected(int t);
 
 static uint16_t wallBuf[200 * 80];
 static const int WALLBUF_MAX = (int)(sizeof(wallBuf) / sizeof(wallBuf[0]));
@@ -150,17 +151,6 @@ static void redrawWallpaperRect(int x, int y, int w, int h) {
   tft->pushImage(x, y, w, h, wallBuf);
 }
 
-static void drawWifiIcon() {
-  bool sel = (selectedTarget == DRAG_WIFI);
-
-  tft->setSwapBytes(true);
-
-  tft->pushImage(wifiX, wifiY, WIFI_ICON_WIDTH, WIFI_ICON_HEIGHT, wifi_icon_map, 0x0000);
-
-  int labelTop = wifiY + WIFI_ICON_HEIGHT + LABEL_Y_GAP;
-  drawLabelXP("WiFi", wifiX + WIFI_ICON_WIDTH/2, labelTop, sel);
-}
-
 static void drawLabelXP(const char* label, int cx, int topY, bool selected) {
 
   const uint16_t sel1 = 0x1C9F;
@@ -198,57 +188,23 @@ static void drawLabelXP(const char* label, int cx, int topY, bool selected) {
   }
 }
 
-static void drawAIIcon() {
-  bool sel = (selectedTarget == DRAG_AI);
-
-  tft->fillRoundRect(aiX, aiY, aiW, aiH, 8, TFT_BLUE);
-  tft->drawRoundRect(aiX, aiY, aiW, aiH, 8, TFT_WHITE);
-
-  tft->setTextColor(TFT_WHITE, TFT_BLUE);
-  tft->drawCentreString("AI", aiX + aiW/2, aiY + 10, 4);
-
-  int labelTop = aiY + aiH + LABEL_Y_GAP;
-  drawLabelXP("Chat", aiX + aiW/2, labelTop, sel);
-}
-
-static void drawPaintIcon() {
-  bool sel = (selectedTarget == DRAG_PAINT);
+static void drawIcon(int i) {
+  const Icon& ic = icons[i];
+  bool sel = (selectedTarget == i);
 
-  tft->setSwapBytes(true);
-  tft->pushImage(paintX, paintY, PAINT_ICON_WIDTH, PAINT_ICON_HEIGHT, paint_icon_map, 0x0000);
-
-  int labelTop = paintY + PAINT_ICON_HEIGHT + LABEL_Y_GAP;
-  drawLabelXP("Paint", paintX + PAINT_ICON_WIDTH/2, labelTop, sel);
-}
-
-static void drawTrashIcon() {
-  bool sel = (selectedTarget == DRAG_TRASH);
-
-  tft->setSwapBytes(true);
-  tft->pushImage(trashX, trashY, TRASH_ICON_WIDTH, TRASH_ICON_HEIGHT, trash_icon_map, 0x0000);
-
-  int labelTop = trashY + TRASH_ICON_HEIGHT + LABEL_Y_GAP;
-  drawLabelXP("Trash", trashX + TRASH_ICON_WIDTH/2, labelTop, sel);
-}
-
-static void drawInternetIcon() {
-  bool sel = (selectedTarget == DRAG_NET);
-
-  tft->setSwapBytes(true);
-  tft->pushImage(netX, netY, INTERNET_ICON_WIDTH, INTERNET_ICON_HEIGHT, internet_icon_map, 0x0000);
-
-  int labelTop = netY + INTERNET_ICON_HEIGHT + LABEL_Y_GAP;
-  drawLabelXP("Internet", netX + INTERNET_ICON_WIDTH/2, labelTop, sel);
-}
-
-static void drawNotesIcon() {
-  bool sel = (selectedTarget == DRAG_NOTES);
+  if (ic.image) {
+    tft->setSwapBytes(true);
+    tft->pushImage(ic.x, ic.y, ic.w, ic.h, ic.image, 0x0000);
+  } else {
+    tft->fillRoundRect(ic.x, ic.y, ic.w, ic.h, 8, TFT_BLUE);
+    tft->drawRoundRect(ic.x, ic.y, ic.w, ic.h, 8, TFT_WHITE);
 
-  tft->setSwapBytes(true);
-  tft->pushImage(notesX, notesY, NOTES_ICON_WIDTH, NOTES_ICON_HEIGHT, notes_icon_map, 0x0000);
+    tft->setTextColor(TFT_WHITE, TFT_BLUE);
+    tft->drawCentreString("AI", ic.x + ic.w/2, ic.y + 10, 4);
+  }
 
-  int labelTop = notesY + NOTES_ICON_HEIGHT + LABEL_Y_GAP;
-  drawLabelXP("Notes", notesX + NOTES_ICON_WIDTH/2, labelTop, sel);
+  int labelTop = ic.y + ic.h + LABEL_Y_GAP;
+  drawLabelXP(ic.label, ic.x + ic.w/2, labelTop, sel);
 }
 
 static int menuHeight() { return MENU_ITEM_H * MENU_ITEMS + 6; }
@@ -313,19 +269,10 @@ static int menu_hitItem(int x, int y) {
 static void redrawSceneRect(int x,int y,int w,int h) {
   redrawWallpaperRect(x,y,w,h);
 
-  Rect ar = aiRect();
-  Rect pr = paintRect();
-  Rect tr = trashRect();
-  Rect nr = netRect();
-  Rect br = notesRect();
-  Rect wr = wifiRect();
-
-  if (rectIntersects(x,y,w,h, ar.x,ar.y,ar.w,ar.h)) drawAIIcon();
-  if (rectIntersects(x,y,w,h, pr.x,pr.y,pr.w,pr.h)) drawPaintIcon();
-  if (rectIntersects(x,y,w,h, tr.x,tr.y,tr.w,tr.h)) drawTrashIcon();
-  if (rectIntersects(x,y,w,h, nr.x,nr.y,nr.w,nr.h)) drawInternetIcon();
-  if (rectIntersects(x,y,w,h, br.x,br.y,br.w,br.h)) drawNotesIcon();
-  if (rectIntersects(x,y,w,h, wr.x,wr.y,wr.w,wr.h)) drawWifiIcon();
+  for (int i = 0; i < ICON_COUNT; i++) {
+    Rect r = rectForTarget(i);
+    if (rectIntersects(x,y,w,h, r.x,r.y,r.w,r.h)) drawIcon(i);
+  }
 
   if (menuVisible) {
     int mh = menuHeight();
@@ -342,12 +289,12 @@ static void menu_hide() {
   menuVisible = false;
   menuFingerDown = false;
   menuActiveItem = -1;
-  menuFor = MENU_NONE;
+  menuFor = NO_ICON;
 
   redrawSceneRect(menuX, menuY, MENU_W, h);
 }
 
-static void setSelected(DragTarget t) {
+static void setSelected(int t) {
   if (t == selectedTarget) return;
 
   Rect oldR = rectForTarget(selectedTarget);
@@ -363,95 +310,61 @@ void desktop_init(TFT_eSPI* display) {
   tft = display;
 }
 
+const App DESKTOP_APP = {
+  "desktop",
+  desktop_draw,
+  nullptr,
+  desktop_handleTouch,
+  nullptr, nullptr, nullptr, nullptr
+};
+
 void desktop_draw() {
   if (!tft) return;
+  frame_clear();
+  propsOpen = false;
 
   tft->setSwapBytes(true);
   tft->pushImage(0, 0, WALLPAPER_WIDTH, WALLPAPER_HEIGHT, wallpaper_map);
 
-  drawAIIcon();
-  drawPaintIcon();
-  drawTrashIcon();
-  drawInternetIcon();
-  drawNotesIcon();
-  drawWifiIcon();
+  for (int i = 0; i < ICON_COUNT; i++) drawIcon(i);
 
   if (menuVisible) menu_draw_xp(menuActiveItem);
 }
 
-static DesktopAction openForTarget(DragTarget t) {
-  if (t == DRAG_AI)    return DESKTOP_OPEN_CHAT;
-  if (t == DRAG_PAINT) return DESKTOP_OPEN_PAINT;
-  if (t == DRAG_TRASH) return DESKTOP_OPEN_TRASH;
-  if (t == DRAG_NET)   return DESKTOP_OPEN_INTERNET;
-  if (t == DRAG_NOTES) return DESKTOP_OPEN_NOTES;
-  if (t == DRAG_WIFI) return DESKTOP_OPEN_WIFI;
-
-  return DESKTOP_NONE;
+static void openIcon(int t) {
+  const Icon& ic = icons[t];
+  if (!app_open(ic.app)) Serial.printf("%s: nothing to open\n", ic.label);
 }
 
-static DesktopAction propsForMenu(MenuFor mf) {
-  if (mf == MENU_AI)    return DESKTOP_PROPERTIES_CHAT;
-  if (mf == MENU_PAINT) return DESKTOP_PROPERTIES_PAINT;
-  if (mf == MENU_TRASH) return DESKTOP_PROPERTIES_TRASH;
-  if (mf == MENU_NET)   return DESKTOP_PROPERTIES_INTERNET;
-  if (mf == MENU_NOTES) return DESKTOP_PROPERTIES_NOTES;
-  if (mf == MENU_WIFI) return DESKTOP_PROPERTIES_WIFI;
-
-  return DESKTOP_NONE;
+static void showProperties(int t) {
+  const Icon& ic = icons[t];
+  if (app_properties(ic.app)) propsOpen = true;
+  else Serial.printf("%s Properties (TODO)\n", ic.label);
 }
 
-static DesktopAction openForMenu(MenuFor mf) {
-  if (mf == MENU_AI)    return DESKTOP_OPEN_CHAT;
-  if (mf == MENU_PAINT) return DESKTOP_OPEN_PAINT;
-  if (mf == MENU_TRASH) return DESKTOP_OPEN_TRASH;
-  if (mf == MENU_NET)   return DESKTOP_OPEN_INTERNET;
-  if (mf == MENU_NOTES) return DESKTOP_OPEN_NOTES;
-  if (mf == MENU_WIFI) return DESKTOP_OPEN_WIFI;
+static int hitTestTarget(int x, int y, bool* onIconBody) {
+  *onIconBody = false;
 
-  return DESKTOP_NONE;
-}
+  for (int i = 0; i < ICON_COUNT; i++) {
+    const Icon& ic = icons[i];
+    if (inRect(x,y, ic.x,ic.y,ic.w,ic.h)) { *onIconBody = true; return i; }
+  }
 
-static MenuFor menuForTarget(DragTarget t) {
-  if (t == DRAG_AI)    return MENU_AI;
-  if (t == DRAG_PAINT) return MENU_PAINT;
-  if (t == DRAG_TRASH) return MENU_TRASH;
-  if (t == DRAG_NET)   return MENU_NET;
-  if (t == DRAG_NOTES) return MENU_NOTES;
-  if (t == DRAG_WIFI) return MENU_WIFI;
+  for (int i = 0; i < ICON_COUNT; i++) {
+    Rect r = rectForTarget(i);
+    if (inRect(x,y, r.x,r.y,r.w,r.h)) return i;
+  }
 
-  return MENU_NONE;
+  return NO_ICON;
 }
 
-static DragTarget hitTestTarget(int x, int y, bool* onIconBody) {
-  *onIconBody = false;
-
-  if (inRect(x,y, aiX,aiY,aiW,aiH)) { *onIconBody = true; return DRAG_AI; }
-  if (inRect(x,y, paintX,paintY,PAINT_ICON_WIDTH,PAINT_ICON_HEIGHT)) { *onIconBody = true; return DRAG_PAINT; }
-  if (inRect(x,y, trashX,trashY,TRASH_ICON_WIDTH,TRASH_ICON_HEIGHT)) { *onIconBody = true; return DRAG_TRASH; }
-  if (inRect(x,y, netX,netY,INTERNET_ICON_WIDTH,INTERNET_ICON_HEIGHT)) { *onIconBody = true; return DRAG_NET; }
-  if (inRect(x,y, notesX,notesY,NOTES_ICON_WIDTH,NOTES_ICON_HEIGHT)) { *onIconBody = true; return DRAG_NOTES; }
-  if (inRect(x,y, wifiX,wifiY,WIFI_ICON_WIDTH,WIFI_ICON_HEIGHT)) { *onIconBody = true; return DRAG_WIFI; }
-
-  Rect ar = aiRect();
-  Rect pr = paintRect();
-  Rect tr = trashRect();
-  Rect nr = netRect();
-  Rect br = notesRect();
-  Rect wr = wifiRect();
-
-  if (inRect(x,y, ar.x,ar.y,ar.w,ar.h)) return DRAG_AI;
-  if (inRect(x,y, pr.x,pr.y,pr.w,pr.h)) return DRAG_PAINT;
-  if (inRect(x,y, tr.x,tr.y,tr.w,tr.h)) return DRAG_TRASH;
-  if (inRect(x,y, nr.x,nr.y,nr.w,nr.h)) return DRAG_NET;
-  if (inRect(x,y, br.x,br.y,br.w,br.h)) return DRAG_NOTES;
-  if (inRect(x,y, wr.x,wr.y,wr.w,wr.h)) return DRAG_WIFI;
-
-  return DRAG_NONE;
-}
+bool desktop_handleTouch(bool pressed, bool lastPressed, int x, int y) {
+  if (!tft) return true;
 
-DesktopAction desktop_handleTouch(bool pressed, bool lastPressed, int x, int y) {
-  if (!tft) return DESKTOP_NONE;
+  if (propsOpen) {
+    if (pressed && !lastPressed) desktop_draw();
+    return true;
+  }
 
   if (menuVisible) {
     if (pressed && !lastPressed) {
@@ -462,7 +375,7 @@ DesktopAction desktop_handleTouch(bool pressed, bool lastPressed, int x, int y)
       if (menuActiveItem < 0) {
         menu_hide();
       }
-      return DESKTOP_NONE;
+      return true;
     }
 
     if (pressed && lastPressed && menuFingerDown) {
@@ -471,32 +384,23 @@ DesktopAction desktop_handleTouch(bool pressed, bool lastPressed, int x, int y)
         menuActiveItem = hit;
         menu_draw_xp(menuActiveItem);
       }
-      return DESKTOP_NONE;
+      return true;
     }
 
     if (!pressed && lastPressed && menuFingerDown) {
       int item = menuActiveItem;
-      MenuFor mf = menuFor;
+      int mf = menuFor;
 
       menu_hide();
+      if (mf == NO_ICON) return true;
 
-      if (item == 0) return openForMenu(mf);
-if (item == 1) {
-  if (mf == MENU_AI)    forceDragTarget = DRAG_AI;
-  if (mf == MENU_PAINT) forceDragTarget = DRAG_PAINT;
-  if (mf == MENU_TRASH) forceDragTarget = DRAG_TRASH;
-  if (mf == MENU_NET)   forceDragTarget = DRAG_NET;
-  if (mf == MENU_NOTES) forceDragTarget = DRAG_NOTES;
-  if (mf == MENU_WIFI)  forceDragTarget = DRAG_WIFI;
-  return DESKTOP_NONE;
-}
-
-      if (item == 2) return propsForMenu(mf);
-      return DESKTOP_NONE;
-
+      if (item == 0) openIcon(mf);
+      if (item == 1) forceDragTarget = mf;
+      if (item == 2) showProperties(mf);
+      return true;
     }
 
-    return DESKTOP_NONE;
+    return true;
   }
 
   if (pressed && !lastPressed) {
@@ -506,42 +410,37 @@ if (item == 1) {
 
     dragTarget = hitTestTarget(x, y, &pressedOnIconBody);
 
-    if (dragTarget == DRAG_NONE) {
+    if (dragTarget == NO_ICON) {
 
-      if (selectedTarget != DRAG_NONE) setSelected(DRAG_NONE);
+      if (selectedTarget != NO_ICON) setSelected(NO_ICON);
       clearDoubleTap();
     } else {
 
       setSelected(dragTarget);
 
       if (pressedOnIconBody) {
-        if (dragTarget == DRAG_AI)    { dragOffX = x - aiX;    dragOffY = y - aiY; }
-        if (dragTarget == DRAG_PAINT) { dragOffX = x - paintX; dragOffY = y - paintY; }
-        if (dragTarget == DRAG_TRASH) { dragOffX = x - trashX; dragOffY = y - trashY; }
-        if (dragTarget == DRAG_NET)   { dragOffX = x - netX;   dragOffY = y - netY; }
-        if (dragTarget == DRAG_NOTES) { dragOffX = x - notesX; dragOffY = y - notesY; }
-        if (dragTarget == DRAG_WIFI) { dragOffX = x - wifiX; dragOffY = y - wifiY; }
-
+        dragOffX = x - icons[dragTarget].x;
+        dragOffY = y - icons[dragTarget].y;
       } else {
         dragOffX = 0; dragOffY = 0;
       }
     }
 
-    if (forceDragTarget != DRAG_NONE) {
+    if (forceDragTarget != NO_ICON) {
       if (dragTarget == forceDragTarget) {
         moved = true;
       }
-      forceDragTarget = DRAG_NONE;
+      forceDragTarget = NO_ICON;
     }
 
-    return DESKTOP_NONE;
+    return true;
   }
 
-  if (pressed && lastPressed && dragTarget != DRAG_NONE) {
+  if (pressed && lastPressed && dragTarget != NO_ICON) {
 
     if (!pressedOnIconBody && !moved) {
 
-      return DESKTOP_NONE;
+      return true;
     }
 
     int dx = x - downX;
@@ -560,56 +459,42 @@ if (item == 1) {
     if (moved) {
       Rect oldR = rectForTarget(dragTarget);
 
-      if (dragTarget == DRAG_AI) {
-        aiX = constrain(x - dragOffX, 0, SCREEN_W - aiW);
-        aiY = constrain(y - dragOffY, 0, SCREEN_H - aiH - LABEL_H);
-      } else if (dragTarget == DRAG_PAINT) {
-        paintX = constrain(x - dragOffX, 0, SCREEN_W - PAINT_ICON_WIDTH);
-        paintY = constrain(y - dragOffY, 0, SCREEN_H - PAINT_ICON_HEIGHT - LABEL_H);
-      } else if (dragTarget == DRAG_TRASH) {
-        trashX = constrain(x - dragOffX, 0, SCREEN_W - TRASH_ICON_WIDTH);
-        trashY = constrain(y - dragOffY, 0, SCREEN_H - TRASH_ICON_HEIGHT - LABEL_H);
-      } else if (dragTarget == DRAG_NET) {
-        netX = constrain(x - dragOffX, 0, SCREEN_W - INTERNET_ICON_WIDTH);
-        netY = constrain(y - dragOffY, 0, SCREEN_H - INTERNET_ICON_HEIGHT - LABEL_H);
-      } else if (dragTarget == DRAG_NOTES) {
-        notesX = constrain(x - dragOffX, 0, SCREEN_W - NOTES_ICON_WIDTH);
-        notesY = constrain(y - dragOffY, 0, SCREEN_H - NOTES_ICON_HEIGHT - LABEL_H);
-      } else if (dragTarget == DRAG_WIFI) {
-  wifiX = constrain(x - dragOffX, 0, SCREEN_W - WIFI_ICON_WIDTH);
-  wifiY = constrain(y - dragOffY, 0, SCREEN_H - WIFI_ICON_HEIGHT - LABEL_H);
-}
+      Icon& ic = icons[dragTarget];
+      ic.x = constrain(x - dragOffX, 0, SCREEN_W - ic.w);
+      ic.y = constrain(y - dragOffY, 0, SCREEN_H - ic.h - LABEL_H);
 
       Rect newR = rectForTarget(dragTarget);
 
-      redrawSceneRect(oldR.x, oldR.y, oldR.w, oldR.h);
-      redrawSceneRect(newR.x, newR.y, newR.w, newR.h);
+      // several touch samples per frame collapse into one repaint
+      frame_invalidate(redrawSceneRect, oldR.x, oldR.y, oldR.w, oldR.h);
+      frame_invalidate(redrawSceneRect, newR.x, newR.y, newR.w, newR.h);
     }
 
-    return DESKTOP_NONE;
+    return true;
   }
 
 if (!pressed && lastPressed) {
   Serial.printf("UP x=%d y=%d dragTarget=%d moved=%d held=%lu\n",
                 x, y, (int)dragTarget, (int)moved, (unsigned long)(millis() - pressStartMs));
 
-    if (dragTarget != DRAG_NONE) {
+    if (dragTarget != NO_ICON) {
       uint32_t heldMs = millis() - pressStartMs;
 
-if (!moved && heldMs < HOLD_TO_DRAG_MS) {
-  DesktopAction act = openForTarget(dragTarget);
-  clearDoubleTap();
-  dragTarget = DRAG_NONE;
-  moved = false;
-  return act;
-}
+      if (!moved && heldMs < HOLD_TO_DRAG_MS) {
+        int t = dragTarget;
+        clearDoubleTap();
+        dragTarget = NO_ICON;
+        moved = false;
+        openIcon(t);
+        return true;
+      }
 
       if (!moved && heldMs >= HOLD_TO_DRAG_MS) {
         clearDoubleTap();
 
         menuX = x;
         menuY = y;
-        menuFor = menuForTarget(dragTarget);
+        menuFor = dragTarget;
 
         menuFingerDown = false;
         menuActiveItem = -1;
@@ -618,10 +503,10 @@ if (!moved && heldMs < HOLD_TO_DRAG_MS) {
       }
     }
 
-    dragTarget = DRAG_NONE;
+    dragTarget = NO_ICON;
     moved = false;
-    return DESKTOP_NONE;
+    return true;
   }
 
-  return DESKTOP_NONE;
+  return true;
 }
@@ -0,0 +1,143 @@
+#include "frame.h"
+
+struct FrameItem {
+  FrameRectFn rectFn;   // set for rect repaints
+  FrameDrawFn fn;       // set for whole-widget repaints
+  int16_t     x, y, w, h;
+};
+
+static FrameItem items[FRAME_MAX_ITEMS];
+static int       itemCount = 0;
+
+static const uint32_t FRAME_US = 1000000UL / FRAME_HZ;
+static uint32_t lastFrameUs = 0;
+
+// since the last FRAME command
+static uint32_t frames      = 0;
+static uint32_t workSumUs   = 0;
+static uint32_t workMaxUs   = 0;
+static uint32_t overBudget  = 0;
+static uint32_t deferred    = 0;
+static uint32_t merged      = 0;
+static uint32_t requests    = 0;
+static uint32_t statsSince  = 0;
+static uint32_t stallMaxUs  = 0;   // longest gap between frame_tick() calls
+
+static uint32_t lastTickUs  = 0;
+
+static bool touches(const FrameItem& a, int x, int y, int w, int h)
+{
+  return !(a.x + a.w < x || x + w < a.x || a.y + a.h < y || y + h < a.y);
+}
+
+static void run(const FrameItem& it)
+{
+  if (it.rectFn) it.rectFn(it.x, it.y, it.w, it.h);
+  else if (it.fn) it.fn();
+}
+
+void frame_invalidate(FrameRectFn fn, int x, int y, int w, int h)
+{
+  if (w <= 0 || h <= 0) return;
+  requests++;
+
+  FrameItem* same = nullptr;
+  for (int i = 0; i < itemCount; i++) {
+    FrameItem& it = items[i];
+    if (it.rectFn != fn) continue;
+    if (!same) same = &it;
+    if (!touches(it, x, y, w, h)) continue;
+    same = &it;
+    break;
+  }
+
+  // merge into an overlapping rect, or into any rect of this fn when full
+  if (same && (touches(*same, x, y, w, h) || itemCount == FRAME_MAX_ITEMS)) {
+    int x0 = min((int)same->x, x), y0 = min((int)same->y, y);
+    int x1 = max(same->x + same->w, x + w), y1 = max(same->y + same->h, y + h);
+    same->x = x0; same->y = y0; same->w = x1 - x0; same->h = y1 - y0;
+    merged++;
+    return;
+  }
+
+  if (itemCount == FRAME_MAX_ITEMS) {   // nothing to merge with: paint now
+    fn(x, y, w, h);
+    return;
+  }
+  items[itemCount++] = { fn, nullptr, (int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h };
+}
+
+void frame_request(FrameDrawFn fn)
+{
+  requests++;
+  for (int i = 0; i < itemCount; i++) {
+    if (items[i].fn == fn) {
+      merged++;
+      return;
+    }
+  }
+  if (itemCount == FRAME_MAX_ITEMS) {
+    fn();
+    return;
+  }
+  items[itemCount++] = { nullptr, fn, 0, 0, 0, 0 };
+}
+
+void frame_clear()
+{
+  itemCount = 0;
+}
+
+void frame_tick()
+{
+  uint32_t now = micros();
+  if (lastTickUs && now - lastTickUs > stallMaxUs) stallMaxUs = now - lastTickUs;
+  lastTickUs = now;
+
+  if (now - lastFrameUs < FRAME_US) return;
+  lastFrameUs = now;
+  if (itemCount == 0) return;
+
+  // At least one item per frame, so a slow one can't starve the queue.
+  // Items may queue more work while they run; that waits for the next frame.
+  int n = itemCount;
+  int done = 0;
+  while (done < n) {
+    FrameItem it = items[done++];
+    run(it);
+    if (micros() - now >= FRAME_BUDGET_US) break;
+  }
+
+  memmove(items, items + done, (itemCount - done) * sizeof(items[0]));
+  itemCount -= done;
+
+  uint32_t work = micros() - now;
+  frames++;
+  workSumUs += work;
+  if (work > workMaxUs) workMaxUs = work;
+  if (work > FRAME_BUDGET_US) overBudget++;
+  if (done < n) deferred += n - done;
+}
+
+void frame_printStats(Print& out)
+{
+  uint32_t secs = (millis() - statsSince) / 1000;
+  out.printf("Frames: %lu painted in %lu s (target %d Hz), work avg %lu us, max %lu us\n",
+             (unsigned long)frames, (unsigned long)secs, FRAME_HZ,
+             (unsigned long)(frames ? workSumUs / frames : 0), (unsigned long)workMaxUs);
+  out.printf("        %lu over the %lu us budget, %lu items deferred, %lu of %lu requests merged\n",
+             (unsigned long)overBudget, (unsigned long)FRAME_BUDGET_US,
+             (unsigned long)deferred, (unsigned long)merged, (unsigned long)requests);
+  out.printf("        longest loop() stall %lu ms\n", (unsigned long)(stallMaxUs / 1000));
+}
+
+bool frame_handleSerial(const String& line)
+{
+  if (line != "FRAME") return false;
+
+  frame_printStats(Serial);
+  frames = workSumUs = workMaxUs = overBudget = deferred = merged = requests = 0;
+  stallMaxUs = 0;
+  statsSince = millis();
+  return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <Arduino.h>
+
+// Redraw scheduler. Touch handlers update state and queue what needs
+// repainting; frame_tick() paints the queue at most FRAME_HZ times a second,
+// within FRAME_BUDGET_US, and leaves the rest for the next frame.
+
+#ifndef FRAME_HZ
+#define FRAME_HZ 60
+#endif
+
+#ifndef FRAME_BUDGET_US
+#define FRAME_BUDGET_US 12000
+#endif
+
+#ifndef FRAME_MAX_ITEMS
+#define FRAME_MAX_ITEMS 16
+#endif
+
+typedef void (*FrameDrawFn)();
+typedef void (*FrameRectFn)(int x, int y, int w, int h);
+
+// Repaint a rect; overlapping rects for the same fn are merged into one.
+void frame_invalidate(FrameRectFn fn, int x, int y, int w, int h);
+// Run fn once in the next frame, however often it was requested.
+void frame_request(FrameDrawFn fn);
+
+// Call every loop(); paints when a frame is due.
+void frame_tick();
+// A full-screen draw just happened; pending repaints are stale.
+void frame_clear();
+
+void frame_printStats(Print& out);
+// FRAME prints and resets the stats. Returns false for other lines.
+bool frame_handleSerial(const String& line);
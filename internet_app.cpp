@@ -1,4 +1,5 @@
 #include "internet_app.h"
+#include "frame.h"
 #include "windows.h"
 
 static TFT_eSPI* tft = nullptr;
@@ -36,7 +37,9 @@ static const int IMG_PAD = 6;
 static const int MAX_LINES  = 120;
 static const int LINE_CHARS = 44;
 
-static char pageLines[MAX_LINES][LINE_CHARS + 1];
+// Built when the page opens, freed when it closes.
+static char (*pageLines)[LINE_CHARS + 1] = nullptr;
+static int  lineCap    = 0;   // rows allocated; shrinks to fit the page
 static int  lineCount  = 0;
 static int  scrollLine = 0;
 
@@ -45,13 +48,13 @@ static inline bool inRect(int x,int y,int rx,int ry,int rw,int rh){
 }
 
 static void clearLines() {
-  for (int i=0;i<MAX_LINES;i++) pageLines[i][0] = 0;
+  if (pageLines) for (int i=0;i<lineCap;i++) pageLines[i][0] = 0;
   lineCount = 0;
   scrollLine = 0;
 }
 
 static void addLineC(const String& s) {
-  if (lineCount >= MAX_LINES) return;
+  if (!pageLines || lineCount >= lineCap) return;
   String t = s;
   t.trim();
   if (t.length() == 0) return;
@@ -62,7 +65,7 @@ static void addLineC(const String& s) {
 
 static void addWrapped(const String& s) {
   String t = s;
-  while (t.length() > 0 && lineCount < MAX_LINES) {
+  while (t.length() > 0 && lineCount < lineCap) {
     if ((int)t.length() <= LINE_CHARS) {
       addLineC(t);
       return;
@@ -200,18 +203,49 @@ static void drawAllUI() {
 
 void internet_app_init(TFT_eSPI* display) {
   tft = display;
+}
+
+static void loadPage() {
+  if (pageLines) return;
+  pageLines = (char (*)[LINE_CHARS + 1])malloc(MAX_LINES * (LINE_CHARS + 1));
+  lineCap = pageLines ? MAX_LINES : 0;
   buildFakePage();
+  if (!pageLines || lineCount == 0) return;
+
+  // keep only the rows the article used
+  void* fit = realloc(pageLines, lineCount * (LINE_CHARS + 1));
+  if (fit) {
+    pageLines = (char (*)[LINE_CHARS + 1])fit;
+    lineCap = lineCount;
+  }
+}
+
+static void internetClose() {
+  opened = false;
+  free(pageLines);
+  pageLines = nullptr;
+  lineCap = 0;
+  lineCount = 0;
 }
 
 bool internet_app_isOpen() { return opened; }
 
 void internet_app_open() {
   if (!tft) return;
+  frame_clear();
   opened = true;
+  loadPage();
   scrollLine = 0;
   drawAllUI();
 }
 
+// Same page, same scroll position.
+static void internetResume() {
+  if (!tft) return;
+  frame_clear();
+  drawAllUI();
+}
+
 void internet_app_tick() {
   if (!opened) return;
 }
@@ -236,3 +270,12 @@ bool internet_app_handleTouch(bool pressed, bool lastPressed, int x, int y) {
 
   return true;
 }
+
+const App INTERNET_APP = {
+  "internet",
+  internet_app_open,
+  internetClose,
+  internet_app_handleTouch,
+  nullptr, nullptr, nullptr, nullptr,
+  internetResume
+};
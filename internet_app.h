@@ -1,5 +1,6 @@
 #pragma once
 #include <TFT_eSPI.h>
+#include "app.h"
 
 void internet_app_init(TFT_eSPI* display);
 bool internet_app_isOpen();
@@ -7,3 +8,5 @@ void internet_app_open();
 void internet_app_tick();
 
 bool internet_app_handleTouch(bool pressed, bool lastPressed, int x, int y);
+
+extern const App INTERNET_APP;
@@ -1,425 +1,607 @@
 #include "keyboard.h"
+#include "frame.h"
+#include "app.h"
 #include <Arduino.h>
 #include <ctype.h>
 
-static TFT_eSPI *tft = nullptr;
-
-static char text[KB_TEXT_MAX + 1];
-static int  cursor = 0;
-
-static bool visible = true;
-static bool mode123 = false;
-static bool caps    = false;
-
 static const int SCREEN_W = 320;
 static const int SCREEN_H = 240;
 
-static const int KB_DY = 0;
-
-static const int PAD_L = 6;
-static const int PAD_R = 6;
-
-static const int GAP = 1;
-
 static const int FN_W   = 54;
 static const int CAPS_W = 54;
+static const int ROW2_INDENT = 10;
+static const int ARROW_W = 36;
 
 static const int HIT_PAD = 10;
-static const uint32_t RELEASE_DEBOUNCE_MS = 70;
-
-static bool     stablePressed   = false;
-static uint32_t lastTouchSeenMs = 0;
-static bool     keyDown         = false;
-static int      activeIdx       = -1;
-
-static bool delHeld = false;
-static uint32_t delStart = 0;
-static uint32_t delLast  = 0;
-static const uint32_t DEL_DELAY  = 450;
-static const uint32_t DEL_REPEAT = 80;
-
-static bool capsHeld = false;
-static uint32_t capsDownAt = 0;
-static bool capsDidClear = false;
+static const uint8_t NO_KEY = 0xFF;
+
+static const uint32_t REPEAT_DELAY = 450;
+static const uint32_t REPEAT_EVERY = 80;
 static const uint32_t CAPS_CLEAR_HOLD = 500;
 
-static inline bool insidePad(int x,int y,int rx,int ry,int rw,int rh,int pad){
-  return x >= (rx - pad) && x < (rx + rw + pad) && y >= (ry - pad) && y < (ry + rh + pad);
+// The keyboard last drawn; frame callbacks take no arguments.
+static Keyboard* onScreen = nullptr;
+
+static void drawOnScreen()      { if (onScreen) onScreen->draw(); }
+static void drawOnScreenDirty() { if (onScreen) onScreen->drawDirty(); }
+
+KeyboardCfg keyboard_defaultCfg() {
+  KeyboardCfg c;
+  c.x = 0;
+  c.y = KB_Y;
+  c.w = SCREEN_W;
+  c.h = SCREEN_H - KB_Y;
+  c.pad = 6;
+  c.gap = 1;
+  c.okKey = false;
+  c.bevel = false;
+  c.bg = TFT_WHITE;
+  c.face = TFT_LIGHTGREY;
+  c.faceDown = TFT_DARKGREY;
+  c.text = TFT_BLACK;
+  c.edge = TFT_DARKGREY;
+  c.edgeDown = TFT_BLACK;
+  return c;
 }
 
-static void addChar(char c) {
-  if (cursor >= KB_TEXT_MAX) return;
-  text[cursor++] = c;
-  text[cursor] = 0;
+// ============================================================
+// Layout
+// ============================================================
+static void addKey(KeyRect *keys, int &count, int8_t &capsIdx, int max,
+                   int x,int y,int w,int h, KeyType type, const char *label, char ch = 0) {
+  if (count >= max) return;
+  if (type == KT_CAPS) capsIdx = (int8_t)count;
+  keys[count++] = {(int16_t)x,(int16_t)y,(int16_t)w,(int16_t)h,type,ch,label};
 }
 
-static void backspaceOnce() {
-  if (cursor > 0) {
-    cursor--;
-    text[cursor] = 0;
+void Keyboard::buildKeys(Layout &l, Page p) {
+  static const char *rows[PAGES][3] = {
+    { "QWERTYUIOP", "ASDFGHJKL", "ZXCVBNM" },
+    { "1234567890", "-/:;()$&@", ".,?!'\"+" },
+    { "[]{}#%^*+=", "_\\|~<>`$@", ".,?!'\"+" },
+  };
+
+  l.count = 0;
+  l.capsIdx = -1;
+#define KEY(...) addKey(l.keys, l.count, l.capsIdx, MAX_KEYS, __VA_ARGS__)
+
+  const int KH  = pitch - cfg.gap;
+  const int gap = cfg.gap;
+  const int y0 = cfg.y;
+  const int y1 = y0 + pitch;
+  const int y2 = y0 + 2*pitch;
+  const int y3 = y0 + 3*pitch;
+
+  const int leftX  = cfg.x + cfg.pad;
+  const int rightX = cfg.x + cfg.w - cfg.pad;
+  const int xMode = rightX - FN_W;
+  const int xClr  = xMode - gap - FN_W;
+  const int xDel  = xMode;
+
+  {
+    const char *r = rows[p][0];
+    int n = 10;
+    int w = ((rightX - leftX) - (n-1)*gap) / n;
+    int x = leftX;
+    for (int i=0;i<n;i++){
+      KEY(x, y0, w, KH, KT_CHAR, nullptr, r[i]);
+      x += w + gap;
+    }
   }
-}
 
-static int kbTopY() {
-  int ty = KB_Y + KB_DY;
-  if (ty < 0) ty = 0;
-  if (ty > SCREEN_H - 60) ty = SCREEN_H - 60;
-  return ty;
-}
+  {
+    const char *r = rows[p][1];
+    int n = 9;
+    int x = leftX + ROW2_INDENT;
+    int w = (((xDel - gap) - x) - (n-1)*gap) / n;
+    for (int i=0;i<n;i++){
+      KEY(x, y1, w, KH, KT_CHAR, nullptr, r[i]);
+      x += w + gap;
+    }
+    KEY(xDel, y1, FN_W, KH, KT_DEL, "DEL");
+  }
 
-static int keyH() {
-  int ty = kbTopY();
-  int availH = SCREEN_H - ty;
+  {
+    // CAPS on letters, the other symbol page on 123 and #+=
+    if (p == PAGE_ABC) KEY(leftX, y2, CAPS_W, KH, KT_CAPS, "CAPS");
+    else               KEY(leftX, y2, CAPS_W, KH, KT_SYM, p == PAGE_123 ? "#+=" : "123");
+
+    const char *r = rows[p][2];
+    int x = leftX + CAPS_W + gap;
+    int w = (((xClr - gap) - x) - (7-1)*gap) / 7;
+    for (int i=0;i<7;i++){
+      KEY(x, y2, w, KH, KT_CHAR, nullptr, r[i]);
+      x += w + gap;
+    }
 
-  int h = (availH - 3*GAP) / 4;
-  if (h < 18) h = 18;
-  if (h > 28) h = 28;
-  return h;
-}
+    KEY(xClr,  y2, FN_W, KH, KT_CLR,  "CLR");
+    KEY(xMode, y2, FN_W, KH, KT_MODE, p == PAGE_ABC ? "123" : "ABC");
+  }
 
-static int spaceH() {
+  {
+    int endX = cfg.okKey ? xMode - gap : rightX;
+    int xRight = endX - ARROW_W;
+    KEY(leftX, y3, ARROW_W, KH, KT_LEFT, "<-");
+    KEY(leftX + ARROW_W + gap, y3, (xRight - gap) - (leftX + ARROW_W + gap), KH, KT_SPACE, "SPACE");
+    KEY(xRight, y3, ARROW_W, KH, KT_RIGHT, "->");
+    if (cfg.okKey) KEY(xMode, y3, FN_W, KH, KT_OK, "OK");
+  }
+#undef KEY
+}
 
-  return keyH();
+// Each cell gets the key under it, or the nearest key of its row within
+// HIT_PAD, so a touch in a gap goes to the closer neighbour.
+void Keyboard::buildGrid(Layout &l) {
+  for (int r = 0; r < ROWS; r++) {
+    for (int c = 0; c < GRID_W; c++) {
+      int px = c * CELL + CELL / 2;
+      int best = NO_KEY, bestD = HIT_PAD + 1;
+
+      for (int i = 0; i < l.count; i++) {
+        const KeyRect& k = l.keys[i];
+        if ((k.y - cfg.y) / pitch != r) continue;
+        int d = px < k.x ? k.x - px : (px >= k.x + k.w ? px - (k.x + k.w - 1) : 0);
+        if (d < bestD) { bestD = d; best = i; }
+      }
+      l.grid[r][c] = (uint8_t)best;
+    }
+  }
 }
 
-static void drawKey(int x,int y,int w,int h,const char*label, bool pressed) {
-  uint16_t fill   = pressed ? TFT_DARKGREY : TFT_LIGHTGREY;
-  uint16_t border = pressed ? TFT_BLACK    : TFT_DARKGREY;
+void Keyboard::buildLayouts() {
+  int h = (cfg.h - 3*cfg.gap) / 4;
+  if (h < 12) h = 12;
+  pitch = h + cfg.gap;
 
-  tft->fillRoundRect(x,y,w,h,3, fill);
-  tft->drawRoundRect(x,y,w,h,3, border);
+  for (int p = 0; p < PAGES; p++) {
+    buildKeys(pages[p], (Page)p);
+    buildGrid(pages[p]);
+  }
+}
 
-  tft->setTextColor(TFT_BLACK, fill);
-  tft->setTextDatum(MC_DATUM);
-  tft->drawString(label, x + w/2, y + h/2, 2);
-  tft->setTextDatum(TL_DATUM);
+int Keyboard::hitTest(int x, int y) const {
+  if (x < cfg.x || x >= cfg.x + cfg.w || x >= SCREEN_W) return -1;
+  if (y < cfg.y - HIT_PAD || y >= cfg.y + cfg.h) return -1;
+  int r = y < cfg.y ? 0 : (y - cfg.y) / pitch;
+  if (r >= ROWS) r = ROWS - 1;
+  uint8_t k = cur().grid[r][x / CELL];
+  return k == NO_KEY ? -1 : k;
 }
 
-enum KeyType : uint8_t { KT_CHAR, KT_SPACE, KT_DEL, KT_MODE, KT_CAPS, KT_CLR };
+bool Keyboard::contains(int x, int y) const {
+  return shown && (hitTest(x, y) >= 0 ||
+                   (x >= cfg.x && x < cfg.x + cfg.w && y >= cfg.y && y < cfg.y + cfg.h));
+}
 
-struct KeyRect {
-  int x,y,w,h;
-  KeyType type;
-  char ch;
-  const char *label;
-};
+// ============================================================
+// Drawing
+// ============================================================
+void Keyboard::drawKey(TFT_eSPI &g, int x,int y,int w,int h,const char*label, bool pressed) const {
+  uint16_t fill = pressed ? cfg.faceDown : cfg.face;
+
+  if (cfg.bevel) {
+    uint16_t top = pressed ? cfg.edgeDown : cfg.edge;
+    uint16_t bot = pressed ? cfg.edge     : cfg.edgeDown;
+    g.fillRect(x, y, w, h, fill);
+    g.drawFastHLine(x, y, w, top);
+    g.drawFastVLine(x, y, h, top);
+    g.drawFastHLine(x, y+h-1, w, bot);
+    g.drawFastVLine(x+w-1, y, h, bot);
+  } else {
+    g.fillRoundRect(x,y,w,h,3, fill);
+    g.drawRoundRect(x,y,w,h,3, pressed ? cfg.edgeDown : cfg.edge);
+  }
+
+  g.setTextColor(cfg.text, fill);
+  g.setTextDatum(MC_DATUM);
+  g.drawString(label, x + w/2, y + h/2, 2);
+  g.setTextDatum(TL_DATUM);
+}
 
-static KeyRect keys[64];
-static int keyCount = 0;
+const char* Keyboard::keyLabel(const KeyRect &k, char *tmp) const {
+  if (k.type == KT_CAPS) return caps ? "CAPS*" : "CAPS";
+  if (k.type != KT_CHAR) return k.label;
 
-static void addKey(int x,int y,int w,int h, KeyType type, const char *label, char ch = 0) {
-  if (keyCount >= (int)(sizeof(keys)/sizeof(keys[0]))) return;
-  keys[keyCount++] = {x,y,w,h,type,ch,label};
+  char c = k.ch;
+  if (page == PAGE_ABC && isalpha((unsigned char)c)) c = caps ? toupper((unsigned char)c) : tolower((unsigned char)c);
+  tmp[0] = c;
+  tmp[1] = 0;
+  return tmp;
 }
 
-static void buildKeys() {
-  keyCount = 0;
+// ============================================================
+// Key images
+// ============================================================
+// Every key of the current variant (abc, ABC, 123, #+=) is rendered once, up
+// and down, and kept as runs over a 4-colour palette in row-major order. A
+// key is then one setWindow and a pushBlock per run, and the whole keyboard
+// one window over the band. There is one cache, for the keyboard on screen.
+// If the heap can't spare it, keys are drawn as before.
+struct KeyImage {
+  uint16_t pal[4];
+  uint16_t off;    // into imageRuns
+  uint16_t len;
+};
 
-  const int KH = keyH();
-  const int SH = spaceH();
+static const int IMG_MAX_KEYS = 40;
+static const int RUN_MAX = 64;   // run byte: palette index << 6 | (count - 1)
 
-  const int topY = kbTopY();
-  const int y0 = topY;
-  const int y1 = topY + (KH + GAP);
-  const int y2 = topY + 2*(KH + GAP);
-  const int y3 = topY + 3*(KH + GAP);
+static KeyImage images[IMG_MAX_KEYS][2];   // [key][pressed]
+static uint8_t* imageRuns  = nullptr;
+static uint32_t imageBytes = 0;
+static const Keyboard* imageOwner = nullptr;
+static int8_t   imageVariant = -1;
+static uint32_t imageBuildUs = 0;
 
-  const int rightX = SCREEN_W - PAD_R;
-  const int xMode = rightX - FN_W;
-  const int xClr  = xMode - GAP - FN_W;
-  const int xDel  = xMode;
+int Keyboard::variant() const {
+  return page == PAGE_ABC ? (caps ? 1 : 0) : page + 1;
+}
 
-  const int row1X = PAD_L;
-  const int row2X = PAD_L + 10;
-
-  if (!mode123) {
-    const char *r1 = "QWERTYUIOP";
-    const char *r2 = "ASDFGHJKL";
-    const char *r3 = "ZXCVBNM";
-
-    {
-      int n = 10;
-      int avail = (SCREEN_W - PAD_L - PAD_R) - (n-1)*GAP;
-      int w = avail / n;
-      int x = row1X;
-      for (int i=0;i<n;i++){
-        addKey(x, y0, w, KH, KT_CHAR, nullptr, r1[i]);
-        x += w + GAP;
+// Packs the sprite into runs. With out == nullptr it only counts. -1 if the
+// key has more than four colours.
+static int encodeKey(TFT_eSprite &spr, int w, int h, uint16_t *pal, uint8_t *out) {
+  int npal = 0, n = 0, run = 0, idx = -1;
+
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      uint16_t c = spr.readPixel(x, y);
+      int p = 0;
+      while (p < npal && pal[p] != c) p++;
+      if (p == npal) {
+        if (npal == 4) return -1;
+        pal[npal++] = c;
       }
-    }
 
-    {
-      int n = 9;
-      int leftW = (xDel - GAP) - row2X;
-      int avail = leftW - (n-1)*GAP;
-      int w = avail / n;
-      int x = row2X;
-      for (int i=0;i<n;i++){
-        addKey(x, y1, w, KH, KT_CHAR, nullptr, r2[i]);
-        x += w + GAP;
-      }
-      addKey(xDel, y1, FN_W, KH, KT_DEL, "DEL");
+      if (p == idx && run < RUN_MAX) { run++; continue; }
+      if (run) { if (out) out[n] = (uint8_t)(idx << 6 | (run - 1)); n++; }
+      idx = p;
+      run = 1;
     }
+  }
+  if (run) { if (out) out[n] = (uint8_t)(idx << 6 | (run - 1)); n++; }
+  return n;
+}
 
-    {
-      addKey(row1X, y2, CAPS_W, KH, KT_CAPS, "CAPS");
+static void freeImages() {
+  free(imageRuns);
+  imageRuns = nullptr;
+  imageBytes = 0;
+  imageOwner = nullptr;
+  imageVariant = -1;
+}
 
-      int letterStart = row1X + CAPS_W + GAP;
-      int letterEnd   = xClr - GAP;
-      int avail = (letterEnd - letterStart) - (7-1)*GAP;
-      int w = avail / 7;
+// Two passes over the same renders: sizes first, then one allocation.
+bool Keyboard::buildImages() {
+  freeImages();
+  uint32_t t0 = micros();
+  const Layout &l = cur();
 
-      int x = letterStart;
-      for (int i=0;i<7;i++){
-        addKey(x, y2, w, KH, KT_CHAR, nullptr, r3[i]);
-        x += w + GAP;
+  int maxW = 0, maxH = 0;
+  for (int i = 0; i < l.count; i++) {
+    if (l.keys[i].w > maxW) maxW = l.keys[i].w;
+    if (l.keys[i].h > maxH) maxH = l.keys[i].h;
+  }
+
+  TFT_eSprite spr(tft);
+  spr.setColorDepth(16);
+  if (!spr.createSprite(maxW, maxH)) return false;
+
+  bool ok = true;
+  for (int pass = 0; pass < 2 && ok; pass++) {
+    uint32_t at = 0;
+    for (int i = 0; i < l.count && ok; i++) {
+      const KeyRect &k = l.keys[i];
+      char tmp[2];
+      for (int down = 0; down < 2; down++) {
+        spr.fillSprite(cfg.bg);
+        drawKey(spr, 0, 0, k.w, k.h, keyLabel(k, tmp), down);
+
+        KeyImage &im = images[i][down];
+        int n = encodeKey(spr, k.w, k.h, im.pal, pass ? imageRuns + at : nullptr);
+        if (n < 0 || at + n > 0xFFFF) { ok = false; break; }
+        im.off = (uint16_t)at;
+        im.len = (uint16_t)n;
+        at += n;
       }
+    }
 
-      addKey(xClr,  y2, FN_W, KH, KT_CLR,  "CLR");
-      addKey(xMode, y2, FN_W, KH, KT_MODE, "123");
+    if (ok && pass == 0) {
+      if (ESP.getFreeHeap() < APP_LOW_HEAP_BYTES + at) ok = false;
+      else ok = (imageRuns = (uint8_t*)malloc(at)) != nullptr;
+      imageBytes = at;
     }
+  }
+  spr.deleteSprite();
 
-    addKey(PAD_L, y3, SCREEN_W - PAD_L - PAD_R, SH, KT_SPACE, "SPACE");
+  if (!ok) {
+    freeImages();
+    return false;
   }
-  else {
-    const char *nums = "1234567890";
-    const char *r2[] = {"-","/",":",";","(",")","$","&","@"};
-    const char *r3[] = {".",",","?","!","'","\"","+","=","#"};
-
-    {
-      int n = 10;
-      int avail = (SCREEN_W - PAD_L - PAD_R) - (n-1)*GAP;
-      int w = avail / n;
-      int x = row1X;
-      for (int i=0;i<n;i++){
-        addKey(x, y0, w, KH, KT_CHAR, nullptr, nums[i]);
-        x += w + GAP;
-      }
-    }
+  imageOwner = this;
+  imageVariant = (int8_t)variant();
+  imageBuildUs = micros() - t0;
+  return true;
+}
 
-    {
-      int n = 9;
-      int leftW = (xDel - GAP) - row2X;
-      int avail = leftW - (n-1)*GAP;
-      int w = avail / n;
-      int x = row2X;
-      for (int i=0;i<n;i++){
-        addKey(x, y1, w, KH, KT_CHAR, r2[i], r2[i][0]);
-        x += w + GAP;
-      }
-      addKey(xDel, y1, FN_W, KH, KT_DEL, "DEL");
-    }
+bool Keyboard::imagesReady() {
+  return (imageOwner == this && imageVariant == variant()) || buildImages();
+}
 
-    {
-      int letterStart = row1X;
-      int letterEnd   = xClr - GAP;
-      int avail = (letterEnd - letterStart) - (7-1)*GAP;
-      int w = avail / 7;
+// Streams n pixels of a key image from where the last call stopped.
+struct RunReader {
+  const uint8_t  *p;
+  const uint16_t *pal;
+  int             left;   // pixels left in the run at p[-1]
+  uint16_t        color;
+};
 
-      int x = letterStart;
-      for (int i=0;i<7;i++){
-        addKey(x, y2, w, KH, KT_CHAR, r3[i], r3[i][0]);
-        x += w + GAP;
-      }
+static void startReader(RunReader &rd, int i, bool down) {
+  const KeyImage &im = images[i][down];
+  rd.p = imageRuns + im.off;
+  rd.pal = im.pal;
+  rd.left = 0;
+}
 
-      addKey(xClr,  y2, FN_W, KH, KT_CLR,  "CLR");
-      addKey(xMode, y2, FN_W, KH, KT_MODE, "ABC");
+static void pull(TFT_eSPI &g, RunReader &rd, int n) {
+  while (n > 0) {
+    if (!rd.left) {
+      uint8_t b = *rd.p++;
+      rd.color = rd.pal[b >> 6];
+      rd.left = (b & (RUN_MAX - 1)) + 1;
     }
-
-    addKey(PAD_L, y3, SCREEN_W - PAD_L - PAD_R, SH, KT_SPACE, "SPACE");
+    int k = rd.left < n ? rd.left : n;
+    g.pushBlock(rd.color, k);
+    rd.left -= k;
+    n -= k;
   }
 }
 
-static void drawOneKey(int i, bool pressed) {
-  const KeyRect &k = keys[i];
+void Keyboard::blitKey(int i, bool down) {
+  const KeyRect &k = cur().keys[i];
+  RunReader rd;
+  startReader(rd, i, down);
 
-  if (k.type == KT_CHAR) {
-    if (k.label) {
-      drawKey(k.x,k.y,k.w,k.h,k.label, pressed);
-    } else {
-      char tmp[2] = {0,0};
-      char c = k.ch;
-      if (!mode123 && isalpha((unsigned char)c)) c = caps ? toupper((unsigned char)c) : tolower((unsigned char)c);
-      tmp[0] = c;
-      drawKey(k.x,k.y,k.w,k.h,tmp, pressed);
+  tft->startWrite();
+  tft->setWindow(k.x, k.y, k.x + k.w - 1, k.y + k.h - 1);
+  pull(*tft, rd, k.w * k.h);
+  tft->endWrite();
+}
+
+// The whole band as one window, row by row, each key's reader picking up
+// where its previous row ended.
+void Keyboard::blitBand() {
+  const Layout &l = cur();
+  RunReader rd[MAX_KEYS];
+  for (int i = 0; i < l.count; i++) startReader(rd[i], i, i == activeIdx);
+
+  const int x0 = cfg.x, x1 = cfg.x + cfg.w;
+  tft->startWrite();
+  tft->setWindow(x0, cfg.y, x1 - 1, cfg.y + cfg.h - 1);
+  for (int y = cfg.y; y < cfg.y + cfg.h; y++) {
+    int x = x0;
+    for (int i = 0; i < l.count; i++) {
+      const KeyRect &k = l.keys[i];
+      if (y < k.y || y >= k.y + k.h) continue;
+      if (k.x > x) tft->pushBlock(cfg.bg, k.x - x);
+      pull(*tft, rd[i], k.w);
+      x = k.x + k.w;
     }
-    return;
+    if (x < x1) tft->pushBlock(cfg.bg, x1 - x);
   }
+  tft->endWrite();
+}
 
-  if (k.type == KT_CAPS) {
-    drawKey(k.x,k.y,k.w,k.h, caps ? "CAPS*" : "CAPS", pressed);
+void Keyboard::drawOneKey(int i, bool pressed) {
+  if (imagesReady()) {
+    blitKey(i, pressed);
     return;
   }
 
-  drawKey(k.x,k.y,k.w,k.h,k.label, pressed);
+  const KeyRect &k = cur().keys[i];
+  char tmp[2];
+  drawKey(*tft, k.x,k.y,k.w,k.h, keyLabel(k, tmp), pressed);
 }
 
-static int hitTest(int x, int y) {
-  buildKeys();
-  for (int i=0;i<keyCount;i++){
-    if (insidePad(x,y, keys[i].x, keys[i].y, keys[i].w, keys[i].h, HIT_PAD)) return i;
+// Keys whose pressed look changed; painted together in the next frame.
+void Keyboard::drawDirty() {
+  if (!shown || !tft || !dirtyKeys) return;
+  for (int i = 0; i < cur().count; i++) {
+    if (dirtyKeys & (1ULL << i)) drawOneKey(i, i == activeIdx);
+  }
+  dirtyKeys = 0;
+}
+
+void Keyboard::markKey(int i) {
+  if (i < 0 || onScreen != this) return;
+  dirtyKeys |= 1ULL << i;
+  frame_request(drawOnScreenDirty);
+}
+
+void Keyboard::draw() {
+  if (!shown || !tft) return;
+  onScreen = this;
+  dirtyKeys = 0;
+
+  if (imagesReady()) {
+    blitBand();
+    return;
+  }
+
+  tft->fillRect(cfg.x, cfg.y, cfg.w, cfg.h, cfg.bg);
+  for (int i=0;i<cur().count;i++){
+    drawOneKey(i, (i == activeIdx));
   }
-  return -1;
 }
 
-static KB_Action commitKey(const KeyRect &k) {
+// ============================================================
+// Input
+// ============================================================
+// DEL and the arrows; these repeat.
+KB_Action Keyboard::editKey(KeyType t) {
+  bool changed = false;
+  if (t == KT_DEL)   changed = edit->backspace();
+  if (t == KT_LEFT)  changed = edit->left();
+  if (t == KT_RIGHT) changed = edit->right();
+  return changed ? KB_CHANGED : KB_NONE;
+}
+
+KB_Action Keyboard::commitKey(const KeyRect &k) {
   switch (k.type) {
-    case KT_SPACE: addChar(' '); return KB_CHANGED;
+    case KT_SPACE: return edit->insert(' ') ? KB_CHANGED : KB_NONE;
     case KT_DEL:
-      backspaceOnce();
-      delHeld = true; delStart = millis(); delLast = delStart;
-      return KB_CHANGED;
-    case KT_CLR: keyboard_clear(); return KB_CHANGED;
-    case KT_MODE: mode123 = !mode123; return KB_REDRAW;
+    case KT_LEFT:
+    case KT_RIGHT:
+      repeatIdx = activeIdx; repeatStart = millis(); repeatLast = repeatStart;
+      return editKey(k.type);
+    case KT_CLR: edit->clear(); return KB_CHANGED;
+    case KT_MODE: page = page == PAGE_ABC ? PAGE_123 : PAGE_ABC; return KB_REDRAW;
+    case KT_SYM:  page = page == PAGE_123 ? PAGE_SYM : PAGE_123; return KB_REDRAW;
     case KT_CAPS:
       caps = !caps;
       capsHeld = true; capsDownAt = millis(); capsDidClear = false;
       return KB_REDRAW;
+    case KT_OK: return KB_ENTER;
     case KT_CHAR: {
       char c = k.ch;
-      if (!mode123 && isalpha((unsigned char)c)) c = caps ? toupper((unsigned char)c) : tolower((unsigned char)c);
-      addChar(c);
-      return KB_CHANGED;
+      if (page == PAGE_ABC && isalpha((unsigned char)c)) c = caps ? toupper((unsigned char)c) : tolower((unsigned char)c);
+      return edit->insert(c) ? KB_CHANGED : KB_NONE;
     }
   }
   return KB_NONE;
 }
 
-static KB_Action handleHoldAt(bool pressedNow, int x, int y) {
-  if (!pressedNow) {
-    delHeld = false;
-    capsHeld = false;
-    capsDidClear = false;
-    return KB_NONE;
-  }
-
+// A held CAPS clears the text once; a held DEL or arrow repeats while the
+// finger stays on it.
+KB_Action Keyboard::handleHold(int x, int y) {
   uint32_t now = millis();
 
-  if (!mode123 && capsHeld && !capsDidClear) {
-    buildKeys();
-    for (int i=0;i<keyCount;i++){
-      if (keys[i].type == KT_CAPS) {
-        if (insidePad(x,y, keys[i].x, keys[i].y, keys[i].w, keys[i].h, HIT_PAD)) {
-          if (now - capsDownAt >= CAPS_CLEAR_HOLD) {
-            keyboard_clear();
-            capsDidClear = true;
-            return KB_CHANGED;
-          }
-        }
-        break;
-      }
+  if (page == PAGE_ABC && capsHeld && !capsDidClear && hitTest(x, y) == cur().capsIdx) {
+    if (now - capsDownAt >= CAPS_CLEAR_HOLD) {
+      edit->clear();
+      capsDidClear = true;
+      return KB_CHANGED;
     }
   }
 
-  if (delHeld) {
-    buildKeys();
-    for (int i=0;i<keyCount;i++){
-      if (keys[i].type == KT_DEL) {
-        if (!insidePad(x,y, keys[i].x, keys[i].y, keys[i].w, keys[i].h, HIT_PAD)) return KB_NONE;
-
-        if ((now - delStart) > DEL_DELAY && (now - delLast) > DEL_REPEAT) {
-          delLast = now;
-          backspaceOnce();
-          return KB_CHANGED;
-        }
-        return KB_NONE;
-      }
+  if (repeatIdx >= 0) {
+    if (hitTest(x, y) != repeatIdx) return KB_NONE;
+
+    if ((now - repeatStart) > REPEAT_DELAY && (now - repeatLast) > REPEAT_EVERY) {
+      repeatLast = now;
+      return editKey(cur().keys[repeatIdx].type);
     }
   }
 
   return KB_NONE;
 }
 
-void keyboard_init(TFT_eSPI *display) {
+void Keyboard::begin(TFT_eSPI *display, const KeyboardCfg &c, TextEdit *e) {
   tft = display;
-  keyboard_clear();
+  cfg = c;
+  edit = e;
+  buildLayouts();
 }
 
-void keyboard_set_visible(bool v){ visible = v; }
-bool keyboard_is_visible(){ return visible; }
-
-void keyboard_clear() {
-  cursor = 0;
-  text[0] = 0;
+void Keyboard::setVisible(bool v) {
+  shown = v;
+  if (v) return;
+  if (onScreen == this) onScreen = nullptr;
+  if (imageOwner == this) freeImages();   // rebuilt on the next draw
 }
 
-const char* keyboard_get_text(){ return text; }
-
-void keyboard_release() {
+void Keyboard::release() {
   keyDown = false;
-  delHeld = false;
+  repeatIdx = -1;
   capsHeld = false;
   capsDidClear = false;
 
-  if (activeIdx >= 0 && tft) {
-    buildKeys();
-    drawOneKey(activeIdx, false);
-  }
+  int was = activeIdx;
   activeIdx = -1;
-  stablePressed = false;
+  if (tft) markKey(was);
 }
 
-void keyboard_draw() {
-  if (!visible || !tft) return;
-
-  buildKeys();
-
-  int topY = kbTopY();
-  tft->fillRect(0, topY, SCREEN_W, SCREEN_H - topY, TFT_WHITE);
+KB_Action Keyboard::update(bool pressed, int x, int y) {
+  if (!shown || !tft) return KB_NONE;
 
-  for (int i=0;i<keyCount;i++){
-    drawOneKey(i, (i == activeIdx));
+  if (!pressed) {
+    if (keyDown || activeIdx >= 0) release();
+    return KB_NONE;
   }
-}
 
-KB_Action keyboard_update(bool pressed, int x, int y) {
-  if (!visible || !tft) return KB_NONE;
+  int idx = hitTest(x, y);
+  if (idx != activeIdx) {
+    markKey(activeIdx);
+    activeIdx = idx;
+    markKey(activeIdx);
+  }
 
-  uint32_t now = millis();
+  if (activeIdx >= 0 && !keyDown) {
+    keyDown = true;
+    KB_Action a = commitKey(cur().keys[activeIdx]);
+    if (a == KB_REDRAW && onScreen == this) frame_request(drawOnScreen);
+    return a;
+  }
 
-  if (pressed) {
-    lastTouchSeenMs = now;
+  return handleHold(x, y);
+}
 
-    if (!stablePressed) {
-      stablePressed = true;
-      keyDown = false;
-    }
+// ============================================================
+// Bench
+// ============================================================
+void Keyboard::bench(Print &out) {
+  const int RUNS = 20000;
+
+  uint32_t t0 = micros();
+  buildLayouts();
+  uint32_t buildUs = micros() - t0;
+
+  // a sweep over the keyboard band and a little above it
+  volatile int sink = 0;
+  t0 = micros();
+  for (int i = 0; i < RUNS; i++) {
+    int x = cfg.x + (i * 37) % cfg.w;
+    int y = cfg.y - HIT_PAD + (i * 13) % (cfg.h + HIT_PAD);
+    sink += hitTest(x, y);
+  }
+  uint32_t hitNs = (uint32_t)((uint64_t)(micros() - t0) * 1000 / RUNS);
 
-    int idx = hitTest(x, y);
+  out.printf("keyboard: all pages + hit grids built in %lu us (%u bytes)\n",
+             (unsigned long)buildUs, (unsigned)sizeof(pages));
+  out.printf("          hit test %lu ns per touch sample\n", (unsigned long)hitNs);
 
-    if (idx != activeIdx) {
-      if (activeIdx >= 0) { buildKeys(); drawOneKey(activeIdx, false); }
-      activeIdx = idx;
-      if (activeIdx >= 0) { buildKeys(); drawOneKey(activeIdx, true); }
-    }
+  if (!shown || !tft) return;
 
-    if (activeIdx >= 0 && !keyDown) {
-      keyDown = true;
-      buildKeys();
-      KB_Action a = commitKey(keys[activeIdx]);
-      if (a == KB_REDRAW) keyboard_draw();
-      return a;
-    }
+  // one key both ways, then the whole band; the keyboard is redrawn after
+  const KeyRect &k = cur().keys[0];
+  char tmp[2];
+  t0 = micros();
+  drawKey(*tft, k.x, k.y, k.w, k.h, keyLabel(k, tmp), true);
+  uint32_t primUs = micros() - t0;
 
-    return handleHoldAt(true, x, y);
+  if (!imagesReady()) {
+    out.printf("          key draw %lu us; no key images (heap)\n", (unsigned long)primUs);
+    draw();
+    return;
   }
+  t0 = micros();
+  blitKey(0, true);
+  uint32_t blitUs = micros() - t0;
+
+  t0 = micros();
+  blitBand();
+  uint32_t bandUs = micros() - t0;
+
+  out.printf("          key images %lu bytes, built in %lu us\n",
+             (unsigned long)imageBytes, (unsigned long)imageBuildUs);
+  out.printf("          key press %lu us drawn, %lu us blitted; full keyboard %lu us\n",
+             (unsigned long)primUs, (unsigned long)blitUs, (unsigned long)bandUs);
+  draw();
+}
 
-  if (stablePressed && (now - lastTouchSeenMs) > RELEASE_DEBOUNCE_MS) {
-    stablePressed = false;
-    keyDown = false;
-    delHeld = false;
-    capsHeld = false;
-    capsDidClear = false;
-
-    if (activeIdx >= 0) {
-      buildKeys();
-      drawOneKey(activeIdx, false);
-      activeIdx = -1;
-    }
+void keyboard_bench(Print &out) {
+  if (!onScreen) {
+    out.println("keyboard: none on screen; open the chat or a Wi-Fi password first");
+    return;
   }
-
-  return KB_NONE;
+  onScreen->bench(out);
 }
-
-KB_Action keyboard_touch(int x, int y) { return keyboard_update(true, x, y); }
-KB_Action keyboard_tick(bool pressed, int x, int y) { return keyboard_update(pressed, x, y); }
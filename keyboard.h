@@ -1,8 +1,14 @@
 #pragma once
 #include <TFT_eSPI.h>
+#include "text_edit.h"
 
+// On-screen keyboard widget. Each app owns a Keyboard, places it with a
+// KeyboardCfg and hands it the TextEdit to type into. Pages: abc/ABC, 123
+// and #+=. Only one keyboard is on screen at a time: the last one drawn.
+
+// Chat input length; a sent line becomes one chat row.
 #ifndef KB_TEXT_MAX
-#define KB_TEXT_MAX 60
+#define KB_TEXT_MAX 300
 #endif
 
 #ifndef KB_Y
@@ -11,23 +17,118 @@
 
 typedef enum {
   KB_NONE = 0,
-  KB_CHANGED,
-  KB_REDRAW,
-  KB_HIDE
+  KB_CHANGED,   // the text or the cursor changed
+  KB_REDRAW,    // page or caps changed; the keyboard redraws itself
+  KB_ENTER      // OK key
 } KB_Action;
 
-void keyboard_init(TFT_eSPI *display);
-KB_Action keyboard_update(bool pressed, int x, int y);
+struct KeyboardCfg {
+  int16_t x, y, w, h;   // band, filled with bg
+  uint8_t pad;          // left/right inset of the keys
+  uint8_t gap;          // between keys and rows
+  bool    okKey;        // split an OK key off the space bar
+  bool    bevel;        // raised 3D keys instead of rounded ones
+
+  uint16_t bg, face, faceDown, text;
+  // rounded: border up/down; bevel: light and dark edge, swapped when down
+  uint16_t edge, edgeDown;
+};
+
+// The chat look: grey rounded keys on white, full width below KB_Y.
+KeyboardCfg keyboard_defaultCfg();
+
+enum KeyType : uint8_t { KT_CHAR, KT_SPACE, KT_DEL, KT_MODE, KT_CAPS, KT_CLR, KT_SYM, KT_OK, KT_LEFT, KT_RIGHT };
+
+struct KeyRect {
+  int16_t x,y,w,h;
+  KeyType type;
+  char ch;
+  const char *label;
+};
+
+class Keyboard {
+public:
+  // Lays out all pages. Keys edit *edit at its cursor.
+  void begin(TFT_eSPI *display, const KeyboardCfg &cfg, TextEdit *edit);
+
+  void setVisible(bool v);
+  bool visible() const { return shown; }
+
+  void draw();
+
+  // Feed every touch sample while the keyboard is up; a press commits on
+  // the first sample, DEL and the arrows repeat while held.
+  KB_Action update(bool pressed, int x, int y);
+  void release();
+
+  // Inside the band, or close enough to a key to hit it.
+  bool contains(int x, int y) const;
+
+  // KB_BENCH: layout build time, per-sample hit-test cost and draw times.
+  void bench(Print &out);
+
+  // Internal, for the frame scheduler.
+  void drawDirty();
+
+private:
+  static const int ROWS     = 4;
+  static const int MAX_KEYS = 40;
+  static const int CELL     = 2;
+  static const int GRID_W   = 320 / CELL;
+
+  // Hits go through a grid: the row comes from y, then one byte per CELL px
+  // of that row names the key.
+  struct Layout {
+    KeyRect keys[MAX_KEYS];
+    int     count;
+    int8_t  capsIdx;
+    uint8_t grid[ROWS][GRID_W];
+  };
+
+  enum Page : uint8_t { PAGE_ABC, PAGE_123, PAGE_SYM, PAGES };
+
+  TFT_eSPI   *tft = nullptr;
+  KeyboardCfg cfg;
+  TextEdit   *edit = nullptr;
+
+  Layout   pages[PAGES];
+  uint8_t  page = PAGE_ABC;
+  int      pitch = 0;   // row height + gap
+  bool     caps = false;
+  bool     shown = false;
+
+  bool     keyDown = false;
+  int      activeIdx = -1;
+  uint64_t dirtyKeys = 0;
+
+  int      repeatIdx = -1;   // key held down that repeats
+  uint32_t repeatStart = 0, repeatLast = 0;
+  bool     capsHeld = false, capsDidClear = false;
+  uint32_t capsDownAt = 0;
+
+  const Layout& cur() const { return pages[page]; }
+  int  variant() const;
+
+  KB_Action editKey(KeyType t);
 
-void keyboard_set_visible(bool v);
-bool keyboard_is_visible();
+  void buildKeys(Layout &l, Page p);
+  void buildGrid(Layout &l);
+  void buildLayouts();
+  int  hitTest(int x, int y) const;
 
-void keyboard_clear();
-const char* keyboard_get_text();
+  const char* keyLabel(const KeyRect &k, char *tmp) const;
+  void drawKey(TFT_eSPI &g, int x, int y, int w, int h, const char *label, bool pressed) const;
+  void drawOneKey(int i, bool pressed);
+  void markKey(int i);
 
-void keyboard_draw();
+  bool buildImages();
+  bool imagesReady();
+  void blitKey(int i, bool down);
+  void blitBand();
 
-KB_Action keyboard_touch(int x, int y);
+  KB_Action commitKey(const KeyRect &k);
+  KB_Action handleHold(int x, int y);
+};
 
-void keyboard_release();
-KB_Action keyboard_tick(bool pressed, int x, int y);
+// KB_BENCH runs Keyboard::bench on the keyboard on screen.
+void keyboard_bench(Print &out);
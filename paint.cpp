@@ -1,5 +1,7 @@
 #include "paint.h"
+#include "frame.h"
 #include <Arduino.h>
+#include <LittleFS.h>
 
 static TFT_eSPI* tft = nullptr;
 
@@ -46,7 +48,16 @@ static const int PAL_SH = 14;
 static const int PAL_GAP = 2;
 static const int PAL_COLS = 8;
 
-static uint16_t canvas[GW * GH];
+// Allocated while Paint is open. On close the picture is packed into runs
+// (a blank or simple drawing is a few hundred bytes), and under memory
+// pressure the runs move to flash.
+static uint16_t* canvas = nullptr;
+
+struct Run { uint16_t len, color; };
+static Run* packed     = nullptr;
+static int  packedRuns = 0;
+static bool packedOnFlash = false;
+static const char* PACKED_PATH = "/paint.rle";
 static uint16_t color = TFT_BLACK;
 static int selectedColorIdx = 0;
 
@@ -187,6 +198,7 @@ static void ensureSnapshot() {
 }
 
 static void takeSnapshot() {
+  ensureSnapshot();
   if (!snapOk) return;
   memcpy(snap, canvas, sizeof(uint16_t) * GW * GH);
 
@@ -266,7 +278,22 @@ static void ensureFloodFill() {
   ffOk = (ffX && ffY);
 }
 
+static void freeFloodFill() {
+  free(ffX); ffX = nullptr;
+  free(ffY); ffY = nullptr;
+  ffOk = false;
+}
+
+// The stacks are as big as the canvas twice over; hold them only while filling.
+static void floodFillRun(int sx, int sy, uint16_t newC);
+
 static void floodFill(int sx, int sy, uint16_t newC) {
+  ensureFloodFill();
+  floodFillRun(sx, sy, newC);
+  freeFloodFill();
+}
+
+static void floodFillRun(int sx, int sy, uint16_t newC) {
   if (!ffOk) return;
   if (!inGrid(sx,sy)) return;
 
@@ -613,17 +640,111 @@ static void commitSelectionToCanvas() {
 
 void paint_init(TFT_eSPI* display) {
   tft = display;
-  clearCanvas();
   selectedColorIdx = 0;
   color = palette[selectedColorIdx];
+}
 
-  ensureSnapshot();
-  ensureFloodFill();
+// ============================================================
+// Canvas storage while closed
+// ============================================================
+static void dropPacked() {
+  free(packed);
+  packed = nullptr;
+  packedRuns = 0;
+  if (packedOnFlash) LittleFS.remove(PACKED_PATH);
+  packedOnFlash = false;
+}
+
+static int countRuns() {
+  int runs = 1;
+  for (int i = 1; i < GW * GH; i++) if (canvas[i] != canvas[i - 1]) runs++;
+  return runs;
+}
+
+// Packs the canvas into runs and frees it. Keeps it as is if that wouldn't save anything.
+static void packCanvas() {
+  if (!canvas) return;
+  int runs = countRuns();
+  if ((size_t)runs * sizeof(Run) >= sizeof(uint16_t) * GW * GH) return;
+
+  dropPacked();
+  packed = (Run*)malloc(runs * sizeof(Run));
+  if (!packed) return;
+
+  int n = 0;
+  packed[0].len = 1; packed[0].color = canvas[0];
+  for (int i = 1; i < GW * GH; i++) {
+    if (canvas[i] == packed[n].color) packed[n].len++;
+    else { n++; packed[n].len = 1; packed[n].color = canvas[i]; }
+  }
+  packedRuns = runs;
+
+  free(canvas);
+  canvas = nullptr;
+}
+
+static void unpackCanvas() {
+  if (packedOnFlash) {
+    File f = LittleFS.open(PACKED_PATH, "r");
+    size_t bytes = f ? f.size() : 0;
+    packed = bytes ? (Run*)malloc(bytes) : nullptr;
+    if (packed && f.read((uint8_t*)packed, bytes) == bytes) packedRuns = bytes / sizeof(Run);
+    else { free(packed); packed = nullptr; packedRuns = 0; }
+    if (f) f.close();
+  }
 
+  int i = 0;
+  for (int r = 0; r < packedRuns; r++) {
+    for (int k = 0; k < packed[r].len && i < GW * GH; k++) canvas[i++] = packed[r].color;
+  }
+  dropPacked();
+}
+
+static bool openCanvas() {
+  if (canvas) return true;
+  canvas = (uint16_t*)malloc(sizeof(uint16_t) * GW * GH);
+  if (!canvas) return false;
+  clearCanvas();
+  unpackCanvas();
+  return true;
+}
+
+static void paintClose() {
+  penDown = false;
+  startedOnCanvas = false;
+  previewActive = false;
   freeSelection();
+  freeFloodFill();
+  free(snap); snap = nullptr; snapOk = false;
+  packCanvas();
+}
+
+static void paintMemoryPressure() {
+  if (!packed || packedOnFlash) return;
+  if (!LittleFS.begin(false)) return;
+
+  File f = LittleFS.open(PACKED_PATH, "w");
+  if (!f) return;
+  size_t bytes = packedRuns * sizeof(Run);
+  bool ok = f.write((const uint8_t*)packed, bytes) == bytes;
+  f.close();
+  if (!ok) { LittleFS.remove(PACKED_PATH); return; }
+
+  free(packed);
+  packed = nullptr;
+  packedOnFlash = true;
 }
 
 void paint_draw() {
+  frame_clear();
+  if (!openCanvas()) {
+    tft->fillScreen(xp_gray);
+    drawTitle();
+    tft->setTextColor(TFT_BLACK, xp_gray);
+    tft->drawCentreString("Not enough memory for the canvas", SCREEN_W / 2, SCREEN_H / 2, 2);
+    return;
+  }
+
   tft->fillScreen(xp_gray);
 
   drawTitle();
@@ -638,7 +759,7 @@ void paint_draw() {
 
 void paint_release() {
 
-  if (!tft) return;
+  if (!tft || !canvas) return;
 
   if (!penDown) return;
 
@@ -686,6 +807,7 @@ bool paint_handleTouch(int x, int y) {
   if (!tft) return false;
 
   if (x > SCREEN_W - 16 && y < TITLE_H) return false;
+  if (!canvas) return true;
 
   bool isDownEvent = (!penDown);
 
@@ -949,3 +1071,28 @@ static void finalizeSelectionFromDrag() {
 
   drawRectOutlineGrid(selX, selY, selX+selW-1, selY+selH-1, TFT_BLACK, 0);
 }
+
+// ============================================================
+// App hooks
+// ============================================================
+static bool paintTouch(bool pressed, bool lastPressed, int x, int y) {
+  if (!pressed) {
+    if (lastPressed) paint_release();
+    return true;
+  }
+
+  if (!lastPressed && x >= SCREEN_W - 16 - 6 && x < SCREEN_W - 6 && y >= 2 && y < 16) return false;
+
+  return paint_handleTouch(x, y);
+}
+
+const App PAINT_APP = {
+  "paint",
+  paint_draw,
+  paintClose,
+  paintTouch,
+  nullptr,
+  nullptr,
+  paintMemoryPressure,
+  nullptr
+};
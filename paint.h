@@ -1,7 +1,10 @@
 #pragma once
 #include <TFT_eSPI.h>
+#include "app.h"
 
 void paint_init(TFT_eSPI* display);
 void paint_draw();
 void paint_release();
 bool paint_handleTouch(int x, int y);
+
+extern const App PAINT_APP;
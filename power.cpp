@@ -0,0 +1,292 @@
+#include "power.h"
+#include "app.h"
+#include "touch.h"
+#include "ai_client.h"
+#include "wifi_link.h"
+#include <WiFi.h>
+#include <Preferences.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <driver/uart.h>
+
+static const char* NVS_NS  = "cfg";
+static const char* NVS_KEY = "pwr";
+
+enum PowerState : uint8_t {
+  PWR_ACTIVE,
+  PWR_DIM,
+  PWR_OFF,     // backlight off, app suspended
+  PWR_SLEEP    // off, and light-sleeping between loops
+};
+
+struct PowerCfg {
+  uint16_t dimS;
+  uint16_t offS;
+  uint16_t sleepS;
+};
+
+static PowerCfg   cfg = { POWER_DIM_S, POWER_OFF_S, POWER_SLEEP_S };
+static PowerState state = PWR_ACTIVE;
+static uint32_t   lastActive = 0;
+static bool       swallow = false;   // the touch that woke us is not a tap
+static uint8_t    duty = 0;
+
+static bool     modemSleep = false;
+static uint32_t modemCheckAt = 0;
+static const uint32_t MODEM_CHECK_MS = 5000;
+
+// stats since the last log line
+static uint32_t statsSince = 0;
+static uint32_t lastTickUs = 0;
+static uint64_t spanUs = 0, yieldUs = 0, sleptUs = 0;
+static uint64_t chargeMaUs = 0;   // estimated mA x us
+static uint32_t wakes = 0, wakeLitMaxUs = 0, wakeDrawMaxMs = 0;
+
+static const char* names[] = { "active", "dim", "off", "light sleep" };
+
+// ============================================================
+// Backlight
+// ============================================================
+static void setBacklight(uint8_t d)
+{
+  duty = d;
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 3
+  ledcWrite(POWER_BL_PIN, d);
+#else
+  ledcWrite(POWER_BL_CHANNEL, d);
+#endif
+}
+
+// ============================================================
+// Stats
+// ============================================================
+static void account(uint32_t yielded, uint32_t slept)
+{
+  uint32_t now = micros();
+  uint32_t dt = now - lastTickUs;
+  lastTickUs = now;
+  if (yielded + slept > dt) dt = yielded + slept;
+
+  uint32_t busy  = dt - yielded - slept;
+  uint32_t awake = dt - slept;
+  uint32_t radio = modemSleep ? POWER_MA_RADIO_PS : POWER_MA_RADIO;
+
+  spanUs  += dt;
+  yieldUs += yielded;
+  sleptUs += slept;
+  chargeMaUs += (uint64_t)busy * POWER_MA_CPU + (uint64_t)yielded * POWER_MA_CPU_IDLE +
+                (uint64_t)slept * POWER_MA_LIGHT_SLEEP +
+                (uint64_t)awake * (radio + POWER_MA_BACKLIGHT * duty / 255);
+}
+
+static void printStats(const char* prefix)
+{
+  uint32_t idlePct  = spanUs ? (uint32_t)(100 * (yieldUs + sleptUs) / spanUs) : 0;
+  uint32_t sleepPct = spanUs ? (uint32_t)(100 * sleptUs / spanUs) : 0;
+  uint32_t mA       = spanUs ? (uint32_t)(chargeMaUs / spanUs) : 0;
+
+  Serial.printf("%slast %lu s: cpu idle %lu%%, light sleep %lu%%, ~%lu mA\n", prefix,
+                (unsigned long)((millis() - statsSince) / 1000), (unsigned long)idlePct,
+                (unsigned long)sleepPct, (unsigned long)mA);
+}
+
+static void resetStats()
+{
+  statsSince = millis();
+  spanUs = yieldUs = sleptUs = chargeMaUs = 0;
+}
+
+// ============================================================
+// States
+// ============================================================
+static void enter(PowerState s)
+{
+  if (s == state) return;
+  Serial.printf("power: %s -> %s, ", names[state], names[s]);
+  printStats("");
+  resetStats();
+
+  PowerState was = state;
+  state = s;
+  if (s == PWR_DIM) setBacklight(POWER_BL_DIM);
+  if (s >= PWR_OFF && was < PWR_OFF) {
+    setBacklight(0);
+    app_suspend();
+  }
+}
+
+// Light first, then let the app redraw over what the panel still shows.
+static void wake(const char* why)
+{
+  uint32_t t0 = micros();
+  PowerState was = state;
+  state = PWR_ACTIVE;
+  lastActive = millis();
+  setBacklight(POWER_BL_FULL);
+  uint32_t litUs = micros() - t0;
+
+  if (was >= PWR_OFF) app_resume();
+  uint32_t drawMs = (micros() - t0) / 1000;
+
+  wakes++;
+  if (litUs > wakeLitMaxUs) wakeLitMaxUs = litUs;
+  if (drawMs > wakeDrawMaxMs) wakeDrawMaxMs = drawMs;
+
+  Serial.printf("power: %s -> active by %s, lit in %lu us, redrawn in %lu ms, ", names[was], why,
+                (unsigned long)litUs, (unsigned long)drawMs);
+  printStats("");
+  resetStats();
+}
+
+// Manual light sleep stops the radio long enough for the AP to drop us, so
+// while associated the screen only goes off and modem sleep does the saving.
+static bool canSleep()
+{
+  return !ai_busy() && !wifi_link_busy() && WiFi.status() != WL_CONNECTED &&
+         digitalRead(TOUCH_INT) == HIGH;
+}
+
+static PowerState wanted(uint32_t idleMs)
+{
+  if (cfg.sleepS && idleMs >= cfg.sleepS * 1000UL && canSleep()) return PWR_SLEEP;
+  if (cfg.offS && idleMs >= cfg.offS * 1000UL) return PWR_OFF;
+  if (cfg.dimS && idleMs >= cfg.dimS * 1000UL) return PWR_DIM;
+  return PWR_ACTIVE;
+}
+
+// One slice; a touch or serial input ends it early. Returns the time slept.
+static uint32_t sleepSlice()
+{
+  if (!canSleep()) return 0;
+
+  Serial.flush();
+  esp_sleep_enable_timer_wakeup((uint64_t)POWER_SLEEP_SLICE_MS * 1000);
+  gpio_wakeup_enable((gpio_num_t)TOUCH_INT, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  uart_set_wakeup_threshold(UART_NUM_0, 3);   // the first characters are lost
+  esp_sleep_enable_uart_wakeup(0);
+
+  uint32_t t0 = micros();
+  esp_light_sleep_start();
+  uint32_t slept = micros() - t0;
+
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+    swallow = true;
+    wake("touch");
+  }
+  return slept;
+}
+
+// Modem sleep costs latency, so it's off only while a request is in flight.
+// Scans and connects turn it off too; it is put back every few seconds.
+static void checkModemSleep()
+{
+  bool want = !ai_busy();
+  if (want == modemSleep && millis() - modemCheckAt < MODEM_CHECK_MS) return;
+  modemCheckAt = millis();
+
+  if (WiFi.getMode() == WIFI_OFF) return;
+  if (want != modemSleep || WiFi.getSleep() != want) WiFi.setSleep(want);
+  modemSleep = want;
+}
+
+// ============================================================
+// Public
+// ============================================================
+void power_begin()
+{
+  Preferences p;
+  p.begin(NVS_NS, true);
+  PowerCfg c;
+  if (p.getBytes(NVS_KEY, &c, sizeof(c)) == sizeof(c)) cfg = c;
+  p.end();
+
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 3
+  ledcAttach(POWER_BL_PIN, 5000, 8);
+#else
+  ledcSetup(POWER_BL_CHANNEL, 5000, 8);
+  ledcAttachPin(POWER_BL_PIN, POWER_BL_CHANNEL);
+#endif
+  setBacklight(POWER_BL_FULL);
+
+  lastActive = millis();
+  lastTickUs = micros();
+  resetStats();
+}
+
+bool power_touch(bool pressed)
+{
+  if (swallow) {
+    if (!pressed) swallow = false;
+    return true;
+  }
+  if (!pressed) return false;
+
+  lastActive = millis();
+  if (state == PWR_ACTIVE) return false;
+
+  swallow = true;
+  wake("touch");
+  return true;
+}
+
+void power_tick()
+{
+  checkModemSleep();
+  if (ai_busy()) lastActive = millis();   // waiting on a reply counts as use
+
+  PowerState w = wanted(millis() - lastActive);
+  if (w > state) enter(w);
+  else if (state == PWR_SLEEP && w < PWR_SLEEP) enter(PWR_OFF);   // busy: stay dark, stay awake
+
+  // give the CPU back; touch is still polled often enough to feel instant
+  uint32_t yielded = 0, slept = 0;
+  uint32_t ms = 0;
+  switch (state) {
+    case PWR_ACTIVE: ms = millis() - lastActive > 1000 ? 2 : 0; break;
+    case PWR_DIM:    ms = 10; break;
+    case PWR_OFF:    ms = 40; break;
+    case PWR_SLEEP:  slept = sleepSlice(); ms = slept ? 0 : 40; break;
+  }
+  if (ms) {
+    uint32_t t0 = micros();
+    delay(ms);
+    yielded = micros() - t0;
+  }
+  account(yielded, slept);
+}
+
+bool power_awake() { return state < PWR_OFF; }
+
+bool power_handleSerial(const String& line)
+{
+  if (line == "POWER") {
+    Serial.printf("Power: %s, dim after %u s, off after %u s, light sleep after %u s (0 = never)\n",
+                  names[state], cfg.dimS, cfg.offS, cfg.sleepS);
+    Serial.printf("       backlight %u/255, modem sleep %s\n", duty, modemSleep ? "on" : "off");
+    Serial.printf("       %lu wakes, worst lit in %lu us, worst redraw %lu ms\n",
+                  (unsigned long)wakes, (unsigned long)wakeLitMaxUs, (unsigned long)wakeDrawMaxMs);
+    printStats("       ");
+    return true;
+  }
+
+  const String prefix = "POWER_IDLE ";
+  if (!line.startsWith(prefix)) return false;
+
+  int d = -1, o = -1, s = -1;
+  if (sscanf(line.c_str() + prefix.length(), "%d %d %d", &d, &o, &s) != 3 ||
+      d < 0 || o < 0 || s < 0 || d > 3600 || o > 3600 || s > 3600) {
+    Serial.println("Usage: POWER_IDLE <dim_s> <off_s> <sleep_s> (0 = never, 3600 max)");
+    return true;
+  }
+  cfg.dimS = (uint16_t)d;
+  cfg.offS = (uint16_t)o;
+  cfg.sleepS = (uint16_t)s;
+
+  Preferences p;
+  p.begin(NVS_NS, false);
+  p.putBytes(NVS_KEY, &cfg, sizeof(cfg));
+  p.end();
+  Serial.printf("Power: dim %u s, off %u s, light sleep %u s\n", cfg.dimS, cfg.offS, cfg.sleepS);
+  return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <Arduino.h>
+
+// Idle policy. With no touch (and no AI request in flight) the backlight
+// dims, then goes off and the foreground app is suspended, then, unless
+// Wi-Fi is connected, the chip light-sleeps in slices until TOUCH_INT goes
+// low. Wi-Fi modem sleep is on whenever no request is in flight. The panel keeps its picture while the
+// backlight is off, so a wake lights the last frame before the app redraws.
+
+#ifndef POWER_BL_PIN
+#define POWER_BL_PIN 27
+#endif
+
+#ifndef POWER_BL_CHANNEL
+#define POWER_BL_CHANNEL 0
+#endif
+
+// Backlight duty, 0..255.
+#ifndef POWER_BL_FULL
+#define POWER_BL_FULL 255
+#endif
+
+#ifndef POWER_BL_DIM
+#define POWER_BL_DIM 40
+#endif
+
+// Idle times (POWER_IDLE overrides, stored in NVS); 0 skips the step.
+#ifndef POWER_DIM_S
+#define POWER_DIM_S 30
+#endif
+
+#ifndef POWER_OFF_S
+#define POWER_OFF_S 60
+#endif
+
+#ifndef POWER_SLEEP_S
+#define POWER_SLEEP_S 120
+#endif
+
+// Light-sleep slice; the timer wake keeps serial and reconnects serviced.
+#ifndef POWER_SLEEP_SLICE_MS
+#define POWER_SLEEP_SLICE_MS 1000
+#endif
+
+// Rough supply current per part, for the idle estimate only.
+#ifndef POWER_MA_CPU
+#define POWER_MA_CPU 45       // running
+#endif
+
+#ifndef POWER_MA_CPU_IDLE
+#define POWER_MA_CPU_IDLE 20  // blocked in delay(), idle task running
+#endif
+
+#ifndef POWER_MA_RADIO
+#define POWER_MA_RADIO 90     // Wi-Fi on, no modem sleep
+#endif
+
+#ifndef POWER_MA_RADIO_PS
+#define POWER_MA_RADIO_PS 25  // average with modem sleep
+#endif
+
+#ifndef POWER_MA_BACKLIGHT
+#define POWER_MA_BACKLIGHT 60 // at full duty
+#endif
+
+#ifndef POWER_MA_LIGHT_SLEEP
+#define POWER_MA_LIGHT_SLEEP 3
+#endif
+
+// Sets up the backlight PWM at full brightness.
+void power_begin();
+
+// Call with every touch sample, before the app sees it. True while a touch
+// is being swallowed because it woke the screen.
+bool power_touch(bool pressed);
+
+// Call at the end of every loop(). Steps the idle policy and gives the CPU
+// back while nothing is going on.
+void power_tick();
+
+// Backlight on and the foreground app running.
+bool power_awake();
+
+// POWER prints the state and idle stats, POWER_IDLE <dim_s> <off_s> <sleep_s>
+// sets the timeouts. Returns false for other lines.
+bool power_handleSerial(const String& line);
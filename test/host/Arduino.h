@@ -0,0 +1,35 @@
+#pragma once
+// Just enough of the Arduino core to build the sketch's plain-logic files
+// with g++ on a PC.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+unsigned long millis();
+void delay(unsigned long ms);
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* b, size_t n)
+  {
+    size_t k = 0;
+    while (k < n && write(b[k])) k++;
+    return k;
+  }
+  virtual void flush() {}
+
+  size_t print(const char* s)  { return write((const uint8_t*)s, strlen(s)); }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+protected:
+  unsigned long _timeout = 1000;
+};
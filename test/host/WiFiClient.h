@@ -0,0 +1,8 @@
+#pragma once
+#include "Arduino.h"
+
+class Client : public Stream {
+public:
+  virtual uint8_t connected() = 0;
+  using Print::write;
+};
@@ -0,0 +1,15 @@
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+unsigned long millis()
+{
+  using namespace std::chrono;
+  static const steady_clock::time_point t0 = steady_clock::now();
+  return (unsigned long)duration_cast<milliseconds>(steady_clock::now() - t0).count();
+}
+
+void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
@@ -0,0 +1,174 @@
+// Host test for the streaming request writer (ai_http.cpp): escape-heavy and
+// very long strings must come out as JSON that decodes back to the input,
+// and HttpOut must send exactly the bytes it counted.
+#include "ai_http.h"
+#include <stdio.h>
+#include <string>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+class StringOut : public Print {
+public:
+  std::string s;
+  size_t write(uint8_t b) override { s += (char)b; return 1; }
+  size_t write(const uint8_t* b, size_t n) override { s.append((const char*)b, n); return n; }
+};
+
+// Stands in for the socket; records every write so buffer boundaries show.
+class FakeClient : public Client {
+public:
+  std::string sent;
+  int writes = 0;
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* b, size_t n) override { sent.append((const char*)b, n); writes++; return n; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  uint8_t connected() override { return 1; }
+};
+
+// Decodes one JSON string literal starting at s[i] == '"'. Returns false on
+// anything a strict parser would reject; i ends past the closing quote.
+static bool decodeString(const std::string& s, size_t& i, std::string& out)
+{
+  if (i >= s.size() || s[i] != '"') return false;
+  out.clear();
+  for (i++; i < s.size(); i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"') { i++; return true; }
+    if (c < 0x20) return false;
+    if (c != '\\') { out += (char)c; continue; }
+    if (++i >= s.size()) return false;
+    switch (s[i]) {
+      case '"':  out += '"'; break;
+      case '\\': out += '\\'; break;
+      case '/':  out += '/'; break;
+      case 'n':  out += '\n'; break;
+      case 'r':  out += '\r'; break;
+      case 't':  out += '\t'; break;
+      case 'b':  out += '\b'; break;
+      case 'f':  out += '\f'; break;
+      case 'u': {
+        if (i + 4 >= s.size()) return false;
+        unsigned v = (unsigned)strtoul(s.substr(i + 1, 4).c_str(), nullptr, 16);
+        if (v > 0x7F) return false;   // the writer only escapes control characters
+        out += (char)v;
+        i += 4;
+        break;
+      }
+      default: return false;
+    }
+  }
+  return false;
+}
+
+static std::string randomText(size_t n, unsigned& seed)
+{
+  static const char pool[] = "\"\\\n\r\t\x01\x1f\x7f/abc {}[]:,\xc3\xa9";
+  std::string s;
+  for (size_t k = 0; k < n; k++) {
+    seed = seed * 1103515245u + 12345u;
+    s += pool[(seed >> 16) % (sizeof(pool) - 1)];
+  }
+  return s;
+}
+
+static void testEscapes()
+{
+  StringOut o;
+  json_writeEscaped(o, "a\"b\\c\nd\re\tf\x01g\x1f");
+  CHECK(o.s == "a\\\"b\\\\c\\nd\\re\\tf\\u0001g\\u001f", "escaped as %s", o.s.c_str());
+
+  StringOut e;
+  json_writeEscaped(e, "");
+  CHECK(e.s.empty(), "empty input wrote %zu bytes", e.s.size());
+}
+
+static void testStructure()
+{
+  StringOut o;
+  JsonWriter j(o);
+  j.beginObject();
+  j.string("model", "m\"1");
+  j.boolean("stream", false);
+  j.beginArray("messages");
+  j.beginObject();
+  j.string("role", "user");
+  j.beginString("content");
+  j.text("line 1\n");
+  j.text("line 2");
+  j.endString();
+  j.endObject();
+  j.beginObject();
+  j.string("role", "assistant");
+  j.endObject();
+  j.endArray();
+  j.endObject();
+
+  const char* want = "{\"model\":\"m\\\"1\",\"stream\":false,\"messages\":["
+                     "{\"role\":\"user\",\"content\":\"line 1\\nline 2\"},"
+                     "{\"role\":\"assistant\"}]}";
+  CHECK(o.s == want, "got %s", o.s.c_str());
+}
+
+// Long, escape-heavy values survive a round trip, whatever their length.
+static void testRoundTrip()
+{
+  unsigned seed = 1;
+  const size_t lengths[] = { 1, 255, 256, 257, 4095, 70000 };
+  for (size_t n : lengths) {
+    std::string text = randomText(n, seed);
+
+    StringOut o;
+    JsonWriter j(o);
+    j.beginObject();
+    j.string("prompt", text.c_str());
+    j.endObject();
+
+    const std::string head = "{\"prompt\":";
+    CHECK(o.s.compare(0, head.size(), head) == 0, "n=%zu: bad head", n);
+    size_t i = head.size();
+    std::string back;
+    bool ok = decodeString(o.s, i, back);
+    CHECK(ok, "n=%zu: not a valid JSON string", n);
+    CHECK(ok && back == text, "n=%zu: decoded text differs", n);
+    CHECK(i + 1 == o.s.size() && o.s[i] == '}', "n=%zu: bad tail", n);
+  }
+}
+
+// The counting pass gives Content-Length; the real pass must match it byte
+// for byte, across the 256-byte buffer boundaries.
+static void testHttpOut()
+{
+  unsigned seed = 7;
+  std::string text = randomText(10000, seed);
+
+  HttpOut counter(nullptr);
+  JsonWriter(counter).string(nullptr, text.c_str());
+
+  FakeClient client;
+  HttpOut out(&client);
+  JsonWriter(out).string(nullptr, text.c_str());
+  out.flush();
+
+  CHECK(!out.failed(), "send reported a failure");
+  CHECK(counter.count() == out.count(), "counted %zu, wrote %zu", counter.count(), out.count());
+  CHECK(client.sent.size() == counter.count(), "client got %zu of %zu", client.sent.size(), counter.count());
+  CHECK(client.writes <= (int)(counter.count() / 256) + 1, "%d socket writes", client.writes);
+
+  StringOut ref;
+  JsonWriter(ref).string(nullptr, text.c_str());
+  CHECK(client.sent == ref.s, "socket bytes differ from the direct write");
+}
+
+int main()
+{
+  testEscapes();
+  testStructure();
+  testRoundTrip();
+  testHttpOut();
+  printf("json_writer_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
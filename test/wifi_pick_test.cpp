@@ -0,0 +1,122 @@
+// Host test for network ranking and roaming (wifi_pick.cpp), fed synthetic
+// scan tables instead of a radio.
+#include "wifi_pick.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static WifiProfile prof(const char* ssid, uint8_t priority, uint16_t ok = 0, uint16_t fail = 0)
+{
+  WifiProfile p;
+  memset(&p, 0, sizeof(p));
+  strncpy(p.ssid, ssid, sizeof(p.ssid) - 1);
+  p.priority = priority;
+  p.okCount = ok;
+  p.failCount = fail;
+  return p;
+}
+
+static WifiSeen seen(const char* ssid, int8_t rssi)
+{
+  WifiSeen s;
+  memset(&s, 0, sizeof(s));
+  strncpy(s.ssid, ssid, sizeof(s.ssid) - 1);
+  s.rssi = rssi;
+  return s;
+}
+
+// Ranks p[] against the scan and compares with the expected order.
+static bool ranksAs(const WifiProfile* p, int np, const WifiSeen* s, int ns, const int* want)
+{
+  int order[WIFI_LINK_MAX_PROFILES];
+  int n = wifi_rank(p, np, s, ns, order);
+  if (n != np) return false;
+  for (int i = 0; i < n; i++) {
+    if (order[i] != want[i]) {
+      printf("  order:");
+      for (int k = 0; k < n; k++) printf(" %d", order[k]);
+      printf("\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+static void testFindSeen()
+{
+  WifiProfile p = prof("home", 0);
+  WifiSeen s[] = { seen("cafe", -50), seen("home", -60), seen("homeX", -40) };
+  CHECK(wifi_findSeen(p, s, 3) == 1, "home not at index 1");
+  CHECK(wifi_findSeen(p, s, 1) == -1, "found past ns");
+  CHECK(wifi_findSeen(p, s, 0) == -1, "found in an empty scan");
+}
+
+static void testRank()
+{
+  {
+    // a seen network beats an unseen one of any priority
+    WifiProfile p[] = { prof("office", 9), prof("home", 0) };
+    WifiSeen s[] = { seen("home", -90) };
+    int want[] = { 1, 0 };
+    CHECK(ranksAs(p, 2, s, 1, want), "seen must beat unseen");
+  }
+  {
+    // one priority step is worth WIFI_PRIO_DB of signal
+    WifiProfile p[] = { prof("a", 0), prof("b", 1) };
+    WifiSeen closer[] = { seen("a", -60 + WIFI_PRIO_DB - 1), seen("b", -60) };
+    WifiSeen further[] = { seen("a", -60 + WIFI_PRIO_DB + 1), seen("b", -60) };
+    int prioWins[] = { 1, 0 };
+    int rssiWins[] = { 0, 1 };
+    CHECK(ranksAs(p, 2, closer, 2, prioWins), "priority should win inside %d dB", WIFI_PRIO_DB);
+    CHECK(ranksAs(p, 2, further, 2, rssiWins), "signal should win past %d dB", WIFI_PRIO_DB);
+  }
+  {
+    // a network that always fails loses 20 dB
+    WifiProfile p[] = { prof("flaky", 0, 0, 5), prof("solid", 0, 5, 0) };
+    WifiSeen s[] = { seen("flaky", -50), seen("solid", -65) };
+    int want[] = { 1, 0 };
+    CHECK(ranksAs(p, 2, s, 2, want), "fail penalty not applied");
+  }
+  {
+    // equal scores keep the saved order
+    WifiProfile p[] = { prof("a", 1), prof("b", 1), prof("c", 1) };
+    WifiSeen s[] = { seen("c", -60), seen("b", -60), seen("a", -60) };
+    int want[] = { 0, 1, 2 };
+    CHECK(ranksAs(p, 3, s, 3, want), "ties must be stable");
+  }
+  {
+    // no scan: priority only, saved order on ties
+    WifiProfile p[] = { prof("a", 0), prof("b", 2), prof("c", 0), prof("d", 1) };
+    int want[] = { 1, 3, 0, 2 };
+    CHECK(ranksAs(p, 4, nullptr, 0, want), "unscanned ranking by priority");
+  }
+  {
+    // more profiles than slots: only the first WIFI_LINK_MAX_PROFILES count
+    WifiProfile p[WIFI_LINK_MAX_PROFILES + 2];
+    for (int i = 0; i < WIFI_LINK_MAX_PROFILES + 2; i++) p[i] = prof("x", 0);
+    int order[WIFI_LINK_MAX_PROFILES];
+    CHECK(wifi_rank(p, WIFI_LINK_MAX_PROFILES + 2, nullptr, 0, order) == WIFI_LINK_MAX_PROFILES,
+          "np not clamped");
+  }
+}
+
+static void testRoam()
+{
+  const int low = WIFI_ROAM_RSSI - 1;
+  CHECK(wifi_shouldRoam(low, WIFI_ROAM_HOLD_MS, low + WIFI_ROAM_MARGIN_DB), "should roam at the thresholds");
+  CHECK(!wifi_shouldRoam(WIFI_ROAM_RSSI, WIFI_ROAM_HOLD_MS, -30), "roamed off a good enough link");
+  CHECK(!wifi_shouldRoam(low, WIFI_ROAM_HOLD_MS - 1, -30), "roamed before the hold time");
+  CHECK(!wifi_shouldRoam(low, WIFI_ROAM_HOLD_MS, low + WIFI_ROAM_MARGIN_DB - 1), "roamed for less than the margin");
+}
+
+int main()
+{
+  testFindSeen();
+  testRank();
+  testRoam();
+  printf("wifi_pick_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+#include "text_edit.h"
+#include <Arduino.h>
+
+// ============================================================
+// Gap buffer
+// ============================================================
+void TextEdit::begin(char *storage, size_t n) {
+  buf = storage;
+  size = n;
+  clear();
+}
+
+void TextEdit::clear() {
+  gapStart = 0;
+  gapEnd = size;
+}
+
+bool TextEdit::insert(char c) {
+  if (gapStart == gapEnd) return false;
+  buf[gapStart++] = c;
+  return true;
+}
+
+bool TextEdit::backspace() {
+  if (!gapStart) return false;
+  gapStart--;
+  return true;
+}
+
+bool TextEdit::left() {
+  if (!gapStart) return false;
+  buf[--gapEnd] = buf[--gapStart];
+  return true;
+}
+
+bool TextEdit::right() {
+  if (gapEnd == size) return false;
+  buf[gapStart++] = buf[gapEnd++];
+  return true;
+}
+
+// Moves the gap; only the text between the old and new cursor is copied.
+void TextEdit::setCursor(size_t i) {
+  if (i > length()) i = length();
+  if (i < gapStart) {
+    size_t n = gapStart - i;
+    memmove(buf + gapEnd - n, buf + i, n);
+    gapStart = i;
+    gapEnd -= n;
+  } else if (i > gapStart) {
+    size_t n = i - gapStart;
+    memmove(buf + gapStart, buf + gapEnd, n);
+    gapStart += n;
+    gapEnd += n;
+  }
+}
+
+size_t TextEdit::copy(char *out, size_t n) const {
+  if (!n) return 0;
+  size_t len = length();
+  if (len > n - 1) len = n - 1;
+
+  size_t a = len < gapStart ? len : gapStart;
+  memcpy(out, buf, a);
+  memcpy(out + a, buf + gapEnd, len - a);
+  out[len] = 0;
+  return len;
+}
+
+// ============================================================
+// Field
+// ============================================================
+static const int PAD_X   = 2;   // the cursor sits in the column left of a character
+static const int CONTEXT = 4;   // characters kept in view left of the cursor
+
+void TextField::begin(TFT_eSPI *display, TextEdit *e, uint16_t fgc, uint16_t bgc, uint8_t f) {
+  tft = display;
+  edit = e;
+  fg = fgc;
+  bg = bgc;
+  font = f;
+  memset(widths, 0, sizeof(widths));
+  valid = false;
+}
+
+void TextField::place(int nx, int ny, int nw, int nh) {
+  x = nx; y = ny; w = nw; h = nh;
+  valid = false;
+}
+
+void TextField::setMask(char m) {
+  if (m == mask) return;
+  mask = m;
+  valid = false;
+}
+
+bool TextField::hit(int tx, int ty) const {
+  return tx >= x && tx < x + w && ty >= y && ty < y + h;
+}
+
+// Measured once per character; the field never asks the font again.
+int TextField::glyphW(char c) {
+  if (c < ' ' || c > '~') c = '?';
+  uint8_t &cw = widths[c - ' '];
+  if (!cw) {
+    char s[2] = { c, 0 };
+    cw = (uint8_t)tft->textWidth(s, font);
+  }
+  return cw;
+}
+
+char TextField::visibleChar(size_t i) const {
+  return mask ? mask : edit->at(i);
+}
+
+// Cursor in view with a little context before it, and no blank space left at
+// the end while earlier text is scrolled off.
+void TextField::scrollToCursor() {
+  const int avail = w - 2 * PAD_X;
+  size_t cur = edit->cursor(), len = edit->length();
+
+  if (first > len) first = len;
+  if (cur < first + CONTEXT) first = cur > CONTEXT ? cur - CONTEXT : 0;
+
+  int span = 0;
+  for (size_t i = first; i < cur; i++) span += glyphW(visibleChar(i));
+  while ((span > avail || cur - first >= FIELD_MAX_VISIBLE) && first < cur) span -= glyphW(visibleChar(first++));
+
+  int tail = span;
+  for (size_t i = cur; i < len && tail <= avail; i++) tail += glyphW(visibleChar(i));
+  while (first > 0 && tail + glyphW(visibleChar(first - 1)) <= avail) tail += glyphW(visibleChar(--first));
+}
+
+// The characters that fit from first on, and the x each one starts at.
+int TextField::collect(char *vis, int16_t *px) {
+  size_t len = edit->length();
+  int n = 0;
+  px[0] = x + PAD_X;
+  for (size_t i = first; i < len && n < FIELD_MAX_VISIBLE; i++) {
+    char c = visibleChar(i);
+    int cw = glyphW(c);
+    if (px[n] + cw > x + w - PAD_X) break;
+    vis[n] = c;
+    px[n + 1] = px[n] + cw;
+    n++;
+  }
+  return n;
+}
+
+// Characters from..n-1, then background up to clearTo where the old text
+// was longer.
+void TextField::paintFrom(const char *vis, const int16_t *px, int n, int from, int clearTo) {
+  int ty = y + (h - tft->fontHeight(font)) / 2;
+  tft->setTextColor(fg, bg);
+  for (int i = from; i < n; i++) tft->drawChar(vis[i], px[i], ty, font);
+  if (clearTo > px[n]) tft->fillRect(px[n], y, clearTo - px[n], h, bg);
+}
+
+// Off: repaint the character whose last column the cursor used.
+void TextField::paintCursor(const int16_t *px, int c, bool on, const char *vis) {
+  int fh = tft->fontHeight(font);
+  int ty = y + (h - fh) / 2;
+  if (on) tft->drawFastVLine(px[c] - 1, ty, fh, fg);
+  else if (c > 0) paintFrom(vis, px, c, c - 1, 0);
+  else tft->drawFastVLine(px[0] - 1, ty, fh, bg);
+}
+
+void TextField::draw() {
+  valid = false;
+  update();
+}
+
+void TextField::update() {
+  if (!tft || !edit || w <= 0) return;
+
+  size_t oldFirst = first;
+  scrollToCursor();
+
+  char    vis[FIELD_MAX_VISIBLE];
+  int16_t px[FIELD_MAX_VISIBLE + 1];
+  int n = collect(vis, px);
+  int c = (int)(edit->cursor() - first);
+
+  if (!valid || first != oldFirst) {
+    tft->fillRect(x, y, w, h, bg);
+    paintFrom(vis, px, n, 0, 0);
+  } else {
+    // same scroll: everything before the first difference is still right
+    int d = 0;
+    while (d < n && d < shownCount && vis[d] == shown[d]) d++;
+    if (d < n || n != shownCount) paintFrom(vis, px, n, d, shownEnd);
+
+    if (shownCursor >= 0 && shownCursor - 1 < d && shownCursor <= n) paintCursor(px, shownCursor, false, vis);
+  }
+  paintCursor(px, c, true, vis);
+
+  memcpy(shown, vis, n);
+  shownCount = n;
+  shownEnd = px[n];
+  shownCursor = c;
+  valid = true;
+}
+
+void TextField::tap(int tx) {
+  char    vis[FIELD_MAX_VISIBLE];
+  int16_t px[FIELD_MAX_VISIBLE + 1];
+  int n = collect(vis, px);
+
+  int i = 0;
+  while (i < n && tx > (px[i] + px[i + 1]) / 2) i++;
+  edit->setCursor(first + i);
+}
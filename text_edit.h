@@ -0,0 +1,82 @@
+#pragma once
+#include <TFT_eSPI.h>
+
+// Single-line text editing. TextEdit is a gap buffer over caller storage:
+// the text before the cursor sits at the front, the text after it at the
+// back, so typing or deleting anywhere moves no text. TextField draws one in
+// a box, scrolling sideways to keep the cursor in view, and repaints only
+// what changed since the last draw.
+
+class TextEdit {
+public:
+  // Holds up to size characters; no terminator is kept.
+  void begin(char *storage, size_t size);
+
+  size_t length() const { return gapStart + (size - gapEnd); }
+  size_t cursor() const { return gapStart; }
+  char   at(size_t i) const { return i < gapStart ? buf[i] : buf[gapEnd + i - gapStart]; }
+
+  bool insert(char c);
+  bool backspace();   // the character before the cursor
+  bool left();
+  bool right();
+  void setCursor(size_t i);
+  void clear();
+
+  // Copies the text into out, NUL-terminated and cut to n - 1 characters.
+  size_t copy(char *out, size_t n) const;
+
+private:
+  char   *buf = nullptr;
+  size_t  size = 0;
+  size_t  gapStart = 0, gapEnd = 0;
+};
+
+#ifndef FIELD_MAX_VISIBLE
+#define FIELD_MAX_VISIBLE 80   // characters on screen at once
+#endif
+
+class TextField {
+public:
+  // The box's inside; the caller draws the frame. mask != 0 shows every
+  // character as mask.
+  void begin(TFT_eSPI *display, TextEdit *edit, uint16_t fg, uint16_t bg, uint8_t font);
+  void place(int x, int y, int w, int h);
+  void setMask(char m);
+
+  // Everything, e.g. after something else drew over the box.
+  void draw();
+  // Something else drew over the box; the next update repaints it all.
+  void invalidate() { valid = false; }
+  // Only what changed since the last draw or update.
+  void update();
+
+  bool hit(int x, int y) const;
+  // Puts the cursor at the character boundary nearest x.
+  void tap(int x);
+
+private:
+  TFT_eSPI *tft = nullptr;
+  TextEdit *edit = nullptr;
+  int16_t   x = 0, y = 0, w = 0, h = 0;
+  uint16_t  fg = 0, bg = 0;
+  uint8_t   font = 2;
+  char      mask = 0;
+
+  uint8_t   widths[95] = {};   // ' '..'~', 0 = not measured yet
+
+  // what is on screen
+  bool      valid = false;
+  size_t    first = 0;         // text index of the first visible character
+  int       shownCursor = -1;  // visible index, -1 = none
+  char      shown[FIELD_MAX_VISIBLE];
+  int       shownCount = 0;
+  int       shownEnd = 0;      // x after the last character
+
+  int  glyphW(char c);
+  char visibleChar(size_t i) const;
+  void scrollToCursor();
+  int  collect(char *vis, int16_t *px);
+  void paintFrom(const char *vis, const int16_t *px, int n, int from, int clearTo);
+  void paintCursor(const int16_t *px, int c, bool on, const char *vis);
+};
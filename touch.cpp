@@ -3,7 +3,6 @@
 
 #define TOUCH_SDA 33
 #define TOUCH_SCL 32
-#define TOUCH_INT 21
 #define TOUCH_RST 25
 
 static BBCapTouch touch;
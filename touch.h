@@ -5,6 +5,9 @@
 #define TOUCH_SCREEN_W 320
 #define TOUCH_SCREEN_H 240
 
+// Controller interrupt, low while a touch is down; also the light-sleep wake pin.
+#define TOUCH_INT 21
+
 bool touch_is_pressed();
 
 void touch_init();
@@ -1,4 +1,9 @@
 #include "wifi_app.h"
+#include "frame.h"
+#include "wifi_link.h"
+#include "wifi_mon.h"
+#include "ai_client.h"
+#include "keyboard.h"
 #include <Arduino.h>
 #include <WiFi.h>
 #include <Preferences.h>
@@ -16,12 +21,12 @@ enum WifiMode { WIFI_MODE_LIST, WIFI_MODE_CONNECT };
 static WifiMode mode = WIFI_MODE_LIST;
 
 static bool passVisible = false;
-static bool kbNumbers   = false;
 
 static String selectedSSID = "";
-static String passInput    = "";
+static char      passStore[64];   // WPA2 passphrases top out at 63
+static TextEdit  passInput;
+static TextField passField;
 
-static bool connecting = false;
 static uint32_t connectStartMs = 0;
 static bool connectRequested = false;
 static String connectSSID = "";
@@ -29,19 +34,21 @@ static String connectPASS = "";
 
 static String savedSSID = "";
 
-// Networks
-static const int MAX_NET = 12;
-static String  ssidList[MAX_NET];
-static int     rssiList[MAX_NET];
-static uint8_t authList[MAX_NET];
-static int     countNet = 0;
+// Networks, strongest first, one entry per SSID (best AP wins)
+struct NetEntry {
+  char    ssid[33];
+  int8_t  rssi;
+  uint8_t auth;
+  uint8_t channel;
+  uint8_t bssid[6];
+};
+
+static const int MAX_NET = 32;
+static NetEntry nets[MAX_NET];
+static int      countNet = 0;
 static int     selected = -1;
 static int     scroll = 0;
 
-static const char* WIFI_NS  = "wifi";
-static const char* KEY_SSID = "ssid";
-static const char* KEY_PASS = "pass";
-
 static const uint16_t XP_BG     = 0xC618;
 static const uint16_t XP_BORDER = 0x7BEF;
 static const uint16_t XP_WHITE  = 0xFFFF;
@@ -73,6 +80,10 @@ static const int BTN_BACK_X    = WIN_X + WIN_W - PAD - BTN_W;
 
 static const int STATUS_Y = BTN_Y - 16;
 
+// RSSI sparkline from the link monitor, right end of the status line
+static const int SPARK_W = 62;
+static const int SPARK_H = 14;
+
 static const int CONTENT_X = WIN_X + PAD;
 static const int CONTENT_Y = WIN_Y + TITLE_H + PAD;
 static const int CONTENT_W = WIN_W - PAD*2;
@@ -100,73 +111,75 @@ static const int PASS_W = (CONTENT_W) - (SEE_GAP + SEE_W);
 static const int SEE_X  = PASS_X + PASS_W + SEE_GAP;
 static const int SEE_Y  = PASS_Y;
 
-static const int KB_X = CONTENT_X;
-static const int KB_Y = PASS_Y + PASS_H + 8;
-static const int KB_W = CONTENT_W;
+static const int KEYS_X = CONTENT_X;
+static const int KEYS_Y = PASS_Y + PASS_H + 8;
+static const int KEYS_W = CONTENT_W;
+
+static const int KEYS_H = (STATUS_Y - 4) - KEYS_Y;
+static const int KEYS_GAP = 3;
+
+static Keyboard kb;
+static bool     kbTouch = false;   // the touch started on the keyboard
+
+// The driver needs settle time between some calls. Instead of delay()ing,
+// each wait is a step with a due time, advanced from wifi_app_poll().
+enum RadioStep : uint8_t {
+  RADIO_IDLE,
+  RADIO_SCAN_SETTLE,      // old results dropped, scan starts when due
+  RADIO_SCANNING,
+  RADIO_RESET_OFF,        // scan start failed (-2): disconnected, radio off when due
+  RADIO_RESET_ON,         // radio off, back to STA when due
+  RADIO_RESET_SETTLE,     // STA back, retry the scan when due
+  RADIO_CONNECT_SETTLE,   // disconnected, WiFi.begin when due
+  RADIO_CONNECTING
+};
 
-static const int KB_H = (STATUS_Y - 4) - KB_Y;
+static RadioStep radio   = RADIO_IDLE;
+static uint32_t  radioAt = 0;
 
-static bool scanning    = false;
 static bool scanAbort   = false;
 static uint32_t scanStartMs = 0;
 
+// Background scans keep nets[] fresh so the window opens with a list.
+// Settings are set with WIFI_SCAN and kept in NVS.
+struct ScanCfg {
+  uint16_t intervalS;   // 0 = no background scans
+  uint8_t  passive;
+  uint8_t  channel;     // 0 = all
+};
+static ScanCfg  scanCfg = { WIFI_SCAN_INTERVAL_S, 0, 0 };
+static bool     bgScan = false;      // the scan in flight was started in the background
+static uint32_t lastScanTry = 0;
+static uint32_t nextScanAt = 0;      // the next periodic scan
+static bool     scanDeferred = false;
+static uint32_t scanDeferUntil = 0;  // AI or a connect was busy; look again then
+static uint32_t netsAt = 0;          // millis() the cached list was taken, 0 = never
+static uint32_t bgScans = 0, bgDeferred = 0;
+
+static const char* SCAN_NS  = "wifi";
+static const char* SCAN_KEY = "scan";
+
 // retry scheduling
 static uint8_t  scanRetry = 0;
 static bool     scanRetryPending = false;
 static uint32_t scanRetryAtMs = 0;
 
-static const int KB_GAP = 3;
+// pressed-look feedback on a button, undone from wifi_app_tick()
+struct ButtonFlash {
+  int         x, y, w, h;
+  const char* label;
+  WifiMode    mode;
+  uint32_t    until;   // 0 = none
+};
+static ButtonFlash flash = { 0, 0, 0, 0, nullptr, WIFI_MODE_LIST, 0 };
 
 static inline bool inRect(int x,int y,int rx,int ry,int rw,int rh){
   return (x>=rx && x<rx+rw && y>=ry && y<ry+rh);
 }
-static inline bool inRectPad(int x,int y,int rx,int ry,int rw,int rh,int pad){
-  return (x>=rx-pad && x<rx+rw+pad && y>=ry-pad && y<ry+rh+pad);
-}
-
-static int kbRowH() {
-  // total gaps between 4 rows = 3 gaps
-  int h = (KB_H - 3*KB_GAP) / 4;
-
-  if (h < 12) h = 12;
-
-  return h;
-}
-
-// ============================================================
-// NVS helpers
-// ============================================================
-static void nvsSaveWifi(const String& ssid, const String& pass) {
-  Preferences p;
-  p.begin(WIFI_NS, false);
-  p.putString(KEY_SSID, ssid);
-  p.putString(KEY_PASS, pass);
-  p.end();
-}
-
-static bool nvsLoadWifi(String& ssidOut, String& passOut) {
-  Preferences p;
-  p.begin(WIFI_NS, true);
-  ssidOut = p.getString(KEY_SSID, "");
-  passOut = p.getString(KEY_PASS, "");
-  p.end();
-  ssidOut.trim();
-  passOut.trim();
-  return (ssidOut.length() > 0);
-}
-
-static void nvsClearWifi() {
-  Preferences p;
-  p.begin(WIFI_NS, false);
-  p.remove(KEY_SSID);
-  p.remove(KEY_PASS);
-  p.end();
-
-  WiFi.disconnect(true);
-}
 
 void wifi_app_forget_saved() {
-  nvsClearWifi();
+  wifi_link_forgetAll();
+  savedSSID = "";
 }
 
 // ============================================================
@@ -191,13 +204,39 @@ static void drawButton(int x,int y,int w,int h,const char* txt, bool pressed=fal
   tft->setTextDatum(TL_DATUM);
 }
 
+static String statusText;   // redrawn on resume
+
 static void drawStatus(const String& s) {
+  statusText = s;
   if (!opened) return;
-  tft->fillRect(CONTENT_X, STATUS_Y, CONTENT_W, 14, XP_BG);
+  tft->fillRect(CONTENT_X, STATUS_Y, CONTENT_W - SPARK_W - 4, 14, XP_BG);
   tft->setTextColor(XP_BLACK, XP_BG);
   tft->drawString(s, CONTENT_X, STATUS_Y, 2);
 }
 
+static uint32_t sparkSeq = 0;
+
+// One column per sample, newest on the right; height is RSSI -95..-35 dBm,
+// colour is the gateway probe (red = lost).
+static void drawSpark() {
+  if (!opened || mode != WIFI_MODE_LIST) return;
+  sparkSeq = wifi_mon_seq();
+
+  int x0 = CONTENT_X + CONTENT_W - SPARK_W;
+  tft->fillRect(x0, STATUS_Y, SPARK_W, SPARK_H, XP_WHITE);
+  tft->drawRect(x0, STATUS_Y, SPARK_W, SPARK_H, XP_BORDER);
+
+  LinkSample s;
+  for (int age = 0; age < SPARK_W - 2 && wifi_mon_sample(age, s); age++) {
+    int v = constrain((int)s.rssi, -95, -35);
+    int h = 1 + (v + 95) * (SPARK_H - 3) / 60;
+    uint16_t c = 0x0400;                                  // green
+    if (s.gwRttMs == LINK_RTT_LOST) c = 0xF800;
+    else if (s.rssi < -80 || (s.gwRttMs != LINK_RTT_NONE && s.gwRttMs > 50)) c = 0xFC00;
+    tft->drawFastVLine(x0 + SPARK_W - 2 - age, STATUS_Y + SPARK_H - 1 - h, h, c);
+  }
+}
+
 static void drawWindowFrame(const char* title) {
   tft->fillRect(WIN_X, WIN_Y, WIN_W, WIN_H, XP_BG);
   tft->drawRect(WIN_X, WIN_Y, WIN_W, WIN_H, XP_BORDER);
@@ -223,81 +262,159 @@ static void drawWindowFrame(const char* title) {
 // ============================================================
 // List mode drawing
 // ============================================================
+static const int ROW_H    = 20;
+static const int MAX_ROWS = 12;
+static const int SCROLL_W = 8;
+
+// What each visible row shows now, so a refresh repaints only changed rows.
+struct RowShown {
+  uint32_t ssidHash;   // 0 = blank row
+  uint8_t  bars;
+  bool     sel;
+};
+static RowShown shown[MAX_ROWS];
+static int      shownScroll = -1;   // -1 = scrollbar not drawn
+static int      shownCount  = -1;
+
+static int visibleRows() {
+  int n = (NETLIST_H-2) / ROW_H;
+  return n < MAX_ROWS ? n : MAX_ROWS;
+}
+
 static void drawListBox() {
   tft->fillRect(NETLIST_X, NETLIST_Y, NETLIST_W, NETLIST_H, XP_WHITE);
   tft->drawRect(NETLIST_X, NETLIST_Y, NETLIST_W, NETLIST_H, XP_BORDER);
+  memset(shown, 0, sizeof(shown));
+  shownScroll = shownCount = -1;
 }
 
-static void drawList() {
-  tft->fillRect(NETLIST_X+1, NETLIST_Y+1, NETLIST_W-2, NETLIST_H-2, XP_WHITE);
+static uint32_t ssidHash(const char* s) {
+  uint32_t h = 2166136261UL;
+  while (*s) h = (h ^ (uint8_t)*s++) * 16777619UL;
+  return h ? h : 1;
+}
+
+static uint8_t rssiBars(int rssi) {
+  if (rssi > -60) return 4;
+  if (rssi > -70) return 3;
+  if (rssi > -80) return 2;
+  if (rssi > -90) return 1;
+  return 0;
+}
+
+static void drawRow(int i, int idx) {
+  int ry = NETLIST_Y + 2 + i*ROW_H;
+  int rw = NETLIST_W - 4 - SCROLL_W;
+
+  if (idx >= countNet) {
+    tft->fillRect(NETLIST_X+2, ry, rw, ROW_H, XP_WHITE);
+    return;
+  }
 
-  const int rowH = 20;
-  int visibleRows = (NETLIST_H-2) / rowH;
+  bool sel = (idx == selected);
+  if (sel) {
+    tft->fillRect(NETLIST_X+2, ry, rw, ROW_H, XP_BLUE2);
+    tft->setTextColor(XP_WHITE, XP_BLUE2);
+  } else {
+    tft->fillRect(NETLIST_X+2, ry, rw, ROW_H, XP_WHITE);
+    tft->setTextColor(XP_BLACK, XP_WHITE);
+  }
 
-  int maxScroll = countNet - visibleRows;
+  char line[32];
+  const char* ssid = nets[idx].ssid;
+  if (strlen(ssid) > 24) snprintf(line, sizeof(line), "%.24s...", ssid);
+  else strlcpy(line, ssid, sizeof(line));
+  tft->drawString(line, NETLIST_X + 6, ry + 2, 2);
+
+  int bars = rssiBars(nets[idx].rssi);
+  int bx = NETLIST_X + NETLIST_W - 34 - SCROLL_W;
+  int by = ry + ROW_H - 4;
+  for (int b=0;b<4;b++){
+    int h = (b+1)*3;
+    uint16_t col = (b < bars) ? (sel ? XP_WHITE : XP_BLACK) : XP_BORDER;
+    tft->fillRect(bx + b*6, by - h, 4, h, col);
+  }
+}
+
+static void drawScrollbar(int rows) {
+  int sx = NETLIST_X + NETLIST_W - 2 - SCROLL_W;
+  int sy = NETLIST_Y + 2;
+  int sh = rows * ROW_H;
+  tft->fillRect(sx, sy, SCROLL_W, sh, XP_WHITE);
+  if (countNet <= rows) return;
+
+  tft->fillRect(sx + 2, sy, SCROLL_W - 4, sh, XP_BG);
+  int th = max(8, sh * rows / countNet);
+  int ty = sy + (sh - th) * scroll / (countNet - rows);
+  tft->fillRect(sx + 1, ty, SCROLL_W - 2, th, XP_BORDER);
+}
+
+// Repaints only the rows whose SSID, bars or selection changed.
+static void drawList() {
+  int rows = visibleRows();
+
+  int maxScroll = countNet - rows;
   if (maxScroll < 0) maxScroll = 0;
   if (scroll < 0) scroll = 0;
   if (scroll > maxScroll) scroll = maxScroll;
 
-  for (int i = 0; i < visibleRows; i++) {
+  for (int i = 0; i < rows; i++) {
     int idx = scroll + i;
-    if (idx >= countNet) break;
-
-    int ry = NETLIST_Y + 2 + i*rowH;
-    bool sel = (idx == selected);
-
-    if (sel) {
-      tft->fillRect(NETLIST_X+2, ry, NETLIST_W-4, rowH, XP_BLUE2);
-      tft->setTextColor(XP_WHITE, XP_BLUE2);
-    } else {
-      tft->setTextColor(XP_BLACK, XP_WHITE);
+    RowShown want = { 0, 0, false };
+    if (idx < countNet) {
+      want.ssidHash = ssidHash(nets[idx].ssid);
+      want.bars = rssiBars(nets[idx].rssi);
+      want.sel = (idx == selected);
     }
 
-    String line = ssidList[idx];
-    if (line.length() > 24) line = line.substring(0, 24) + "...";
-    tft->drawString(line, NETLIST_X + 6, ry + 2, 2);
-
-    int rssi = rssiList[idx];
-    int bars = 0;
-    if (rssi > -60) bars = 4;
-    else if (rssi > -70) bars = 3;
-    else if (rssi > -80) bars = 2;
-    else if (rssi > -90) bars = 1;
-
-    int bx = NETLIST_X + NETLIST_W - 34;
-    int by = ry + rowH - 4;
-    for (int b=0;b<4;b++){
-      int h = (b+1)*3;
-      uint16_t col = (b < bars) ? (sel ? XP_WHITE : XP_BLACK) : XP_BORDER;
-      tft->fillRect(bx + b*6, by - h, 4, h, col);
-    }
+    RowShown& have = shown[i];
+    if (have.ssidHash == want.ssidHash && have.bars == want.bars && have.sel == want.sel) continue;
+    drawRow(i, idx);
+    have = want;
+  }
+
+  if (shownScroll != scroll || shownCount != countNet) {
+    drawScrollbar(rows);
+    shownScroll = scroll;
+    shownCount = countNet;
   }
 }
 
 // ============================================================
 // Scan helpers (more robust)
 // ============================================================
-static void stopScanNow() {
-  int st = WiFi.scanComplete();
-  if (st == -1) { // running
-    WiFi.scanDelete();
-    delay(120);
-  } else {
-    WiFi.scanDelete();
-    delay(50);
-  }
-  scanning = false;
+static void radioWait(RadioStep next, uint32_t ms) {
+  radio = next;
+  radioAt = millis() + ms;
 }
 
-static void wifiDriverResetForScan() {
-  // common workaround when scanNetworks() returns -2
-  WiFi.disconnect(false);
-  delay(50);
-  WiFi.mode(WIFI_OFF);
-  delay(180);
-  WiFi.mode(WIFI_STA);
-  WiFi.setSleep(false);
-  delay(180);
+static bool radioDue() {
+  return (int32_t)(millis() - radioAt) >= 0;
+}
+
+static bool radioConnecting() {
+  return connectRequested || radio == RADIO_CONNECT_SETTLE || radio == RADIO_CONNECTING;
+}
+
+static bool radioScanning() {
+  return radio == RADIO_SCAN_SETTLE || radio == RADIO_SCANNING;
+}
+
+// Drops a scan in progress or its results. The next step that needs the
+// driver settled waits for it.
+static uint32_t dropScan() {
+  bool running = WiFi.scanComplete() == -1;
+  WiFi.scanDelete();
+  if (radioScanning()) radio = RADIO_IDLE;
+  return running ? 120 : 50;
+}
+
+static void flashButton(int x, int y, int w, int h, const char* label, uint32_t ms) {
+  drawButton(x, y, w, h, label, true);
+  flash.x = x; flash.y = y; flash.w = w; flash.h = h;
+  flash.label = label;
+  flash.mode = mode;
+  flash.until = millis() + ms;
 }
 
 static void scheduleScanRetry(uint32_t delayMs, const String& msg) {
@@ -307,67 +424,129 @@ static void scheduleScanRetry(uint32_t delayMs, const String& msg) {
   if (opened && mode == WIFI_MODE_LIST) drawStatus(msg);
 }
 
-static void startScanAsync() {
-  if (connecting) { drawStatus("Busy connecting..."); return; }
-  if (connectRequested) { drawStatus("Busy connecting..."); return; }
-  if (!opened || mode != WIFI_MODE_LIST) return;
-
+static void launchScan(bool background) {
   WiFi.mode(WIFI_STA);
   WiFi.setSleep(false);
 
-  stopScanNow();
-
+  uint32_t settle = dropScan();
   scanAbort = false;
+  bgScan = background;
+  lastScanTry = millis();
+  nextScanAt = lastScanTry + scanCfg.intervalS * 1000UL;
+  radioWait(RADIO_SCAN_SETTLE, settle);
+}
+
+static void startScanAsync() {
+  if (radioConnecting() || wifi_link_busy()) { drawStatus("Busy connecting..."); return; }
+  if (!opened || mode != WIFI_MODE_LIST) return;
+
+  if (radioScanning() && bgScan) {   // a background scan is already on it
+    bgScan = false;
+    drawStatus("Scanning...");
+    return;
+  }
+  if (radio != RADIO_IDLE && !radioScanning()) return;   // driver reset underway, it retries
+
   drawStatus("Scanning...");
+  launchScan(false);
+}
+
+static void beginScan() {
+  if (scanAbort || (!bgScan && (!opened || mode != WIFI_MODE_LIST))) {
+    scanAbort = false;
+    radio = RADIO_IDLE;
+    return;
+  }
+
   scanStartMs = millis();
+  int r = WiFi.scanNetworks(true, false, scanCfg.passive != 0, 300, scanCfg.channel);
 
-  int r = WiFi.scanNetworks(true, false); // async=true, show_hidden=false
+  if (r == -2 && bgScan) {
+    // cycling the radio would drop the link; try again next interval
+    radio = RADIO_IDLE;
+    return;
+  }
 
   if (r == -2) {
-    // driver reset then schedule retry
-    wifiDriverResetForScan();
-    scheduleScanRetry(350, "Scan start failed — retrying...");
+    // common workaround: cycle the radio, then retry
+    WiFi.disconnect(false);
+    radioWait(RADIO_RESET_OFF, 50);
     return;
   }
 
-  scanning = true;
+  radio = RADIO_SCANNING;   // a rare immediate result is harvested on the next poll
+}
 
-  if (r >= 0) {
-    // completed immediately (rare)
-    // we'll harvest on next tick (or now)
+static int findNet(const char* ssid) {
+  for (int i = 0; i < countNet; i++) if (strcmp(nets[i].ssid, ssid) == 0) return i;
+  return -1;
+}
+
+// One entry per SSID with its strongest AP; when full, the weakest goes.
+static void addNet(const String& ssid, int scanIdx) {
+  int rssi = WiFi.RSSI(scanIdx);
+  int i = findNet(ssid.c_str());
+  if (i >= 0) {
+    if (rssi <= nets[i].rssi) return;
+  } else if (countNet < MAX_NET) {
+    i = countNet++;
+  } else {
+    i = 0;
+    for (int k = 1; k < countNet; k++) if (nets[k].rssi < nets[i].rssi) i = k;
+    if (rssi <= nets[i].rssi) return;
+  }
+
+  NetEntry& e = nets[i];
+  strlcpy(e.ssid, ssid.c_str(), sizeof(e.ssid));
+  e.rssi = (int8_t)rssi;
+  e.auth = (uint8_t)WiFi.encryptionType(scanIdx);
+  e.channel = (uint8_t)WiFi.channel(scanIdx);
+  const uint8_t* b = WiFi.BSSID(scanIdx);
+  if (b) memcpy(e.bssid, b, sizeof(e.bssid));
+  else memset(e.bssid, 0, sizeof(e.bssid));
+}
+
+static void sortNets() {
+  for (int i = 1; i < countNet; i++) {
+    NetEntry v = nets[i];
+    int j = i - 1;
+    while (j >= 0 && nets[j].rssi < v.rssi) { nets[j + 1] = nets[j]; j--; }
+    nets[j + 1] = v;
   }
 }
 
 static void harvestScanResults(int n) {
   countNet = 0;
-  selected = -1;
-  selectedSSID = "";
-  scroll = 0;
 
-  for (int i = 0; i < n && countNet < MAX_NET; i++) {
+  for (int i = 0; i < n; i++) {
     String s = WiFi.SSID(i);
     s.trim();
     if (s.length() == 0) continue;
-
-    ssidList[countNet] = s;
-    rssiList[countNet] = WiFi.RSSI(i);
-    authList[countNet] = (uint8_t)WiFi.encryptionType(i);
-    countNet++;
+    addNet(s, i);
   }
 
   WiFi.scanDelete();
-  delay(10);
-
-  String prefer = (WiFi.status() == WL_CONNECTED) ? WiFi.SSID() : savedSSID;
-  prefer.trim();
-  if (prefer.length() > 0) {
-    for (int i=0;i<countNet;i++){
-      if (ssidList[i] == prefer) {
-        selected = i;
-        selectedSSID = prefer;
-        break;
-      }
-    }
+  sortNets();
+  netsAt = millis();
+  if (bgScan) bgScans++;
+
+  // the reconnect service picks and roams between saved networks from this
+  wifi_link_scanBegin();
+  for (int i = 0; i < countNet; i++)
+    wifi_link_scanSeen(nets[i].ssid, nets[i].rssi, nets[i].channel, nets[i].bssid);
+
+  // on the password screen the network being joined stays put, wherever it
+  // now sits in the list
+  if (mode == WIFI_MODE_CONNECT) {
+    selected = findNet(selectedSSID.c_str());
+  } else {
+    // keep the user's pick if it's still around, else the network we're on or saved
+    String prefer = selectedSSID;
+    if (prefer.length() == 0 || findNet(prefer.c_str()) < 0)
+      prefer = (WiFi.status() == WL_CONNECTED) ? WiFi.SSID() : savedSSID;
+    prefer.trim();
+    selected = prefer.length() > 0 ? findNet(prefer.c_str()) : -1;
+    selectedSSID = selected >= 0 ? prefer : "";
   }
 
   if (opened && mode == WIFI_MODE_LIST) {
@@ -382,30 +561,28 @@ static void harvestScanResults(int n) {
 }
 
 static void pollScanComplete() {
-  if (!scanning) return;
-
   int n = WiFi.scanComplete();
 
   if (n == -1) {
     // running
     if (millis() - scanStartMs > 15000) {
-      scanning = false;
+      radio = RADIO_IDLE;
       WiFi.scanDelete();
-      scheduleScanRetry(350, "Scan timeout — retrying...");
+      if (!bgScan) scheduleScanRetry(350, "Scan timeout — retrying...");
     }
     return;
   }
 
   if (n < 0) {
     // failed (-2)
-    scanning = false;
+    radio = RADIO_IDLE;
     WiFi.scanDelete();
-    scheduleScanRetry(350, "Scan failed — retrying...");
+    if (!bgScan) scheduleScanRetry(350, "Scan failed — retrying...");
     return;
   }
 
   // complete
-  scanning = false;
+  radio = RADIO_IDLE;
 
   if (scanAbort) {
     scanAbort = false;
@@ -421,6 +598,7 @@ static void pollScanComplete() {
 // ============================================================
 static void redrawPassFieldOnly();
 static void drawPassError(const char* msg);
+static void drawListScreen();
 
 static void drawPasswordBox() {
   tft->setTextColor(XP_BLACK, XP_BG);
@@ -430,26 +608,12 @@ static void drawPasswordBox() {
   tft->drawRect(PASS_X, PASS_Y, PASS_W, PASS_H, XP_BORDER);
 
   drawButton(SEE_X, SEE_Y, SEE_W, SEE_H, passVisible ? "Hide" : "See");
-  redrawPassFieldOnly();
+  passField.draw();
 }
 
 static void redrawPassFieldOnly() {
-  tft->fillRect(PASS_X+1, PASS_Y+1, PASS_W-2, PASS_H-2, XP_WHITE);
-
-  String shown;
-  if (passVisible) shown = passInput;
-  else {
-    shown.reserve(passInput.length());
-    for (int i=0;i<passInput.length();i++) shown += "*";
-  }
-
-  const int maxChars = 22;
-  if (shown.length() > maxChars) {
-    shown = "..." + shown.substring(shown.length() - maxChars);
-  }
-
-  tft->setTextColor(XP_BLACK, XP_WHITE);
-  tft->drawString(shown, PASS_X + 4, PASS_Y + 2, 2);
+  passField.setMask(passVisible ? 0 : '*');
+  passField.update();
 }
 
 static void drawPassError(const char* msg) {
@@ -457,237 +621,7 @@ static void drawPassError(const char* msg) {
   tft->fillRect(PASS_X+1, PASS_Y+1, PASS_W-2, PASS_H-2, XP_WHITE);
   tft->setTextColor(0xF800, XP_WHITE); // red
   tft->drawString(msg, PASS_X + 4, PASS_Y + 2, 2);
-}
-
-static void drawKey(int x,int y,int w,int h,const char* label, bool pressed=false) {
-  drawBevelRect(x,y,w,h,XP_BG,pressed);
-  tft->setTextColor(XP_BLACK, XP_BG);
-  tft->setTextDatum(MC_DATUM);
-  tft->drawString(label, x + w/2, y + h/2, 2);
-  tft->setTextDatum(TL_DATUM);
-}
-
-static const char* kbRow1() { return kbNumbers ? "1234567890"     : "qwertyuiop"; }
-static const char* kbRow2() { return kbNumbers ? "@#$%&*()-_="    : "asdfghjkl";  }
-static const char* kbRow3() { return kbNumbers ? ".,:;!?/+\\"     : "zxcvbnm";    }
-
-static void drawKeyboard() {
-  // Background
-  tft->fillRect(KB_X, KB_Y, KB_W, KB_H, XP_BG);
-
-  const char* row1 = kbRow1();
-  const char* row2 = kbRow2();
-  const char* row3 = kbRow3();
-
-  const int rowH = kbRowH();
-  const int gap  = KB_GAP;
-
-  // Start at the top of the keyboard box to avoid overlapping status text
-  int y = KB_Y;
-
-  // Row 1
-  {
-    int n = (int)strlen(row1);
-    int keyW = (KB_W - (n-1)*gap) / n;
-    int x = KB_X;
-    for (int i=0;i<n;i++){
-      char tmp[2] = { row1[i], 0 };
-      drawKey(x, y, keyW, rowH, tmp, false);
-      x += keyW + gap;
-    }
-    y += rowH + gap;
-  }
-
-  // Row 2
-  {
-    int n = (int)strlen(row2);
-    int keyW = (KB_W - (n-1)*gap) / n;
-    int x = KB_X;
-    for (int i=0;i<n;i++){
-      char tmp[2] = { row2[i], 0 };
-      drawKey(x, y, keyW, rowH, tmp, false);
-      x += keyW + gap;
-    }
-    y += rowH + gap;
-  }
-
-  // Row 3 + Del
-  {
-    int n = (int)strlen(row3);
-    int delW = 70;
-    int keyW = (KB_W - delW - (n*gap)) / n;
-
-    int x = KB_X;
-    for (int i=0;i<n;i++){
-      char tmp[2] = { row3[i], 0 };
-      drawKey(x, y, keyW, rowH, tmp, false);
-      x += keyW + gap;
-    }
-    drawKey(x, y, delW, rowH, "Del", false);
-    y += rowH + gap;
-  }
-
-  // Bottom row
-  {
-    int toggleW = 70;
-    int clrW    = 70;
-    int okW     = 70;
-
-    int x = KB_X;
-    drawKey(x, y, toggleW, rowH, kbNumbers ? "ABC" : "123", false);
-    x += toggleW + gap;
-
-    int spaceW = KB_W - (toggleW + gap + clrW + gap + okW);
-    drawKey(x, y, spaceW, rowH, "Space", false);
-
-    int clrX = KB_X + KB_W - (clrW + gap + okW);
-    drawKey(clrX, y, clrW, rowH, "Clr", false);
-
-    int okX = clrX + clrW + gap;
-    drawKey(okX, y, okW, rowH, "OK", false);
-  }
-}
-
-enum KbType { KB_NONE, KB_CHAR, KB_DEL, KB_TOGGLE, KB_SPACE, KB_CLR, KB_OK };
-
-struct KbHit {
-  KbType type = KB_NONE;
-  char ch = 0;
-  int x=0,y=0,w=0,h=0;
-};
-
-static KbHit kbActive;
-static bool  kbHasActive = false;
-
-static void drawKbHit(const KbHit& h, bool pressed) {
-  if (h.type == KB_NONE) return;
-
-  if (h.type == KB_CHAR) {
-    char tmp[2] = { h.ch, 0 };
-    drawKey(h.x, h.y, h.w, h.h, tmp, pressed);
-  } else if (h.type == KB_DEL)    drawKey(h.x, h.y, h.w, h.h, "Del", pressed);
-  else if (h.type == KB_TOGGLE)   drawKey(h.x, h.y, h.w, h.h, kbNumbers ? "ABC" : "123", pressed);
-  else if (h.type == KB_SPACE)    drawKey(h.x, h.y, h.w, h.h, "Space", pressed);
-  else if (h.type == KB_CLR)      drawKey(h.x, h.y, h.w, h.h, "Clr", pressed);
-  else if (h.type == KB_OK)       drawKey(h.x, h.y, h.w, h.h, "OK", pressed);
-}
-
-static bool sameHit(const KbHit& a, const KbHit& b) {
-  return a.type==b.type && a.ch==b.ch && a.x==b.x && a.y==b.y && a.w==b.w && a.h==b.h;
-}
-
-static KbHit kbHitTest(int x, int y) {
-  KbHit h;
-  if (!inRect(x,y,KB_X,KB_Y,KB_W,KB_H)) return h;
-
-  const int pad = 6;
-  const int rowH = kbRowH();
-  const int gap  = KB_GAP;
-
-  const char* row1 = kbRow1();
-  const char* row2 = kbRow2();
-  const char* row3 = kbRow3();
-
-  // Row1
-  {
-    int n = (int)strlen(row1);
-    int keyW = (KB_W - (n-1)*gap) / n;
-    int y0 = KB_Y;
-    int kx = KB_X;
-    for (int i=0;i<n;i++){
-      if (inRectPad(x,y,kx,y0,keyW,rowH,pad)) {
-        h.type=KB_CHAR; h.ch=row1[i]; h.x=kx; h.y=y0; h.w=keyW; h.h=rowH;
-        return h;
-      }
-      kx += keyW + gap;
-    }
-  }
-
-  // Row2
-  {
-    int n = (int)strlen(row2);
-    int keyW = (KB_W - (n-1)*gap) / n;
-    int y0 = KB_Y + (rowH+gap);
-    int kx = KB_X;
-    for (int i=0;i<n;i++){
-      if (inRectPad(x,y,kx,y0,keyW,rowH,pad)) {
-        h.type=KB_CHAR; h.ch=row2[i]; h.x=kx; h.y=y0; h.w=keyW; h.h=rowH;
-        return h;
-      }
-      kx += keyW + gap;
-    }
-  }
-
-  // Row3 + Del
-  {
-    int y0 = KB_Y + 2*(rowH+gap);
-    int n = (int)strlen(row3);
-    int delW = 70;
-    int keyW = (KB_W - delW - (n*gap)) / n;
-
-    int kx = KB_X;
-    for (int i=0;i<n;i++){
-      if (inRectPad(x,y,kx,y0,keyW,rowH,pad)) {
-        h.type=KB_CHAR; h.ch=row3[i]; h.x=kx; h.y=y0; h.w=keyW; h.h=rowH;
-        return h;
-      }
-      kx += keyW + gap;
-    }
-    if (inRectPad(x,y,kx,y0,delW,rowH,pad)) {
-      h.type=KB_DEL; h.x=kx; h.y=y0; h.w=delW; h.h=rowH;
-      return h;
-    }
-  }
-
-  // Bottom row
-  {
-    int y0 = KB_Y + 3*(rowH+gap);
-
-    int toggleW = 70;
-    int clrW    = 70;
-    int okW     = 70;
-
-    int x0 = KB_X;
-    if (inRectPad(x,y,x0,y0,toggleW,rowH,pad)) {
-      h.type=KB_TOGGLE; h.x=x0; h.y=y0; h.w=toggleW; h.h=rowH; return h;
-    }
-    x0 += toggleW + gap;
-
-    int spaceW = KB_W - (toggleW + gap + clrW + gap + okW);
-    if (inRectPad(x,y,x0,y0,spaceW,rowH,pad)) {
-      h.type=KB_SPACE; h.x=x0; h.y=y0; h.w=spaceW; h.h=rowH; return h;
-    }
-
-    int clrX = KB_X + KB_W - (clrW + gap + okW);
-    if (inRectPad(x,y,clrX,y0,clrW,rowH,pad)) {
-      h.type=KB_CLR; h.x=clrX; h.y=y0; h.w=clrW; h.h=rowH; return h;
-    }
-
-    int okX = clrX + clrW + gap;
-    if (inRectPad(x,y,okX,y0,okW,rowH,pad)) {
-      h.type=KB_OK; h.x=okX; h.y=y0; h.w=okW; h.h=rowH; return h;
-    }
-  }
-
-  return h;
-}
-
-// ============================================================
-// Password editing
-// ============================================================
-static void addChar(char c) {
-  if (passInput.length() >= 64) return;
-  passInput += c;
-  redrawPassFieldOnly();
-}
-static void backspace() {
-  if (passInput.length() == 0) return;
-  passInput.remove(passInput.length()-1);
-  redrawPassFieldOnly();
-}
-static void clearPass() {
-  passInput = "";
-  redrawPassFieldOnly();
+  passField.invalidate();
 }
 
 static bool isAuthOpen(uint8_t a) {
@@ -700,85 +634,59 @@ static bool isAuthOpen(uint8_t a) {
 
 static bool selectedIsOpenNetwork() {
   if (selected < 0 || selected >= countNet) return false;
-  return isAuthOpen(authList[selected]);
+  return isAuthOpen(nets[selected].auth);
 }
 
 static bool doConnect() {
-  if (connecting || connectRequested) return false;
+  if (radioConnecting()) return false;
   if (selectedSSID.length() == 0) { drawStatus("No SSID selected"); return false; }
-  if (!selectedIsOpenNetwork() && passInput.length() == 0) {
+  if (!selectedIsOpenNetwork() && !passInput.length()) {
     drawPassError("Password required");
     return false;
   }
   connectSSID = selectedSSID;
-  connectPASS = passInput;
+  char pass[sizeof(passStore) + 1];
+  passInput.copy(pass, sizeof(pass));
+  connectPASS = pass;
   connectRequested = true;
   return true;
 }
 
+static void leaveConnectScreen() {
+  kb.setVisible(false);
+  kbTouch = false;
+  mode = WIFI_MODE_LIST;
+}
+
+// Touches that start on the keyboard stay with it until lifted.
 static bool handleKeyboardTouch(bool pressed, bool lastPressed, int x, int y) {
   if (mode != WIFI_MODE_CONNECT) return false;
 
-  if (pressed) {
-    KbHit now = kbHitTest(x,y);
-
-    if (!kbHasActive) {
-      kbActive = now;
-      kbHasActive = (now.type != KB_NONE);
-      if (kbHasActive) drawKbHit(kbActive, true);
-    } else {
-      if (!sameHit(now, kbActive)) {
-        drawKbHit(kbActive, false);
-        kbActive = now;
-        kbHasActive = (now.type != KB_NONE);
-        if (kbHasActive) drawKbHit(kbActive, true);
-      }
-    }
-    return (now.type != KB_NONE) || kbHasActive;
+  if (!pressed) {
+    if (kbTouch) kb.release();
+    bool was = kbTouch;
+    kbTouch = false;
+    return was;
   }
 
-  if (!pressed && lastPressed && kbHasActive) {
-    drawKbHit(kbActive, false);
-
-    switch (kbActive.type) {
-      case KB_CHAR:   addChar(kbActive.ch); break;
-      case KB_DEL:    backspace(); break;
-      case KB_TOGGLE: kbNumbers = !kbNumbers; drawKeyboard(); break;
-      case KB_SPACE:  addChar(' '); break;
-      case KB_CLR:    clearPass(); break;
-      case KB_OK:
-        if (doConnect()) {
-          mode = WIFI_MODE_LIST;
-          drawWindowFrame("Wireless Networks");
-          drawListBox();
-          drawButton(BTN_REFRESH_X, BTN_Y, BTN_W, BTN_H, "Refresh");
-          drawButton(BTN_CONNECT_X, BTN_Y, BTN_W, BTN_H, "Connect");
-          drawButton(BTN_BACK_X,    BTN_Y, BTN_W, BTN_H, "Back");
-          drawStatus("Connecting...");
-          drawList();
-        }
-        break;
-      default: break;
-    }
+  if (!lastPressed) kbTouch = kb.contains(x, y);
+  if (!kbTouch) return false;
 
-    kbHasActive = false;
-    kbActive = KbHit();
-    return true;
+  switch (kb.update(true, x, y)) {
+    case KB_CHANGED: redrawPassFieldOnly(); break;
+    case KB_ENTER:
+      if (doConnect()) {
+        leaveConnectScreen();
+        statusText = "Connecting...";
+        drawListScreen();
+      }
+      break;
+    default: break;
   }
-
-  return false;
+  return true;
 }
 
 static void drawConnectScreen() {
-  mode = WIFI_MODE_CONNECT;
-  kbNumbers = false;
-  passVisible = false;
-
-  kbHasActive = false;
-  kbActive = KbHit();
-
-  passInput = "";
-
   drawWindowFrame("Connect");
 
   tft->setTextColor(XP_BLACK, XP_BG);
@@ -793,121 +701,227 @@ static void drawConnectScreen() {
   tft->drawString(s, CONTENT_X + 6, SSID_BOX_Y + 3, 2);
 
   drawPasswordBox();
-  drawKeyboard();
+  kb.setVisible(true);
+  kb.draw();
 
   drawButton(BTN_REFRESH_X, BTN_Y, BTN_W, BTN_H, "Forget");
   drawButton(BTN_CONNECT_X, BTN_Y, BTN_W, BTN_H, "Cancel");
   drawButton(BTN_BACK_X,    BTN_Y, BTN_W, BTN_H, "Back");
 }
 
+static void openConnectScreen() {
+  mode = WIFI_MODE_CONNECT;
+  passVisible = false;
+  kbTouch = false;
+  passInput.clear();
+  passField.setMask('*');
+  drawConnectScreen();
+}
+
 void wifi_app_init(TFT_eSPI* display) {
   tft = display;
 
-  String ss, pw;
-  if (nvsLoadWifi(ss, pw)) savedSSID = ss;
-  else savedSSID = "";
+  KeyboardCfg kc;
+  kc.x = KEYS_X; kc.y = KEYS_Y; kc.w = KEYS_W; kc.h = KEYS_H;
+  kc.pad = 0;
+  kc.gap = KEYS_GAP;
+  kc.okKey = true;
+  kc.bevel = true;
+  kc.bg = kc.face = kc.faceDown = XP_BG;
+  kc.text = XP_BLACK;
+  kc.edge = XP_WHITE;
+  kc.edgeDown = XP_BORDER;
+  passInput.begin(passStore, sizeof(passStore));
+  passField.begin(display, &passInput, XP_BLACK, XP_WHITE, 2);
+  passField.place(PASS_X + 1, PASS_Y + 1, PASS_W - 2, PASS_H - 2);
+  kb.begin(display, kc, &passInput);
+  savedSSID = wifi_link_savedSsid();
+
+  Preferences p;
+  p.begin(SCAN_NS, true);
+  ScanCfg c;
+  if (p.getBytes(SCAN_KEY, &c, sizeof(c)) == sizeof(c)) scanCfg = c;
+  p.end();
+
+  // first background scan shortly after boot, once the reconnect has had its go
+  lastScanTry = millis();
+  nextScanAt = lastScanTry + WIFI_SCAN_FIRST_MS;
 }
 
-bool wifi_app_autoconnect(uint32_t timeoutMs) {
-  String ss, pw;
-  if (!nvsLoadWifi(ss, pw)) return false;
+static void setLinkStatus() {
+  if (WiFi.status() == WL_CONNECTED) {
+    statusText = String("Connected   ") + WiFi.SSID();
+  } else if (savedSSID.length() > 0) {
+    statusText = String("Not connected (saved: ") + savedSSID + ")";
+  } else {
+    statusText = "Not connected";
+  }
+}
 
-  savedSSID = ss;
+static void drawListScreen() {
+  drawWindowFrame("Wireless Networks");
+  drawListBox();
 
-  WiFi.mode(WIFI_STA);
-  WiFi.setSleep(false);
-  WiFi.begin(ss.c_str(), pw.c_str());
+  drawButton(BTN_REFRESH_X, BTN_Y, BTN_W, BTN_H, "Refresh");
+  drawButton(BTN_CONNECT_X, BTN_Y, BTN_W, BTN_H, "Connect");
+  drawButton(BTN_BACK_X,    BTN_Y, BTN_W, BTN_H, "Back");
 
-  uint32_t start = millis();
-  while (millis() - start < timeoutMs) {
-    if (WiFi.status() == WL_CONNECTED) return true;
-    delay(50);
-  }
-  return (WiFi.status() == WL_CONNECTED);
+  drawStatus(statusText);
+  drawList();
+  drawSpark();
 }
 
 void wifi_app_open() {
   if (!tft) return;
+  frame_clear();
   opened = true;
-  mode = WIFI_MODE_LIST;
+  leaveConnectScreen();
 
   scanAbort = false;
-  scanning = false;
   scanRetry = 0;
   scanRetryPending = false;
+  flash.until = 0;
 
-  {
-    String ss, pw;
-    if (nvsLoadWifi(ss, pw)) savedSSID = ss;
-    else savedSSID = "";
-  }
+  savedSSID = wifi_link_savedSsid();
 
-  drawWindowFrame("Wireless Networks");
-  drawListBox();
-
-  drawButton(BTN_REFRESH_X, BTN_Y, BTN_W, BTN_H, "Refresh");
-  drawButton(BTN_CONNECT_X, BTN_Y, BTN_W, BTN_H, "Connect");
-  drawButton(BTN_BACK_X,    BTN_Y, BTN_W, BTN_H, "Back");
-
-  if (WiFi.status() == WL_CONNECTED) {
-    drawStatus(String("Connected   ") + WiFi.SSID());
-  } else if (savedSSID.length() > 0) {
-    drawStatus(String("Not connected (saved: ") + savedSSID + ")");
-  } else {
-    drawStatus("Not connected");
-  }
+  setLinkStatus();
+  drawListScreen();   // whatever the background scans found, straight away
+  if (!netsAt || millis() - netsAt > WIFI_SCAN_FRESH_MS) startScanAsync();
+}
 
-  drawList();
-  startScanAsync();
+// Back from the screen being off: same screen, same password, same list.
+static void wifiResume() {
+  if (!tft) return;
+  frame_clear();
+  kbTouch = false;
+  if (mode == WIFI_MODE_CONNECT) drawConnectScreen();
+  else drawListScreen();
 }
 
 void wifi_app_tick() {
-  if (connectRequested && !connecting) {
-    connectRequested = false;
-    stopScanNow();
-    WiFi.mode(WIFI_STA);
-    WiFi.setSleep(false);
-    WiFi.disconnect(false);
-    delay(150);
-    if (connectPASS.length() == 0) WiFi.begin(connectSSID.c_str());
-    else WiFi.begin(connectSSID.c_str(), connectPASS.c_str());
-    connectStartMs = millis();
-    connecting = true;
-  }
+  if (mode == WIFI_MODE_LIST && wifi_mon_seq() != sparkSeq) drawSpark();
 
-  if (!connecting && !connectRequested) {
-    pollScanComplete();
+  if (flash.until && (int32_t)(millis() - flash.until) >= 0) {
+    flash.until = 0;
+    if (mode == flash.mode) drawButton(flash.x, flash.y, flash.w, flash.h, flash.label, false);
   }
 
-  if (!scanning && scanRetryPending) {
-    if (connecting) {
+  if (radio == RADIO_IDLE && scanRetryPending) {
+    if (radioConnecting()) {
       scanRetryAtMs = millis() + 500;
     } else if (millis() >= scanRetryAtMs) {
       scanRetryPending = false;
       startScanAsync();
     }
   }
+}
+
+static void pollConnect();
+
+// Starts a background scan when one is due and nothing else wants the radio.
+static void pollBackgroundScan() {
+  if (scanDeferred && (int32_t)(millis() - scanDeferUntil) < 0) return;
+  scanDeferred = false;
+
+  bool due = scanCfg.intervalS && (int32_t)(millis() - nextScanAt) >= 0;
+  // a weak link asks for one early, to look for something to roam to
+  bool roam = wifi_link_wantsScan() && millis() - lastScanTry >= WIFI_ROAM_HOLD_MS;
+  if (!due && !roam) return;
+
+  // a scan takes the radio off channel for seconds; not while the chat waits on a reply
+  if (ai_busy() || wifi_link_busy() || radioConnecting()) {
+    bgDeferred++;
+    scanDeferred = true;
+    scanDeferUntil = millis() + 2000;
+    return;
+  }
+
+  launchScan(true);
+}
+
+void wifi_app_poll() {
+  if (radio == RADIO_IDLE) pollBackgroundScan();
+
+  if (radio == RADIO_SCANNING && bgScan && ai_busy()) {
+    dropScan();
+    bgDeferred++;
+  }
 
-  if (!connecting) return;
+  if (connectRequested && (radio == RADIO_IDLE || radioScanning())) {
+    connectRequested = false;
+    wifi_link_hold(true);
+    uint32_t settle = dropScan();
+    WiFi.mode(WIFI_STA);
+    WiFi.setSleep(false);
+    WiFi.disconnect(false);
+    radioWait(RADIO_CONNECT_SETTLE, settle > 150 ? settle : 150);
+    return;
+  }
 
+  if (radio == RADIO_IDLE || !radioDue()) return;
+
+  switch (radio) {
+    case RADIO_SCAN_SETTLE:
+      beginScan();
+      break;
+
+    case RADIO_SCANNING:
+      pollScanComplete();
+      break;
+
+    case RADIO_RESET_OFF:
+      WiFi.mode(WIFI_OFF);
+      radioWait(RADIO_RESET_ON, 180);
+      break;
+
+    case RADIO_RESET_ON:
+      WiFi.mode(WIFI_STA);
+      WiFi.setSleep(false);
+      radioWait(RADIO_RESET_SETTLE, 180);
+      break;
+
+    case RADIO_RESET_SETTLE:
+      radio = RADIO_IDLE;
+      if (opened) scheduleScanRetry(350, "Scan start failed — retrying...");
+      break;
+
+    case RADIO_CONNECT_SETTLE:
+      if (connectPASS.length() == 0) WiFi.begin(connectSSID.c_str());
+      else WiFi.begin(connectSSID.c_str(), connectPASS.c_str());
+      connectStartMs = millis();
+      radio = RADIO_CONNECTING;
+      break;
+
+    case RADIO_CONNECTING:
+      pollConnect();
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void pollConnect() {
   wl_status_t st = WiFi.status();
 
   if (st == WL_CONNECTED) {
-    connecting = false;
+    radio = RADIO_IDLE;
 
-    nvsSaveWifi(selectedSSID, passInput);
-    savedSSID = selectedSSID;
+    wifi_link_save(connectSSID.c_str(), connectPASS.c_str());
+    savedSSID = connectSSID;
 
     if (opened) drawStatus("Connected. Saved");
   }
   else if (st == WL_CONNECT_FAILED || st == WL_NO_SSID_AVAIL) {
-    connecting = false;
+    radio = RADIO_IDLE;
     WiFi.disconnect(false);
+    wifi_link_hold(false);
     if (opened) drawStatus("Failed ❌");
   }
   else if (millis() - connectStartMs > 12000) {
-    connecting = false;
+    radio = RADIO_IDLE;
     WiFi.disconnect(false);
+    wifi_link_hold(false);
     if (opened) drawStatus("Wrong password ❌");
   }
 }
@@ -915,6 +929,15 @@ void wifi_app_tick() {
 // ============================================================
 // Touch handler
 // ============================================================
+static void closeWindow() {
+  if (!bgScan) {   // background scans carry on filling the cache
+    scanAbort = true;
+    dropScan();
+  }
+  kb.setVisible(false);
+  opened = false;
+}
+
 bool wifi_app_handleTouch(bool pressed, bool lastPressed, int x, int y) {
   // ✅ CRITICAL: if not open, DO NOT consume touches
   if (!opened) return false;
@@ -928,26 +951,13 @@ bool wifi_app_handleTouch(bool pressed, bool lastPressed, int x, int y) {
   int cx = WIN_X + WIN_W - PAD - CLOSE_W;
   int cy = WIN_Y + 1;
 
-  if (inRect(x,y,cx,cy,CLOSE_W,CLOSE_H)) {
-    scanAbort = true;
-    if (scanning) stopScanNow();
-    opened = false;
-    return false;
-  }
-
-  if (inRect(x,y,BTN_BACK_X,BTN_Y,BTN_W,BTN_H)) {
-    scanAbort = true;
-    if (scanning) stopScanNow();
-    opened = false;
-    return false;
-  }
+  // Close and Back: the registry then calls closeWindow()
+  if (inRect(x,y,cx,cy,CLOSE_W,CLOSE_H) || inRect(x,y,BTN_BACK_X,BTN_Y,BTN_W,BTN_H)) return false;
 
   // ===================== LIST MODE =====================
   if (mode == WIFI_MODE_LIST) {
     if (inRect(x,y,BTN_REFRESH_X,BTN_Y,BTN_W,BTN_H)) {
-      drawButton(BTN_REFRESH_X, BTN_Y, BTN_W, BTN_H, "Refresh", true);
-      delay(60);
-      drawButton(BTN_REFRESH_X, BTN_Y, BTN_W, BTN_H, "Refresh", false);
+      flashButton(BTN_REFRESH_X, BTN_Y, BTN_W, BTN_H, "Refresh", 60);
       startScanAsync();
       return true;
     }
@@ -957,19 +967,27 @@ bool wifi_app_handleTouch(bool pressed, bool lastPressed, int x, int y) {
         drawStatus("Select a network first");
         return true;
       }
-      drawConnectScreen();
+      openConnectScreen();
       return true;
     }
 
     if (inRect(x,y,NETLIST_X,NETLIST_Y,NETLIST_W,NETLIST_H)) {
-      const int rowH = 20;
+      int rows = visibleRows();
+
+      // scrollbar strip: upper half pages up, lower half down
+      if (countNet > rows && x >= NETLIST_X + NETLIST_W - 2 - SCROLL_W - 4) {
+        scroll += (y < NETLIST_Y + NETLIST_H/2) ? -(rows - 1) : (rows - 1);
+        drawList();
+        return true;
+      }
+
       int relY = y - (NETLIST_Y + 2);
-      int row = relY / rowH;
+      int row = relY / ROW_H;
       int idx = scroll + row;
 
-      if (idx >= 0 && idx < countNet) {
+      if (row < rows && idx >= 0 && idx < countNet && idx != selected) {
         selected = idx;
-        selectedSSID = ssidList[selected];
+        selectedSSID = nets[selected].ssid;
         drawList();
         drawStatus(String("Selected: ") + selectedSSID);
       }
@@ -982,40 +1000,29 @@ bool wifi_app_handleTouch(bool pressed, bool lastPressed, int x, int y) {
   // ===================== CONNECT MODE =====================
   if (mode == WIFI_MODE_CONNECT) {
     if (inRect(x,y,BTN_REFRESH_X,BTN_Y,BTN_W,BTN_H)) {
-      nvsClearWifi();
-      savedSSID = "";
-      drawStatus("Saved WiFi cleared");
+      bool had = wifi_link_forget(selectedSSID.c_str());
+      savedSSID = wifi_link_savedSsid();
+      drawStatus(had ? "Saved WiFi cleared" : "Not saved");
       return true;
     }
 
     if (inRect(x,y,BTN_CONNECT_X,BTN_Y,BTN_W,BTN_H)) {
-      mode = WIFI_MODE_LIST;
-
-      drawWindowFrame("Wireless Networks");
-      drawListBox();
-
-      drawButton(BTN_REFRESH_X, BTN_Y, BTN_W, BTN_H, "Refresh");
-      drawButton(BTN_CONNECT_X, BTN_Y, BTN_W, BTN_H, "Connect");
-      drawButton(BTN_BACK_X,    BTN_Y, BTN_W, BTN_H, "Back");
-
-      if (WiFi.status() == WL_CONNECTED) {
-        drawStatus(String("Connected ✅  ") + WiFi.SSID());
-      } else if (savedSSID.length() > 0) {
-        drawStatus(String("Not connected (saved: ") + savedSSID + ")");
-      } else {
-        drawStatus("Not connected");
-      }
-
-      drawList();
+      leaveConnectScreen();
+      setLinkStatus();
+      drawListScreen();
       startScanAsync();
       return true;
     }
 
+    if (inRect(x,y, PASS_X, PASS_Y, PASS_W, PASS_H)) {
+      passField.tap(x);
+      passField.update();
+      return true;
+    }
+
     if (inRect(x,y, SEE_X, SEE_Y, SEE_W, SEE_H)) {
       passVisible = !passVisible;
-      drawButton(SEE_X, SEE_Y, SEE_W, SEE_H, passVisible ? "Hide" : "See", true);
-      delay(40);
-      drawButton(SEE_X, SEE_Y, SEE_W, SEE_H, passVisible ? "Hide" : "See", false);
+      flashButton(SEE_X, SEE_Y, SEE_W, SEE_H, passVisible ? "Hide" : "See", 40);
       redrawPassFieldOnly();
       return true;
     }
@@ -1025,3 +1032,70 @@ bool wifi_app_handleTouch(bool pressed, bool lastPressed, int x, int y) {
 
   return true;
 }
+
+const App WIFI_APP = {
+  "wifi",
+  wifi_app_open,
+  closeWindow,
+  wifi_app_handleTouch,
+  wifi_app_tick,
+  nullptr, nullptr, nullptr,
+  wifiResume
+};
+
+// ============================================================
+// Serial
+// ============================================================
+static void printScanCfg() {
+  Serial.printf("WiFi scan: every %u s%s, %s, %s\n", scanCfg.intervalS,
+                scanCfg.intervalS ? "" : " (off)", scanCfg.passive ? "passive" : "active",
+                scanCfg.channel ? (String("channel ") + scanCfg.channel).c_str() : "all channels");
+  if (netsAt) {
+    Serial.printf("           %d networks cached, %lu s old\n", countNet,
+                  (unsigned long)((millis() - netsAt) / 1000));
+  }
+  Serial.printf("           %lu background scans, %lu deferred for AI/connect\n",
+                (unsigned long)bgScans, (unsigned long)bgDeferred);
+}
+
+bool wifi_app_handleSerial(const String& line) {
+  if (line == "WIFI_SCAN") {
+    printScanCfg();
+    return true;
+  }
+
+  const String prefix = "WIFI_SCAN ";
+  if (!line.startsWith(prefix)) return false;
+
+  String rest = line.substring(prefix.length());
+  rest.trim();
+  int sp1 = rest.indexOf(' ');
+  long secs = (sp1 < 0 ? rest : rest.substring(0, sp1)).toInt();
+  String kind = "active";
+  long ch = 0;
+  if (sp1 >= 0) {
+    String more = rest.substring(sp1 + 1);
+    more.trim();
+    int sp2 = more.indexOf(' ');
+    kind = sp2 < 0 ? more : more.substring(0, sp2);
+    if (sp2 >= 0) ch = more.substring(sp2 + 1).toInt();
+  }
+
+  if (secs < 0 || secs > 3600 || ch < 0 || ch > 13 || (kind != "active" && kind != "passive")) {
+    Serial.println("Usage: WIFI_SCAN <seconds, 0 = off> [active|passive] [channel, 0 = all]");
+    return true;
+  }
+
+  scanCfg.intervalS = (uint16_t)secs;
+  nextScanAt = millis() + scanCfg.intervalS * 1000UL;
+  scanCfg.passive = kind == "passive";
+  scanCfg.channel = (uint8_t)ch;
+
+  Preferences p;
+  p.begin(SCAN_NS, false);
+  p.putBytes(SCAN_KEY, &scanCfg, sizeof(scanCfg));
+  p.end();
+
+  printScanCfg();
+  return true;
+}
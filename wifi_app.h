@@ -1,15 +1,39 @@
 #pragma once
 #include <Arduino.h>
 #include <TFT_eSPI.h>
+#include "app.h"
 
-void wifi_app_init(TFT_eSPI* display);
+// Background scan interval (WIFI_SCAN overrides, stored in NVS).
+#ifndef WIFI_SCAN_INTERVAL_S
+#define WIFI_SCAN_INTERVAL_S 120
+#endif
+
+// First background scan this long after boot.
+#ifndef WIFI_SCAN_FIRST_MS
+#define WIFI_SCAN_FIRST_MS 15000
+#endif
+
+// Opening the window rescans only if the cached list is older than this.
+#ifndef WIFI_SCAN_FRESH_MS
+#define WIFI_SCAN_FRESH_MS 30000
+#endif
 
-bool wifi_app_autoconnect(uint32_t timeoutMs = 2500);
+void wifi_app_init(TFT_eSPI* display);
 
 void wifi_app_open();
 
+// Scan retries and button feedback for the open window.
 void wifi_app_tick();
+// Advances scan, driver reset and connect steps without blocking, and
+// finishes a connect started from the window even after it closed.
+// Cheap when idle; call every loop.
+void wifi_app_poll();
 
 bool wifi_app_handleTouch(bool pressed, bool lastPressed, int x, int y);
 
 void wifi_app_forget_saved();
+
+// WIFI_SCAN [<seconds> [active|passive] [channel]]. Returns false for other lines.
+bool wifi_app_handleSerial(const String& line);
+
+extern const App WIFI_APP;
@@ -0,0 +1,570 @@
+#include "wifi_link.h"
+#include <WiFi.h>
+#include <Preferences.h>
+
+static const char* WIFI_NS   = "wifi";
+static const char* KEY_COUNT = "n";
+// single-network keys from before profiles, migrated on load
+static const char* KEY_SSID  = "ssid";
+static const char* KEY_PASS  = "pass";
+static const char* KEY_BSSID = "bssid";
+static const char* KEY_CHAN  = "ch";
+
+enum LinkState : uint8_t {
+  LINK_IDLE,   // nothing saved
+  LINK_FAST,   // joining with a known BSSID/channel
+  LINK_SCAN,   // joining by SSID, driver scans all channels
+  LINK_UP,
+  LINK_WAIT    // backing off before the next round
+};
+
+static LinkState state = LINK_IDLE;
+static bool      held  = false;
+
+static WifiProfile profiles[WIFI_LINK_MAX_PROFILES];
+static int         count = 0;
+static int         cur   = -1;   // profile in use or being tried
+
+// the round of profiles being tried, best first
+static int order[WIFI_LINK_MAX_PROFILES];
+static int roundLen = 0;
+static int roundPos = 0;
+
+// known networks from the last scan
+static WifiSeen seen[WIFI_LINK_MAX_PROFILES];
+static int      seenCount = 0;
+static uint32_t seenAt = 0;   // 0 = never
+
+// hint for the attempt in flight
+static uint8_t tryBssid[6];
+static uint8_t tryChannel = 0;
+
+static uint32_t attemptAt = 0;
+static uint32_t retryAt   = 0;
+static uint32_t backoffMs = WIFI_LINK_BACKOFF_MIN_MS;
+
+// roaming
+static const uint32_t RSSI_CHECK_MS = 2000;
+static uint32_t rssiAt   = 0;
+static int      rssiNow  = 0;
+static uint32_t lowSince = 0;   // 0 = signal fine
+
+// for WIFI
+static uint32_t lastFastMs = 0, lastScanMs = 0;
+static uint32_t fastOk = 0, fastFailed = 0, drops = 0, roams = 0;
+
+// ============================================================
+// NVS
+// ============================================================
+static void profileKey(int i, char* key)
+{
+  key[0] = 'p';
+  key[1] = (char)('0' + i);
+  key[2] = 0;
+}
+
+static void nvsSave()
+{
+  Preferences p;
+  p.begin(WIFI_NS, false);
+  p.putUChar(KEY_COUNT, (uint8_t)count);
+  for (int i = 0; i < WIFI_LINK_MAX_PROFILES; i++) {
+    char key[3];
+    profileKey(i, key);
+    if (i < count) p.putBytes(key, &profiles[i], sizeof(WifiProfile));
+    else p.remove(key);
+  }
+  p.end();
+}
+
+static void nvsMigrate()
+{
+  Preferences p;
+  p.begin(WIFI_NS, false);
+  String s = p.getString(KEY_SSID, "");
+  String pw = p.getString(KEY_PASS, "");
+  s.trim();
+  pw.trim();
+
+  if (s.length()) {
+    WifiProfile& w = profiles[0];
+    memset(&w, 0, sizeof(w));
+    strlcpy(w.ssid, s.c_str(), sizeof(w.ssid));
+    strlcpy(w.pass, pw.c_str(), sizeof(w.pass));
+    bool hint = p.getBytes(KEY_BSSID, w.bssid, sizeof(w.bssid)) == sizeof(w.bssid);
+    w.channel = hint ? p.getUChar(KEY_CHAN, 0) : 0;
+    w.priority = WIFI_LINK_DEFAULT_PRIO;
+    count = 1;
+  }
+
+  p.remove(KEY_SSID);
+  p.remove(KEY_PASS);
+  p.remove(KEY_BSSID);
+  p.remove(KEY_CHAN);
+  p.end();
+
+  if (count) {
+    Serial.printf("wifi: moved saved network %s into profile 0\n", profiles[0].ssid);
+    nvsSave();
+  }
+}
+
+static void nvsLoad()
+{
+  Preferences p;
+  p.begin(WIFI_NS, true);
+  int n = p.getUChar(KEY_COUNT, 0);
+  bool legacy = p.isKey(KEY_SSID);
+  if (n > WIFI_LINK_MAX_PROFILES) n = WIFI_LINK_MAX_PROFILES;
+
+  count = 0;
+  for (int i = 0; i < n; i++) {
+    char key[3];
+    profileKey(i, key);
+    WifiProfile& w = profiles[count];
+    if (p.getBytes(key, &w, sizeof(w)) != sizeof(w) || !w.ssid[0]) continue;
+    w.ssid[sizeof(w.ssid) - 1] = 0;
+    w.pass[sizeof(w.pass) - 1] = 0;
+    count++;
+  }
+  p.end();
+
+  if (!count && legacy) nvsMigrate();
+}
+
+static int findProfile(const char* ssid)
+{
+  for (int i = 0; i < count; i++) {
+    if (strcmp(profiles[i].ssid, ssid) == 0) return i;
+  }
+  return -1;
+}
+
+// The indices in order[] are stale afterwards, so the round ends with the
+// attempt in flight.
+static void removeProfile(int i)
+{
+  for (int k = i; k < count - 1; k++) profiles[k] = profiles[k + 1];
+  count--;
+  if (cur == i) cur = -1;
+  else if (cur > i) cur--;
+  roundLen = 0;
+  roundPos = 0;
+}
+
+// Records the AP we're on in the current profile. True if it changed.
+static bool takeHint()
+{
+  const uint8_t* b = WiFi.BSSID();
+  uint8_t ch = (uint8_t)WiFi.channel();
+  if (cur < 0 || !b || !ch) return false;
+
+  WifiProfile& w = profiles[cur];
+  if (ch == w.channel && memcmp(b, w.bssid, sizeof(w.bssid)) == 0) return false;
+  memcpy(w.bssid, b, sizeof(w.bssid));
+  w.channel = ch;
+  return true;
+}
+
+// ============================================================
+// Picking
+// ============================================================
+static bool seenFresh(uint32_t maxAge)
+{
+  return seenAt && millis() - seenAt < maxAge;
+}
+
+// Ranks the profiles. With a fresh scan only the networks in it are tried,
+// unless none are (a hidden SSID never shows up).
+static void newRound()
+{
+  int ns = seenFresh(WIFI_LINK_SEEN_MAX_MS) ? seenCount : 0;
+  wifi_rank(profiles, count, seen, ns, order);
+
+  roundLen = 0;
+  while (roundLen < count && wifi_findSeen(profiles[order[roundLen]], seen, ns) >= 0) roundLen++;
+  if (!roundLen) roundLen = count;
+  roundPos = 0;
+}
+
+// ============================================================
+// Attempts
+// ============================================================
+static void startFast()
+{
+  state = LINK_FAST;
+  attemptAt = millis();
+  const WifiProfile& w = profiles[cur];
+  Serial.printf("wifi: fast connect to %s, ch %u\n", w.ssid, tryChannel);
+  if (WiFi.status() == WL_CONNECTED) WiFi.disconnect(false);   // roaming
+  WiFi.begin(w.ssid, w.pass[0] ? w.pass : nullptr, tryChannel, tryBssid);
+}
+
+// A roam starts while still associated; until the driver has let go, the
+// status is the old AP's.
+static bool onTryBssid()
+{
+  const uint8_t* b = WiFi.BSSID();
+  return b && memcmp(b, tryBssid, sizeof(tryBssid)) == 0;
+}
+
+static void startScan()
+{
+  state = LINK_SCAN;
+  attemptAt = millis();
+  const WifiProfile& w = profiles[cur];
+  Serial.printf("wifi: connect to %s (full scan)\n", w.ssid);
+  WiFi.disconnect(false);
+  WiFi.begin(w.ssid, w.pass[0] ? w.pass : nullptr);
+}
+
+// Joins profile i, on the AP the last scan saw if there is one, else on
+// the one it last used.
+static void startAttempt(int i)
+{
+  cur = i;
+  const WifiProfile& w = profiles[i];
+  int s = seenFresh(WIFI_LINK_SEEN_MAX_MS) ? wifi_findSeen(w, seen, seenCount) : -1;
+
+  if (s >= 0) {
+    memcpy(tryBssid, seen[s].bssid, sizeof(tryBssid));
+    tryChannel = seen[s].channel;
+  } else {
+    memcpy(tryBssid, w.bssid, sizeof(tryBssid));
+    tryChannel = w.channel;
+  }
+
+  if (tryChannel) startFast();
+  else startScan();
+}
+
+static void waitRetry()
+{
+  state = LINK_WAIT;
+  retryAt = millis() + backoffMs;
+  Serial.printf("wifi: retry in %lu ms\n", (unsigned long)backoffMs);
+  backoffMs = min(backoffMs * 2, (uint32_t)WIFI_LINK_BACKOFF_MAX_MS);
+}
+
+static void startRound()
+{
+  newRound();
+  startAttempt(order[0]);
+}
+
+// cur failed; on to the next candidate, or back off once all have had a go.
+static void attemptFailed()
+{
+  WifiProfile& w = profiles[cur];
+  if (w.failCount < 0xFFFF) w.failCount++;
+
+  if (++roundPos < roundLen) startAttempt(order[roundPos]);
+  else waitRetry();
+}
+
+static void linkUp(bool fast)
+{
+  uint32_t ms = millis() - attemptAt;
+  if (fast) { lastFastMs = ms; fastOk++; }
+  else lastScanMs = ms;
+
+  WifiProfile& w = profiles[cur];
+  Serial.printf("wifi: connected to %s in %lu ms (%s)\n", w.ssid, (unsigned long)ms,
+                fast ? "fast" : "scan");
+
+  if (w.okCount < 0xFFFF) w.okCount++;
+  takeHint();
+  nvsSave();
+
+  state = LINK_UP;
+  backoffMs = WIFI_LINK_BACKOFF_MIN_MS;
+  lowSince = 0;
+  rssiAt = millis();
+}
+
+// Samples RSSI while up; once it has been low for a while and a fresh scan
+// shows a known AP clearly stronger than ours, moves to it.
+static void checkRoam()
+{
+  if (millis() - rssiAt < RSSI_CHECK_MS) return;
+  rssiAt = millis();
+  rssiNow = WiFi.RSSI();
+
+  if (rssiNow >= WIFI_ROAM_RSSI) { lowSince = 0; return; }
+  if (!lowSince) { lowSince = millis(); return; }
+  if (!seenFresh(WIFI_ROAM_HOLD_MS)) return;   // wifi_link_wantsScan() asks for one
+
+  newRound();
+  int best = order[0];
+  int s = wifi_findSeen(profiles[best], seen, seenCount);
+  if (s < 0) return;
+
+  const uint8_t* b = WiFi.BSSID();
+  if (best == cur && b && memcmp(b, seen[s].bssid, 6) == 0) return;
+  if (!wifi_shouldRoam(rssiNow, millis() - lowSince, seen[s].rssi)) return;
+
+  roams++;
+  Serial.printf("wifi: roaming from %s (%d dBm) to %s (%d dBm)\n", profiles[cur].ssid,
+                rssiNow, seen[s].ssid, seen[s].rssi);
+  lowSince = 0;
+  startAttempt(best);
+}
+
+// ============================================================
+// Public
+// ============================================================
+bool wifi_link_begin()
+{
+  WiFi.persistent(false);        // credentials live in our namespace
+  WiFi.mode(WIFI_STA);
+  WiFi.setSleep(false);
+  WiFi.setAutoReconnect(false);  // reconnects are ours, with backoff
+
+  nvsLoad();
+  if (!count) {
+    state = LINK_IDLE;
+    return false;
+  }
+
+  startRound();
+  return true;
+}
+
+void wifi_link_tick()
+{
+  if (held || state == LINK_IDLE) return;
+
+  wl_status_t st = WiFi.status();
+  bool failed = st == WL_CONNECT_FAILED || st == WL_NO_SSID_AVAIL;
+
+  switch (state) {
+    case LINK_FAST:
+      if (st == WL_CONNECTED && onTryBssid()) { linkUp(true); break; }
+      if (failed || millis() - attemptAt > WIFI_LINK_FAST_TIMEOUT_MS) {
+        fastFailed++;
+        Serial.printf("wifi: fast connect failed after %lu ms\n",
+                      (unsigned long)(millis() - attemptAt));
+        startScan();
+      }
+      break;
+
+    case LINK_SCAN:
+      if (st == WL_CONNECTED) { linkUp(false); break; }
+      if (failed || millis() - attemptAt > WIFI_LINK_SCAN_TIMEOUT_MS) {
+        Serial.printf("wifi: connect to %s failed\n", profiles[cur].ssid);
+        attemptFailed();
+      }
+      break;
+
+    case LINK_UP:
+      if (st != WL_CONNECTED) {
+        drops++;
+        Serial.println("wifi: link lost");
+        waitRetry();
+        break;
+      }
+      checkRoam();
+      break;
+
+    case LINK_WAIT:
+      if ((int32_t)(millis() - retryAt) >= 0) startRound();
+      break;
+
+    default:
+      break;
+  }
+}
+
+const char* wifi_link_savedSsid()
+{
+  if (cur >= 0) return profiles[cur].ssid;
+  if (!count) return "";
+
+  int ranked[WIFI_LINK_MAX_PROFILES];
+  wifi_rank(profiles, count, seen, seenFresh(WIFI_LINK_SEEN_MAX_MS) ? seenCount : 0, ranked);
+  return profiles[ranked[0]].ssid;
+}
+
+bool wifi_link_busy()
+{
+  return !held && (state == LINK_FAST || state == LINK_SCAN);
+}
+
+bool wifi_link_wantsScan()
+{
+  return !held && state == LINK_UP && lowSince && !seenFresh(WIFI_ROAM_HOLD_MS);
+}
+
+void wifi_link_scanBegin()
+{
+  seenCount = 0;
+  seenAt = millis();
+}
+
+void wifi_link_scanSeen(const char* ssid, int rssi, uint8_t channel, const uint8_t* bssid)
+{
+  if (seenCount >= WIFI_LINK_MAX_PROFILES || findProfile(ssid) < 0) return;
+
+  WifiSeen& s = seen[seenCount++];
+  strlcpy(s.ssid, ssid, sizeof(s.ssid));
+  s.rssi = (int8_t)rssi;
+  s.channel = channel;
+  memcpy(s.bssid, bssid, sizeof(s.bssid));
+}
+
+void wifi_link_hold(bool on)
+{
+  if (held == on) return;
+  held = on;
+  if (held || !count) return;
+
+  // back in charge: pick up where the app left the radio
+  if (WiFi.status() == WL_CONNECTED && cur >= 0) {
+    state = LINK_UP;
+  } else {
+    state = LINK_WAIT;
+    retryAt = millis();
+  }
+}
+
+void wifi_link_save(const char* newSsid, const char* newPass)
+{
+  int i = findProfile(newSsid);
+  if (i < 0) {
+    if (count == WIFI_LINK_MAX_PROFILES) {
+      // full: the lowest priority goes, the least used among those
+      int drop = 0;
+      for (int k = 1; k < count; k++) {
+        const WifiProfile& a = profiles[k];
+        const WifiProfile& d = profiles[drop];
+        if (a.priority < d.priority || (a.priority == d.priority && a.okCount < d.okCount)) drop = k;
+      }
+      Serial.printf("wifi: profiles full, dropping %s\n", profiles[drop].ssid);
+      removeProfile(drop);
+    }
+
+    i = count++;
+    memset(&profiles[i], 0, sizeof(WifiProfile));
+    strlcpy(profiles[i].ssid, newSsid, sizeof(profiles[i].ssid));
+    profiles[i].priority = WIFI_LINK_DEFAULT_PRIO;
+  }
+
+  strlcpy(profiles[i].pass, newPass, sizeof(profiles[i].pass));
+  cur = i;
+  if (profiles[i].okCount < 0xFFFF) profiles[i].okCount++;
+  takeHint();
+  nvsSave();
+
+  held = false;
+  state = LINK_UP;
+  backoffMs = WIFI_LINK_BACKOFF_MIN_MS;
+  lowSince = 0;
+}
+
+bool wifi_link_forget(const char* ssid)
+{
+  int i = findProfile(ssid);
+  if (i < 0) return false;
+
+  bool inUse = i == cur;
+  removeProfile(i);
+  nvsSave();
+
+  if (!inUse) return true;
+  WiFi.disconnect(false);
+  if (!count) {
+    state = LINK_IDLE;
+  } else if (!held) {
+    state = LINK_WAIT;
+    retryAt = millis();
+  }
+  return true;
+}
+
+void wifi_link_forgetAll()
+{
+  count = 0;
+  cur = -1;
+  nvsSave();
+
+  state = LINK_IDLE;
+  WiFi.disconnect(true);
+}
+
+// ============================================================
+// Serial
+// ============================================================
+static void printProfiles()
+{
+  static const char* names[] = { "idle", "fast connect", "scan connect", "up", "waiting" };
+  if (!count) {
+    Serial.println("WiFi: nothing saved");
+    return;
+  }
+
+  Serial.printf("WiFi: %s, %s%s\n", cur >= 0 ? profiles[cur].ssid : "-", names[state],
+                held ? " (held by the WiFi app)" : "");
+  if (state == LINK_UP) {
+    Serial.printf("      rssi %d dBm%s\n", rssiNow, lowSince ? ", weak" : "");
+  }
+
+  int ranked[WIFI_LINK_MAX_PROFILES];
+  int ns = seenFresh(WIFI_LINK_SEEN_MAX_MS) ? seenCount : 0;
+  wifi_rank(profiles, count, seen, ns, ranked);
+  for (int k = 0; k < count; k++) {
+    const WifiProfile& w = profiles[ranked[k]];
+    int s = wifi_findSeen(w, seen, ns);
+    Serial.printf("  %d. %-20s prio %u, ok %u, failed %u", k + 1, w.ssid, w.priority,
+                  w.okCount, w.failCount);
+    if (s >= 0) Serial.printf(", seen %d dBm", seen[s].rssi);
+    if (w.channel) {
+      Serial.printf(", hint %02X:%02X:%02X:%02X:%02X:%02X ch %u",
+                    w.bssid[0], w.bssid[1], w.bssid[2], w.bssid[3], w.bssid[4], w.bssid[5],
+                    w.channel);
+    }
+    Serial.println();
+  }
+
+  Serial.printf("      last connect: fast %lu ms, scan %lu ms\n",
+                (unsigned long)lastFastMs, (unsigned long)lastScanMs);
+  Serial.printf("      fast ok %lu, fast failed %lu, link drops %lu, roams %lu\n",
+                (unsigned long)fastOk, (unsigned long)fastFailed, (unsigned long)drops,
+                (unsigned long)roams);
+}
+
+bool wifi_link_handleSerial(const String& line)
+{
+  if (line == "WIFI") {
+    printProfiles();
+    return true;
+  }
+
+  if (line.startsWith("WIFI_FORGET ")) {
+    String ssid = line.substring(12);
+    ssid.trim();
+    Serial.println(wifi_link_forget(ssid.c_str()) ? "WiFi profile removed" : "No such WiFi profile");
+    return true;
+  }
+
+  if (line.startsWith("WIFI_PRIO ")) {
+    // the SSID may contain spaces; the priority is the last word
+    String rest = line.substring(10);
+    rest.trim();
+    int sp = rest.lastIndexOf(' ');
+    String ssid = sp > 0 ? rest.substring(0, sp) : "";
+    int prio = sp > 0 ? rest.substring(sp + 1).toInt() : -1;
+    ssid.trim();
+
+    int i = findProfile(ssid.c_str());
+    if (i < 0 || prio < 0 || prio > 9) {
+      Serial.println("Usage: WIFI_PRIO <ssid> <0-9> (saved networks only)");
+      return true;
+    }
+    profiles[i].priority = (uint8_t)prio;
+    nvsSave();
+    Serial.printf("WiFi: %s priority %d\n", profiles[i].ssid, prio);
+    return true;
+  }
+
+  return false;
+}
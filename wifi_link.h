@@ -0,0 +1,66 @@
+#pragma once
+#include <Arduino.h>
+#include "wifi_pick.h"
+
+// Keeps the station on one of the saved networks. Each profile stores the
+// last BSSID and channel so a reconnect can skip the channel scan; if that
+// fails it falls back to a full scan, then to the next profile, and after a
+// link loss it retries with backoff. Which profile to try comes from
+// wifi_rank() over the latest background scan, and a link that stays weak
+// roams to a clearly stronger known AP.
+
+#ifndef WIFI_LINK_FAST_TIMEOUT_MS
+#define WIFI_LINK_FAST_TIMEOUT_MS 4000
+#endif
+
+#ifndef WIFI_LINK_SCAN_TIMEOUT_MS
+#define WIFI_LINK_SCAN_TIMEOUT_MS 15000
+#endif
+
+#ifndef WIFI_LINK_BACKOFF_MIN_MS
+#define WIFI_LINK_BACKOFF_MIN_MS 1000
+#endif
+
+#ifndef WIFI_LINK_BACKOFF_MAX_MS
+#define WIFI_LINK_BACKOFF_MAX_MS 60000
+#endif
+
+// Scan results older than this are not used to pick a network.
+#ifndef WIFI_LINK_SEEN_MAX_MS
+#define WIFI_LINK_SEEN_MAX_MS 300000
+#endif
+
+// Priority given to a network joined from the Wi-Fi app (0..9).
+#ifndef WIFI_LINK_DEFAULT_PRIO
+#define WIFI_LINK_DEFAULT_PRIO 5
+#endif
+
+// Loads the saved networks and starts joining the best one; returns at once.
+// False if nothing is saved.
+bool wifi_link_begin();
+// Call every loop().
+void wifi_link_tick();
+
+// The network in use or being tried, else the best saved one; "" if none.
+const char* wifi_link_savedSsid();
+// A connect or reconnect is in progress (scans would fail meanwhile).
+bool wifi_link_busy();
+// The link is weak and a fresh scan would let it decide whether to roam.
+bool wifi_link_wantsScan();
+
+// A scan finished: scanBegin(), then scanSeen() for each SSID's strongest AP.
+void wifi_link_scanBegin();
+void wifi_link_scanSeen(const char* ssid, int rssi, uint8_t channel, const uint8_t* bssid);
+
+// Stop managing the radio while the Wi-Fi app runs its own connect.
+void wifi_link_hold(bool on);
+// The station just joined ssid: save it as a profile, with the BSSID and
+// channel in use.
+void wifi_link_save(const char* ssid, const char* pass);
+// Drops one profile; false if ssid isn't saved.
+bool wifi_link_forget(const char* ssid);
+void wifi_link_forgetAll();
+
+// WIFI prints the profiles and connect stats, WIFI_PRIO <ssid> <0-9> and
+// WIFI_FORGET <ssid> edit them. Returns false for other lines.
+bool wifi_link_handleSerial(const String& line);
@@ -0,0 +1,563 @@
+#include "wifi_mon.h"
+#include "wifi_link.h"
+#include "ai_client.h"
+#include "ai_backends.h"
+#include "ai_http.h"
+#include <WiFi.h>
+#include <Preferences.h>
+#include <lwip/sockets.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+
+static const char* MON_NS    = "wifi";
+static const char* KEY_PROBE = "probe";
+
+static const uint32_t DNS_REFRESH_MS  = 600000;
+static const uint32_t DNS_TIMEOUT_MS  = 5000;
+static const uint32_t TPUT_TIMEOUT_MS = 10000;
+static const int      QUALITY_N       = 6;       // samples behind wifi_mon_quality()
+
+static LinkSample ring[WIFI_MON_SAMPLES];
+static int        ringHead  = 0;   // next slot
+static int        ringCount = 0;
+static uint32_t   seq = 0;
+
+static volatile LinkQuality quality = LINK_Q_UNKNOWN;
+
+enum ProbeStep : uint8_t {
+  PROBE_IDLE,
+  PROBE_GW,             // TCP connect to the gateway
+  PROBE_EP_DNS,         // resolving the AI endpoint
+  PROBE_EP,             // TCP connect to the AI endpoint
+  PROBE_TPUT_DNS,
+  PROBE_TPUT_CONNECT,
+  PROBE_TPUT_READ
+};
+
+static ProbeStep  step = PROBE_IDLE;
+static int        sock = -1;
+static uint32_t   probeAt = 0;
+static LinkSample pending;
+static uint32_t   sampleAt = 0;
+static uint32_t   samples  = 0;
+static bool       gwAnswers = false;   // until the gateway answers once, silence isn't loss
+static uint32_t   lastTickAt = 0;
+
+// AI endpoint, resolved now and then off the request path
+static IPAddress epIp;
+static uint16_t  epPort = 0;
+static uint16_t  epLookupPort = 0;
+static uint32_t  epResolvedAt = 0;
+
+// throughput
+static char      probeUrl[112] = "";
+static HttpUrl   probe;
+static IPAddress probeIp;
+static uint32_t  tputAt = 0;
+static uint32_t  tputFirstAt = 0;
+static uint32_t  tputBytes = 0;
+static volatile uint32_t tputBps = 0;
+static volatile uint32_t tputDoneAt = 0;
+static volatile bool     tputFromAi = false;
+
+// ============================================================
+// Ring
+// ============================================================
+static void push(const LinkSample& s)
+{
+  ring[ringHead] = s;
+  ringHead = (ringHead + 1) % WIFI_MON_SAMPLES;
+  if (ringCount < WIFI_MON_SAMPLES) ringCount++;
+  seq++;
+}
+
+bool wifi_mon_sample(int age, LinkSample& out)
+{
+  if (age < 0 || age >= ringCount) return false;
+  out = ring[(ringHead - 1 - age + WIFI_MON_SAMPLES) % WIFI_MON_SAMPLES];
+  return true;
+}
+
+uint32_t wifi_mon_seq() { return seq; }
+
+static uint16_t median(uint16_t* v, int n)
+{
+  for (int i = 1; i < n; i++) {
+    uint16_t x = v[i];
+    int j = i - 1;
+    while (j >= 0 && v[j] > x) { v[j + 1] = v[j]; j--; }
+    v[j + 1] = x;
+  }
+  return v[n / 2];
+}
+
+// Over the last QUALITY_N samples: mean RSSI, gateway loss and median RTT,
+// and the newest endpoint RTT.
+static LinkQuality grade()
+{
+  int n = ringCount < QUALITY_N ? ringCount : QUALITY_N;
+  if (n == 0) return LINK_Q_UNKNOWN;
+
+  int rssiSum = 0, lost = 0, nRtt = 0;
+  uint16_t rtts[QUALITY_N];
+  uint16_t ep = LINK_RTT_NONE;
+
+  for (int a = 0; a < n; a++) {
+    LinkSample s;
+    wifi_mon_sample(a, s);
+    rssiSum += s.rssi;
+    if (s.gwRttMs == LINK_RTT_LOST) lost++;
+    else if (s.gwRttMs != LINK_RTT_NONE) rtts[nRtt++] = s.gwRttMs;
+    if (ep == LINK_RTT_NONE && s.epRttMs != LINK_RTT_NONE) ep = s.epRttMs;
+  }
+
+  int rssi = rssiSum / n;
+  int lossPct = 100 * lost / n;
+  uint16_t gw = nRtt ? median(rtts, nRtt) : 0;
+  uint16_t epMs = ep == LINK_RTT_LOST ? 0xFFFF : (ep == LINK_RTT_NONE ? 0 : ep);
+
+  if (rssi < -80 || lossPct >= 30 || gw > 200 || epMs > 1500) return LINK_Q_POOR;
+  if (rssi < -70 || lossPct > 0 || gw > 50 || epMs > 400) return LINK_Q_FAIR;
+  return LINK_Q_GOOD;
+}
+
+// ============================================================
+// DNS
+// ============================================================
+// One lookup at a time, answered by lwIP on its own task. A lookup that was
+// dropped bumps the generation so its late answer is ignored.
+enum DnsState : uint8_t { DNS_IDLE, DNS_WAIT, DNS_OK, DNS_FAILED };
+
+static volatile uint8_t  dnsState = DNS_IDLE;
+static volatile uint32_t dnsAddr  = 0;
+static volatile uint32_t dnsGen   = 0;
+static uint32_t          dnsAt    = 0;
+
+static void dnsFound(const char*, const ip_addr_t* ip, void* arg)
+{
+  if ((uint32_t)(uintptr_t)arg != dnsGen || dnsState != DNS_WAIT) return;
+  if (ip) dnsAddr = ip4_addr_get_u32(ip_2_ip4(ip));
+  dnsState = ip ? DNS_OK : DNS_FAILED;
+}
+
+static void dnsStart(const char* host)
+{
+  dnsGen++;
+  dnsAt = millis();
+  dnsState = DNS_WAIT;
+
+  ip_addr_t ip;
+#if LWIP_TCPIP_CORE_LOCKING
+  LOCK_TCPIP_CORE();
+#endif
+  err_t e = dns_gethostbyname(host, &ip, dnsFound, (void*)(uintptr_t)dnsGen);
+#if LWIP_TCPIP_CORE_LOCKING
+  UNLOCK_TCPIP_CORE();
+#endif
+
+  if (e == ERR_OK) {   // cached, or a literal address
+    dnsAddr = ip4_addr_get_u32(ip_2_ip4(&ip));
+    dnsState = DNS_OK;
+  } else if (e != ERR_INPROGRESS) {
+    dnsState = DNS_FAILED;
+  }
+}
+
+static void dnsCancel()
+{
+  dnsGen++;
+  dnsState = DNS_IDLE;
+}
+
+// DNS_WAIT until there is an answer or the lookup timed out; then the
+// result once, with out set on DNS_OK.
+static uint8_t dnsPoll(IPAddress& out)
+{
+  uint8_t st = dnsState;
+  if (st == DNS_WAIT && millis() - dnsAt > DNS_TIMEOUT_MS) st = DNS_FAILED;
+  if (st == DNS_WAIT) return st;
+  if (st == DNS_OK) out = IPAddress((uint32_t)dnsAddr);
+  dnsCancel();
+  return st;
+}
+
+// ============================================================
+// Probes
+// ============================================================
+static void closeSock()
+{
+  if (sock >= 0) close(sock);
+  sock = -1;
+}
+
+static bool openSock(const IPAddress& ip, uint16_t port)
+{
+  closeSock();
+  sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock < 0) return false;
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = (uint32_t)ip;
+
+  probeAt = millis();
+  if (connect(sock, (struct sockaddr*)&sa, sizeof(sa)) < 0 && errno != EINPROGRESS) {
+    closeSock();
+    return false;
+  }
+  return true;
+}
+
+// 1 accepted, 2 refused (still an answer, so still a round trip), 0 still
+// waiting, -1 nothing.
+static int pollConnect()
+{
+  fd_set w;
+  FD_ZERO(&w);
+  FD_SET(sock, &w);
+  struct timeval tv = { 0, 0 };
+
+  int n = select(sock + 1, nullptr, &w, nullptr, &tv);
+  if (n == 0) return millis() - probeAt > WIFI_MON_PROBE_TIMEOUT_MS ? -1 : 0;
+  if (n < 0) return -1;
+
+  int err = 0;
+  socklen_t len = sizeof(err);
+  getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+  if (err == 0) return 1;
+  return err == ECONNREFUSED ? 2 : -1;
+}
+
+static void startSample()
+{
+  sampleAt = millis();
+  samples++;
+  pending.rssi = (int8_t)WiFi.RSSI();
+  pending.gwRttMs = LINK_RTT_NONE;
+  pending.epRttMs = LINK_RTT_NONE;
+
+  step = PROBE_GW;
+  if (!openSock(WiFi.gatewayIP(), WIFI_MON_GW_PORT)) pending.gwRttMs = LINK_RTT_LOST;
+}
+
+static void finishSample()
+{
+  closeSock();
+  step = PROBE_IDLE;
+  push(pending);
+  quality = grade();
+}
+
+static void openEndpoint()
+{
+  step = PROBE_EP;
+  if (!openSock(epIp, epPort)) { pending.epRttMs = LINK_RTT_LOST; finishSample(); }
+}
+
+// The preferred backend's host is looked up again every DNS_REFRESH_MS.
+static void startEndpoint()
+{
+  if (epResolvedAt && millis() - epResolvedAt < DNS_REFRESH_MS) {
+    if (epPort) openEndpoint();
+    else finishSample();
+    return;
+  }
+
+  epResolvedAt = millis();
+  int order[AI_MAX_BACKENDS];
+  HttpUrl url;
+  if (ai_backends_order(order, AI_MAX_BACKENDS) == 0 ||
+      !http_parseUrl(ai_backends_get(order[0]).url, url)) {
+    epPort = 0;
+    finishSample();
+    return;
+  }
+  epLookupPort = url.port;
+  dnsStart(url.host);
+  step = PROBE_EP_DNS;
+}
+
+static bool tputDue()
+{
+  if (!probeUrl[0] || ai_busy()) return false;
+  return !tputAt || millis() - tputAt >= WIFI_MON_TPUT_S * 1000UL;
+}
+
+static void startTput()
+{
+  tputAt = millis();
+  dnsStart(probe.host);
+  step = PROBE_TPUT_DNS;
+}
+
+static void connectTput()
+{
+  uint8_t r = dnsPoll(probeIp);
+  if (r == DNS_WAIT) return;
+  if (r != DNS_OK || !openSock(probeIp, probe.port)) {
+    Serial.printf("link: throughput probe to %s failed\n", probe.host);
+    closeSock();
+    step = PROBE_IDLE;
+    return;
+  }
+  step = PROBE_TPUT_CONNECT;
+}
+
+static void tputFinished(bool ok)
+{
+  uint32_t ms = millis() - tputFirstAt;
+  closeSock();
+  step = PROBE_IDLE;
+  if (!ok || tputBytes < 1024 || !ms) {
+    Serial.printf("link: throughput probe got %lu bytes, ignored\n", (unsigned long)tputBytes);
+    return;
+  }
+  tputBps = (uint32_t)((uint64_t)tputBytes * 1000 / ms);
+  tputDoneAt = millis();
+  tputFromAi = false;
+}
+
+// Reads what's there without waiting, at most a few KB per loop.
+static void pollTputRead()
+{
+  static uint8_t buf[512];
+  for (int k = 0; k < 8; k++) {
+    int n = recv(sock, buf, sizeof(buf), 0);
+    if (n > 0) {
+      if (!tputFirstAt) tputFirstAt = millis();
+      tputBytes += n;
+      if (tputBytes >= WIFI_MON_TPUT_BYTES) { tputFinished(true); return; }
+      continue;
+    }
+    if (n == 0) { tputFinished(true); return; }   // server closed: done
+    if (errno != EWOULDBLOCK && errno != EAGAIN) { tputFinished(false); return; }
+    break;
+  }
+  if (millis() - tputAt > TPUT_TIMEOUT_MS) tputFinished(tputBytes > 0);
+}
+
+static void sendTputRequest()
+{
+  char req[200];
+  int n = snprintf(req, sizeof(req), "GET %s HTTP/1.0\r\nHost: %s\r\nConnection: close\r\n\r\n",
+                   probe.path, probe.host);
+  if (n <= 0 || n >= (int)sizeof(req) || send(sock, req, n, 0) != n) {
+    tputFinished(false);
+    return;
+  }
+  tputBytes = 0;
+  tputFirstAt = 0;
+  step = PROBE_TPUT_READ;
+}
+
+static void setProbe(const char* url)
+{
+  HttpUrl u;
+  if (!url[0] || !http_parseUrl(url, u) || u.tls) {
+    probeUrl[0] = 0;
+    return;
+  }
+  probe = u;
+  strlcpy(probeUrl, url, sizeof(probeUrl));
+  tputAt = 0;
+}
+
+// ============================================================
+// Public
+// ============================================================
+void wifi_mon_begin()
+{
+  Preferences p;
+  p.begin(MON_NS, true);
+  String url = p.getString(KEY_PROBE, "");
+  p.end();
+  setProbe(url.c_str());
+}
+
+void wifi_mon_tick()
+{
+  if (WiFi.status() != WL_CONNECTED || wifi_link_busy()) {
+    if (step != PROBE_IDLE) {
+      closeSock();
+      dnsCancel();
+      step = PROBE_IDLE;
+    }
+    if (WiFi.status() != WL_CONNECTED) quality = LINK_Q_DOWN;
+    return;
+  }
+  if (quality == LINK_Q_DOWN) quality = grade();
+
+  // ticks stopped for a while (screen off, a stall): an answer that came in
+  // meanwhile would be timed wrong, so the probe is dropped
+  bool gap = millis() - lastTickAt > 250;
+  lastTickAt = millis();
+  if (gap && step != PROBE_IDLE) {
+    closeSock();
+    dnsCancel();
+    step = PROBE_IDLE;
+  }
+
+  switch (step) {
+    case PROBE_IDLE:
+      if (millis() - sampleAt >= WIFI_MON_SAMPLE_MS) startSample();
+      else if (tputDue()) startTput();
+      break;
+
+    case PROBE_GW: {
+      int r = pending.gwRttMs == LINK_RTT_LOST ? -1 : pollConnect();
+      if (r == 0) break;
+      if (r > 0) {
+        pending.gwRttMs = (uint16_t)(millis() - probeAt);
+        gwAnswers = true;
+      } else {
+        pending.gwRttMs = gwAnswers ? LINK_RTT_LOST : LINK_RTT_NONE;
+      }
+
+      if (samples % WIFI_MON_EP_EVERY == 1) startEndpoint();
+      else finishSample();
+      break;
+    }
+
+    case PROBE_EP_DNS: {
+      IPAddress ip;
+      uint8_t r = dnsPoll(ip);
+      if (r == DNS_WAIT) break;
+      if (r == DNS_OK) {
+        epIp = ip;
+        epPort = epLookupPort;
+        openEndpoint();
+      } else {
+        epPort = 0;
+        finishSample();
+      }
+      break;
+    }
+
+    case PROBE_EP: {
+      int r = pollConnect();
+      if (r == 0) break;
+      pending.epRttMs = r > 0 ? (uint16_t)(millis() - probeAt) : LINK_RTT_LOST;
+      finishSample();
+      break;
+    }
+
+    case PROBE_TPUT_DNS:
+      connectTput();
+      break;
+
+    case PROBE_TPUT_CONNECT: {
+      int r = pollConnect();
+      if (r == 0) break;
+      if (r == 1) sendTputRequest();
+      else tputFinished(false);
+      break;
+    }
+
+    case PROBE_TPUT_READ:
+      pollTputRead();
+      break;
+  }
+}
+
+LinkQuality wifi_mon_quality() { return quality; }
+
+const char* wifi_mon_qualityName(LinkQuality q)
+{
+  static const char* names[] = { "unknown", "good", "fair", "poor", "down" };
+  return q <= LINK_Q_DOWN ? names[q] : "?";
+}
+
+void wifi_mon_noteTransfer(uint32_t bytes, uint32_t ms)
+{
+  // a few hundred bytes say more about latency than bandwidth
+  if (bytes < 1024 || !ms) return;
+  tputBps = (uint32_t)((uint64_t)bytes * 1000 / ms);
+  tputDoneAt = millis();
+  tputFromAi = true;
+}
+
+// ============================================================
+// Serial
+// ============================================================
+static void printRtt(const char* label, uint16_t ms)
+{
+  if (ms == LINK_RTT_NONE) return;
+  if (ms == LINK_RTT_LOST) Serial.printf(", %s lost", label);
+  else Serial.printf(", %s %u ms", label, ms);
+}
+
+static void printStats()
+{
+  Serial.printf("Link: %s, %d samples every %lu ms\n", wifi_mon_qualityName(quality), ringCount,
+                (unsigned long)WIFI_MON_SAMPLE_MS);
+
+  LinkSample s;
+  if (wifi_mon_sample(0, s)) {
+    Serial.printf("      now rssi %d dBm", s.rssi);
+    printRtt("gateway", s.gwRttMs);
+    printRtt("endpoint", s.epRttMs);
+    Serial.println();
+  }
+
+  // min/median/max over the whole ring
+  uint16_t gw[WIFI_MON_SAMPLES], ep[WIFI_MON_SAMPLES];
+  int nGw = 0, nEp = 0, lost = 0, probed = 0;
+  int rssiMin = 0, rssiMax = -128;
+  for (int a = 0; wifi_mon_sample(a, s); a++) {
+    if (s.rssi < rssiMin) rssiMin = s.rssi;
+    if (s.rssi > rssiMax) rssiMax = s.rssi;
+    if (s.gwRttMs != LINK_RTT_NONE) probed++;
+    if (s.gwRttMs == LINK_RTT_LOST) lost++;
+    else if (s.gwRttMs != LINK_RTT_NONE) gw[nGw++] = s.gwRttMs;
+    if (s.epRttMs < LINK_RTT_LOST) ep[nEp++] = s.epRttMs;
+  }
+  if (ringCount) Serial.printf("      rssi %d..%d dBm\n", rssiMin, rssiMax);
+  if (nGw) {
+    uint16_t med = median(gw, nGw);
+    Serial.printf("      gateway rtt %u/%u/%u ms min/med/max, %d/%d lost\n",
+                  gw[0], med, gw[nGw - 1], lost, probed);
+  }
+  if (nEp) {
+    uint16_t med = median(ep, nEp);
+    Serial.printf("      endpoint rtt %u/%u/%u ms min/med/max\n", ep[0], med, ep[nEp - 1]);
+  }
+
+  if (tputDoneAt) {
+    Serial.printf("      throughput %lu B/s (%s, %lu s ago)\n", (unsigned long)tputBps,
+                  tputFromAi ? "AI reply" : "probe",
+                  (unsigned long)((millis() - tputDoneAt) / 1000));
+  }
+  Serial.printf("      probe url: %s\n", probeUrl[0] ? probeUrl : "off");
+}
+
+bool wifi_mon_handleSerial(const String& line)
+{
+  if (line == "LINK") {
+    printStats();
+    return true;
+  }
+
+  const String prefix = "LINK_PROBE ";
+  if (!line.startsWith(prefix)) return false;
+
+  String url = line.substring(prefix.length());
+  url.trim();
+  if (url == "off") url = "";
+
+  setProbe(url.c_str());
+  if (url.length() && !probeUrl[0]) {
+    Serial.println("Usage: LINK_PROBE <http://host/path>|off (plain http only)");
+    return true;
+  }
+
+  Preferences p;
+  p.begin(MON_NS, false);
+  if (probeUrl[0]) p.putString(KEY_PROBE, probeUrl);
+  else p.remove(KEY_PROBE);
+  p.end();
+  Serial.printf("Link probe: %s\n", probeUrl[0] ? probeUrl : "off");
+  return true;
+}
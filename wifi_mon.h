@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>
+
+// Link-quality monitor. While the station is up it samples RSSI and the TCP
+// connect time to the gateway and, less often, to the preferred AI endpoint,
+// into a ring buffer. Probes are non-blocking sockets and DNS lookups
+// stepped from wifi_mon_tick(). Throughput comes from AI replies and, if a probe URL is
+// set, from a periodic small plain-HTTP download.
+
+#ifndef WIFI_MON_SAMPLE_MS
+#define WIFI_MON_SAMPLE_MS 5000
+#endif
+
+// Ring length; 60 x 5 s = the last five minutes.
+#ifndef WIFI_MON_SAMPLES
+#define WIFI_MON_SAMPLES 60
+#endif
+
+// Endpoint RTT every Nth sample.
+#ifndef WIFI_MON_EP_EVERY
+#define WIFI_MON_EP_EVERY 6
+#endif
+
+#ifndef WIFI_MON_PROBE_TIMEOUT_MS
+#define WIFI_MON_PROBE_TIMEOUT_MS 1500
+#endif
+
+// Gateway port for the RTT probe; a refused connect is an answer too.
+#ifndef WIFI_MON_GW_PORT
+#define WIFI_MON_GW_PORT 53
+#endif
+
+#ifndef WIFI_MON_TPUT_S
+#define WIFI_MON_TPUT_S 600
+#endif
+
+#ifndef WIFI_MON_TPUT_BYTES
+#define WIFI_MON_TPUT_BYTES 32768
+#endif
+
+static const uint16_t LINK_RTT_NONE = 0xFFFF;   // not probed
+static const uint16_t LINK_RTT_LOST = 0xFFFE;   // probed, no answer
+
+struct LinkSample {
+  int8_t   rssi;
+  uint16_t gwRttMs;
+  uint16_t epRttMs;
+};
+
+enum LinkQuality : uint8_t {
+  LINK_Q_UNKNOWN,   // no samples yet
+  LINK_Q_GOOD,
+  LINK_Q_FAIR,
+  LINK_Q_POOR,
+  LINK_Q_DOWN
+};
+
+void wifi_mon_begin();
+// Call every loop().
+void wifi_mon_tick();
+
+// Safe to call from the AI worker task.
+LinkQuality wifi_mon_quality();
+const char* wifi_mon_qualityName(LinkQuality q);
+
+// age 0 is the newest sample. False past the oldest one.
+bool     wifi_mon_sample(int age, LinkSample& out);
+// Grows by one per sample, for redraws.
+uint32_t wifi_mon_seq();
+
+// The AI client's reply download: body bytes off the wire and how long they
+// took. Called from the worker task.
+void wifi_mon_noteTransfer(uint32_t bytes, uint32_t ms);
+
+// LINK prints the link stats, LINK_PROBE <http-url>|off sets the throughput
+// probe. Returns false for other lines.
+bool wifi_mon_handleSerial(const String& line);
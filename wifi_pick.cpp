@@ -0,0 +1,53 @@
+#include "wifi_pick.h"
+#include <string.h>
+
+int wifi_findSeen(const WifiProfile& p, const WifiSeen* seen, int ns)
+{
+  for (int i = 0; i < ns; i++) {
+    if (strcmp(seen[i].ssid, p.ssid) == 0) return i;
+  }
+  return -1;
+}
+
+// Unseen networks rank below every seen one.
+static const int UNSEEN = -100000;
+
+static int score(const WifiProfile& p, const WifiSeen* seen, int ns)
+{
+  int tries = p.okCount + p.failCount;
+  int failPenalty = tries ? 20 * p.failCount / tries : 0;   // 0..20 dB
+
+  int s = p.priority * WIFI_PRIO_DB - failPenalty;
+  int i = wifi_findSeen(p, seen, ns);
+  return i >= 0 ? s + seen[i].rssi : s + UNSEEN;
+}
+
+int wifi_rank(const WifiProfile* p, int np, const WifiSeen* seen, int ns, int* order)
+{
+  int sc[WIFI_LINK_MAX_PROFILES];
+  if (np > WIFI_LINK_MAX_PROFILES) np = WIFI_LINK_MAX_PROFILES;
+
+  for (int i = 0; i < np; i++) {
+    order[i] = i;
+    sc[i] = score(p[i], seen, ns);
+  }
+
+  // insertion sort, stable so the saved order breaks ties
+  for (int i = 1; i < np; i++) {
+    int v = order[i];
+    int j = i - 1;
+    while (j >= 0 && sc[order[j]] < sc[v]) {
+      order[j + 1] = order[j];
+      j--;
+    }
+    order[j + 1] = v;
+  }
+  return np;
+}
+
+bool wifi_shouldRoam(int curRssi, uint32_t lowForMs, int candRssi)
+{
+  if (curRssi >= WIFI_ROAM_RSSI) return false;
+  if (lowForMs < WIFI_ROAM_HOLD_MS) return false;
+  return candRssi - curRssi >= WIFI_ROAM_MARGIN_DB;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+
+// Which saved network to join, and when to roam. Plain data in and out, no
+// Arduino calls, so it can be built and fed synthetic scans on a PC.
+
+#ifndef WIFI_LINK_MAX_PROFILES
+#define WIFI_LINK_MAX_PROFILES 4
+#endif
+
+// One priority step is worth this much signal.
+#ifndef WIFI_PRIO_DB
+#define WIFI_PRIO_DB 10
+#endif
+
+// Roam when the link has sat below WIFI_ROAM_RSSI for WIFI_ROAM_HOLD_MS and
+// a candidate is at least WIFI_ROAM_MARGIN_DB stronger.
+#ifndef WIFI_ROAM_RSSI
+#define WIFI_ROAM_RSSI -75
+#endif
+
+#ifndef WIFI_ROAM_HOLD_MS
+#define WIFI_ROAM_HOLD_MS 15000
+#endif
+
+#ifndef WIFI_ROAM_MARGIN_DB
+#define WIFI_ROAM_MARGIN_DB 8
+#endif
+
+struct WifiProfile {
+  char     ssid[33];
+  char     pass[65];
+  uint8_t  bssid[6];    // last AP joined
+  uint8_t  channel;     // 0 = no fast-connect hint
+  uint8_t  priority;    // higher wins
+  uint16_t okCount;
+  uint16_t failCount;
+};
+
+// One AP from a scan; the strongest per SSID is enough.
+struct WifiSeen {
+  char    ssid[33];
+  int8_t  rssi;
+  uint8_t channel;
+  uint8_t bssid[6];
+};
+
+// Index into seen[] of the profile's network, -1 if it wasn't seen.
+int wifi_findSeen(const WifiProfile& p, const WifiSeen* seen, int ns);
+
+// Fills order[] with profile indices, best first: networks in the scan by
+// priority, signal and past failures, then the unseen ones by priority.
+// Pass ns = 0 when there is no recent scan. Returns np.
+int wifi_rank(const WifiProfile* p, int np, const WifiSeen* seen, int ns, int* order);
+
+bool wifi_shouldRoam(int curRssi, uint32_t lowForMs, int candRssi);